@@ -66,13 +66,12 @@ error:
 int bouncer_buffer_lookup (BouncerBuffer *buffer, Request *req)
 {
     int exists = 0;
-    int table_slot = req->block_num % buffer->lookup_table_size;
+    BlockKey key = request_key (req);
+    int table_slot = hash_u64 (key) % buffer->lookup_table_size;
     BouncerBufferEntry  *buffer_entry  = buffer->lookup_table[table_slot];
 
     while (buffer_entry != NULL) {
-        if ((buffer_entry->block_num == req->block_num)   &&
-            (buffer_entry->server_num == req->server_num) &&
-            (buffer_entry->volume_num == req->volume_num)) {
+        if (buffer_entry->key == key) {
             exists = 1;
             break;
         } else {
@@ -138,18 +137,18 @@ int bouncer_buffer_lookup (BouncerBuffer *buffer, Request *req)
  */
 
 int bouncer_buffer_insert  (BouncerBuffer *buffer, uint64_t block_num,
-                uint8_t server_num, uint8_t volume_num, Request *ret_req)
+                uint32_t volume_id, Request *ret_req)
 {
     BouncerBufferEntry *buffer_entry = NULL;
+    BlockKey       key         = block_key (block_num, volume_id);
     int            table_slot  = -1;
     int            ret         = 0;
     if (buffer->entry_count == buffer->buffer_size) {
         /* replacing an existing entry */
         ret          = 1;
         buffer_entry = buffer->lru_tail;
-        ret_req->block_num  = buffer_entry->block_num;
-        ret_req->server_num = buffer_entry->server_num;
-        ret_req->volume_num = buffer_entry->volume_num;
+        ret_req->block_num  = block_key_block_num (buffer_entry->key);
+        ret_req->volume_id  = block_key_volume_id (buffer_entry->key);
 
         /* updating LRU info */
         buffer->lru_tail = buffer_entry->lru_prev;
@@ -163,7 +162,7 @@ int bouncer_buffer_insert  (BouncerBuffer *buffer, uint64_t block_num,
         /* update lookup info */
         /* remove it from the original lookup chain */
 
-        table_slot = buffer_entry->block_num % buffer->lookup_table_size;
+        table_slot = hash_u64 (buffer_entry->key) % buffer->lookup_table_size;
 
         if (buffer->lookup_table[table_slot] == buffer_entry) {
             /*if it is the first one in the chain */
@@ -188,22 +187,18 @@ int bouncer_buffer_insert  (BouncerBuffer *buffer, uint64_t block_num,
         }
 
         /* insert it to the head of the new lookup chain */
-        table_slot = block_num % buffer->lookup_table_size;
+        table_slot = hash_u64 (key) % buffer->lookup_table_size;
         buffer_entry->lookup_prev = NULL;
         buffer_entry->lookup_next = buffer->lookup_table[table_slot];
         if (buffer->lookup_table[table_slot] != NULL) {
             buffer->lookup_table[table_slot]->lookup_prev = buffer_entry;
         }
         buffer->lookup_table[table_slot] = buffer_entry;
-        buffer_entry->block_num  = block_num;
-        buffer_entry->server_num = server_num;
-        buffer_entry->volume_num = volume_num;
+        buffer_entry->key = key;
     } else {
         /* inserting a new entry */
         buffer_entry = &(buffer->buffer_entry[buffer->entry_count]);
-        buffer_entry->block_num  = block_num;
-        buffer_entry->server_num = server_num;
-        buffer_entry->volume_num = volume_num;
+        buffer_entry->key = key;
 
         /* update LRU info */
         if (buffer->lru_head == NULL) {
@@ -220,7 +215,7 @@ int bouncer_buffer_insert  (BouncerBuffer *buffer, uint64_t block_num,
         }
 
         /* update lookup info */
-        table_slot = block_num % buffer->lookup_table_size;
+        table_slot = hash_u64 (key) % buffer->lookup_table_size;
 
         buffer_entry->lookup_prev = NULL;
         buffer_entry->lookup_next = buffer->lookup_table[table_slot];
@@ -259,7 +254,7 @@ void print_bouncer_buffer (BouncerBuffer *buffer)
         printf("SLOT %d: ", i);
         buffer_entry = buffer->lookup_table[i];
         while (buffer_entry != NULL) {
-            printf("%"PRIu64"\t", buffer_entry->block_num);
+            printf("%"PRIu64"\t", block_key_block_num (buffer_entry->key));
             buffer_entry = buffer_entry->lookup_next;
         }
         printf("\n");
@@ -268,7 +263,7 @@ void print_bouncer_buffer (BouncerBuffer *buffer)
     printf("LRU:\t");
     buffer_entry = buffer->lru_head;
     while (buffer_entry != NULL) {
-        printf("%"PRIu64"\t", buffer_entry->block_num);
+        printf("%"PRIu64"\t", block_key_block_num (buffer_entry->key));
         buffer_entry = buffer_entry->lru_next;
     }
     printf("\n++++++++++++++++++++++++++++++++++++\n\n");
@@ -289,13 +284,12 @@ void bouncer_buffer_test ()
 
     for (i = 0; i < 20; i++) {
         req.block_num = block_array[i];
-        req.server_num = 0;
-        req.volume_num = 0;
+        req.volume_id = 0;
 
         ret = bouncer_buffer_lookup(bouncer_buffer, &req);
         if (ret == 0) {
-            bouncer_buffer_insert(bouncer_buffer, req.block_num, req.server_num,
-                    req.volume_num, &replaced_req);
+            bouncer_buffer_insert(bouncer_buffer, req.block_num, req.volume_id,
+                    &replaced_req);
         }
 
         print_bouncer_buffer(bouncer_buffer);
@@ -4,14 +4,12 @@
 #include "common.h"
 
 typedef struct BouncerBufferEntry {
-    uint64_t                  block_num;
-    uint8_t                   server_num;
-    uint8_t                   volume_num;
+    BlockKey                  key;
     struct BouncerBufferEntry     *lookup_next;
     struct BouncerBufferEntry     *lookup_prev;
     struct BouncerBufferEntry     *lru_next;
     struct BouncerBufferEntry     *lru_prev;
-} BouncerBufferEntry __attribute__((aligned (64)));
+} BouncerBufferEntry;
 
 
 typedef struct BouncerBuffer {
@@ -22,12 +20,12 @@ typedef struct BouncerBuffer {
     BouncerBufferEntry  **lookup_table;
     BouncerBufferEntry  *lru_head;
     BouncerBufferEntry  *lru_tail;
-}BouncerBuffer __attribute__((aligned (64)));
+}BouncerBuffer;
 
 int  bouncer_buffer_init    (uint32_t buffer_size, BouncerBuffer *buffer);
 int  bouncer_buffer_lookup  (BouncerBuffer *buffer, Request *req);
 int  bouncer_buffer_insert  (BouncerBuffer *buffer, uint64_t block_num,
-                      uint8_t server_num, uint8_t volume_num, Request *ret_req);
+                      uint32_t volume_id, Request *ret_req);
 void bouncer_buffer_destroy (BouncerBuffer *buffer);
 void bouncer_buffer_test    ();
 
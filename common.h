@@ -21,9 +21,9 @@
 
 typedef struct CSVLineData {
     uint64_t timestamp;
-    uint8_t  server_num;
-    uint8_t  volume_num;
-    char     req_type[5];
+    uint32_t server_num;
+    uint32_t volume_num;
+    char     req_type[6];
     uint64_t start_addr;
     uint32_t req_size;
     uint64_t duration;
@@ -31,17 +31,81 @@ typedef struct CSVLineData {
 
 typedef struct Request {
     uint64_t block_num;
-    uint8_t  server_num;
-    uint8_t  volume_num;
+    uint32_t volume_id; // dense id from the trace's VolumeDict
     uint8_t  req_type;  // 0 - read; 1 - write;
     uint32_t sub_window_ind;
+    uint64_t timestamp; // of the trace line the block came from
 } Request;
 
 typedef struct ReplayReq {
     uint64_t block_num;
-    uint8_t  server_num;
-    uint8_t  volume_num;
+    uint32_t volume_id;
     uint8_t  req_type;  // 0 - read; 1 - write;
-} ReplayReq __attribute__((aligned(16)));
+} ReplayReq;
+
+/*
+ * The (volume, block) identity of a block packed into one word: the
+ * dense volume id in the top BLOCK_KEY_VOLUME_BITS and the block
+ * number in the low BLOCK_KEY_BLOCK_BITS. Every structure keys its
+ * blocks this way, so matching a block is a single compare. Traces
+ * are checked at ingest for block numbers and volume counts that do
+ * not fit.
+ */
+typedef uint64_t BlockKey;
+
+#define BLOCK_KEY_BLOCK_BITS        40
+#define BLOCK_KEY_VOLUME_BITS       (64 - BLOCK_KEY_BLOCK_BITS)
+#define BLOCK_KEY_BLOCK_MASK        ((1ULL << BLOCK_KEY_BLOCK_BITS) - 1)
+
+static inline BlockKey block_key (uint64_t block_num, uint32_t volume_id)
+{
+    return (((uint64_t) volume_id << BLOCK_KEY_BLOCK_BITS)
+            | (block_num & BLOCK_KEY_BLOCK_MASK));
+}
+
+static inline BlockKey request_key (const Request *req)
+{
+    return block_key (req->block_num, req->volume_id);
+}
+
+static inline uint64_t block_key_block_num (BlockKey key)
+{
+    return (key & BLOCK_KEY_BLOCK_MASK);
+}
+
+static inline uint32_t block_key_volume_id (BlockKey key)
+{
+    return (uint32_t) (key >> BLOCK_KEY_BLOCK_BITS);
+}
+
+/* Whether blocks [start_block, start_block + num_blocks) all fit a key. */
+static inline int block_key_range_fits (uint64_t start_block,
+        uint32_t num_blocks)
+{
+    return ((start_block <= BLOCK_KEY_BLOCK_MASK)
+            && (num_blocks <= BLOCK_KEY_BLOCK_MASK - start_block + 1));
+}
+
+/*
+ * splitmix64 finalizer, block numbers are far from uniform. Every
+ * table hashes its BlockKeys with it.
+ */
+static inline uint64_t hash_u64 (uint64_t key)
+{
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+
+    return (key ^ (key >> 31));
+}
+
+/* One line of the trace in block units, as stored in binary trace files. */
+typedef struct TraceRecord {
+    uint64_t timestamp;
+    uint64_t start_block;
+    uint32_t num_blocks;
+    uint32_t volume_id;
+    uint8_t  req_type;  // 0 - read; 1 - write;
+    uint8_t  reserved[7];
+} TraceRecord;
 
 #endif
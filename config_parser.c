@@ -5,6 +5,7 @@
 #include "debug.h"
 #include "common.h"
 #include "config_parser.h"
+#include "miss_filter.h"
 
 uint32_t *parse_buffer_size_str(char *buffer_size_str, uint32_t *num_sizes)
 {
@@ -170,6 +171,23 @@ int parse_config_file (char *config_file, ConfigInfo *config_info)
         } else if (strstr(line, "test_type:") != NULL) {
             config_info->test_type = parse_int (line);
             check (config_info->test_type>=0, "failed to parse test_type.");
+        } else if (strstr(line, "miss_filter_hashes:") != NULL) {
+            ret = parse_int (line);
+            check ((ret>=0) && (ret<=MISS_FILTER_MAX_HASHES),
+                    "failed to parse miss_filter_hashes.");
+            config_info->miss_filter_hashes = ret;
+        } else if (strstr(line, "sieved_ghost_cache_size:") != NULL) {
+            ret = parse_int (line);
+            check (ret>0, "failed to parse sieved_ghost_cache_size.");
+            config_info->sieved_ghost_cache_size = ret;
+        } else if (strstr(line, "ghost_cache_compact:") != NULL) {
+            ret = parse_int (line);
+            check (ret!=-1, "failed to parse ghost_cache_compact.");
+            config_info->ghost_cache_compact = (ret != 0);
+        } else if (strstr(line, "num_parser_threads:") != NULL) {
+            ret = parse_int (line);
+            check (ret!=-1, "failed to parse num_parser_threads.");
+            config_info->num_parser_threads = ret;
         }
     }
 
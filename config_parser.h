@@ -9,15 +9,20 @@ typedef struct ConfigInfo {
     char      debug_file[FILE_LINE_SIZE];
     uint64_t  traditional_wb_size;
     uint64_t  sieved_wb_size;
-    uint32_t  sieved_ghost_cache_size;
+    uint32_t  sieved_ghost_cache_size;  // 0 - GHOST_CACHE_DEFAULT_SIZE
+    uint8_t   ghost_cache_compact;      // Fingerprint slots instead of entries
     uint32_t  sieved_wb_threshold;
     uint64_t  miss_filter_size;
     uint32_t  miss_filter_threshold;
+    uint8_t   miss_filter_hashes;   // 0 - direct mapped, else count-min rows
     uint64_t  miss_table_lookup_size;
     uint32_t  miss_table_threshold;
     uint64_t  ssd_size;
     uint8_t   num_sub_windows;
     uint8_t   test_type;
+    uint32_t  num_parser_threads;   // 0 - parse the trace inline
+    uint32_t  mrc_points;           // Points on the miss ratio curve
+    double    sample_rate;          // Fraction of blocks simulated, 1.0 - all
 } ConfigInfo;
 
 int parse_config_file (char *config_file, ConfigInfo *config_info);
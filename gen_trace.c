@@ -133,7 +133,7 @@ int main (int argc, char *argv)
     }
 
     while (fgets(line, sizeof(line), in) != NULL) {
-            ret = sscanf(line, "%"SCNu64" %"SCNu8" %"SCNu8" %s %"SCNu64" %"SCNu32" "
+            ret = sscanf(line, "%"SCNu64" %"SCNu32" %"SCNu32" %s %"SCNu64" %"SCNu32" "
             "%"SCNu64"\n", &csv_data.timestamp, &csv_data.server_num,
                     &csv_data.volume_num, csv_data.req_type, &csv_data.start_addr,
                     &csv_data.req_size, &csv_data.duration);
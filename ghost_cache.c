@@ -3,23 +3,82 @@
 
 #include "debug.h"
 #include "ghost_cache.h"
+#include "window_counter.h"
+#include "table_mem.h"
+
+#define GHOST_SLOT_FINGERPRINT  ((1ULL << GHOST_CACHE_FINGERPRINT_BITS) - 1)
+#define GHOST_SLOT_REF          (1ULL << GHOST_CACHE_FINGERPRINT_BITS)
+#define GHOST_SLOT_TAG_SHIFT    (GHOST_CACHE_FINGERPRINT_BITS + 1)
+#define GHOST_SLOT_TAG_MASK     ((1U << GHOST_CACHE_TAG_BITS) - 1)
+
+/*
+ * Size the counters to hold the threshold where the 40 counter bits
+ * allow it, and allocate at least cache_size slots.
+ */
+static int ghost_cache_init_compact (GhostCache *cache)
+{
+    uint32_t n = cache->num_sub_windows;
+    uint32_t max_counter_bits = (64 - GHOST_CACHE_COUNTER_SHIFT) / n;
+    uint64_t num_buckets = 1;
+
+    cache->counter_bits = 1;
+    while ((cache->counter_bits < 32)
+            && ((1ULL << cache->counter_bits) <= cache->threshold)) {
+        cache->counter_bits += 1;
+    }
+    if (cache->counter_bits > max_counter_bits) {
+        log_warn("compact ghost cache counters saturate at %"PRIu32
+                ", below the threshold %"PRIu32".",
+                (1U << max_counter_bits) - 1, cache->threshold);
+        cache->counter_bits = max_counter_bits;
+    }
+    cache->counter_max = (cache->threshold > 0) ? cache->threshold : 1;
+    if (cache->counter_max > (1U << cache->counter_bits) - 1) {
+        cache->counter_max = (1U << cache->counter_bits) - 1;
+    }
+
+    while (num_buckets * GHOST_CACHE_BUCKET_SLOTS < cache->cache_size) {
+        num_buckets <<= 1;
+    }
+    cache->bucket_mask = num_buckets - 1;
+    cache->clock_hand  = 0;
+    cache->last_sweep  = 0;
+    cache->next_sweep  = 1ULL << (GHOST_CACHE_TAG_BITS - 1);
+
+    cache->slots = (uint64_t *) table_mem_alloc (num_buckets
+            * GHOST_CACHE_BUCKET_SLOTS * sizeof(uint64_t));
+    check (cache->slots!=NULL, "failed to allocate compact ghost cache slots.");
+
+    return 0;
+
+error:
+
+    return -1;
+}
 
 int ghost_cache_init (uint64_t cache_size, uint32_t threshold,
-        uint8_t num_sub_windows, GhostCache *cache)
+        uint8_t num_sub_windows, uint8_t compact, GhostCache *cache)
 {
     cache->cache_size = cache_size;
     cache->threshold = threshold;
     cache->num_sub_windows = num_sub_windows;
+    check ((num_sub_windows>=1) && (num_sub_windows<=12),
+            "the ghost cache needs 1 to 12 sub windows.");
+    check (cache_size>=1, "the ghost cache needs at least 1 entry.");
 
     cache->lru_head = NULL;
     cache->lru_tail = NULL;
 
-    cache->cache_entry = (GhostCacheEntry *) calloc (cache_size,
-            sizeof(GhostCacheEntry));
+    if (compact) {
+        return ghost_cache_init_compact (cache);
+    }
+
+    cache->cache_entry = (GhostCacheEntry *) table_mem_alloc (cache_size
+            * sizeof(GhostCacheEntry));
     check (cache->cache_entry!=NULL, "failed to allocate cache_entry.");
 
-    cache->lookup_table = (GhostCacheEntry **) calloc (cache_size,
-            sizeof(GhostCacheEntry *));
+    cache->lookup_table = (GhostCacheEntry **) table_mem_alloc (cache_size
+            * sizeof(GhostCacheEntry *));
     check (cache->lookup_table!=NULL, "failed to allocate lookup_table.");
 
     return 0;
@@ -29,6 +88,175 @@ error:
     return -1;
 }
 
+uint64_t ghost_cache_bytes (GhostCache *cache)
+{
+    if (cache->slots != NULL) {
+        return (cache->bucket_mask + 1) * GHOST_CACHE_BUCKET_SLOTS
+                * sizeof(uint64_t);
+    }
+
+    return cache->cache_size
+            * (sizeof(GhostCacheEntry) + sizeof(GhostCacheEntry *));
+}
+
+/* Sub windows since the last access of a slot, modulo the tag. */
+static inline uint32_t ghost_slot_age (uint64_t value, uint32_t curr)
+{
+    return (curr - (uint32_t) (value >> GHOST_SLOT_TAG_SHIFT))
+            & GHOST_SLOT_TAG_MASK;
+}
+
+/*
+ * Every occupied slot was last accessed within
+ * [last_sweep - num_sub_windows + 1, next_sweep), a range shorter than
+ * 2^GHOST_CACHE_TAG_BITS, so its tag gives back the full sub window.
+ * Empty the slots that are stale at curr, after which the range
+ * starts over from curr.
+ */
+static void ghost_cache_sweep (GhostCache *cache, uint32_t curr)
+{
+    uint32_t n     = cache->num_sub_windows;
+    uint64_t size  = (cache->bucket_mask + 1) * GHOST_CACHE_BUCKET_SLOTS;
+    int64_t  base  = (int64_t) cache->last_sweep - n + 1;
+    uint64_t i, value;
+    int64_t  last;
+
+    for (i = 0; i < size; i++) {
+        value = cache->slots[i];
+        if (value == 0) {
+            continue;
+        }
+        last = base + (int64_t) (((value >> GHOST_SLOT_TAG_SHIFT)
+                                  - (uint64_t) base) & GHOST_SLOT_TAG_MASK);
+        if ((int64_t) curr - last >= n) {
+            cache->slots[i] = 0;
+            cache->entry_count -= 1;
+        }
+    }
+
+    cache->last_sweep = curr;
+    cache->next_sweep = (uint64_t) curr + (1ULL << (GHOST_CACHE_TAG_BITS - 1));
+}
+
+/*
+ * Eviction order of a slot, higher goes first: empty or stale slots,
+ * then the ones the CLOCK hand cleared, oldest first, then the rest,
+ * oldest first.
+ */
+static inline uint32_t ghost_slot_rank (GhostCache *cache, uint64_t value,
+        uint32_t curr)
+{
+    uint32_t age = ghost_slot_age (value, curr);
+
+    if ((value == 0) || (age >= cache->num_sub_windows)) {
+        return 2U << GHOST_CACHE_TAG_BITS;
+    }
+    if ((value & GHOST_SLOT_REF) == 0) {
+        return (1U << GHOST_CACHE_TAG_BITS) | age;
+    }
+
+    return age;
+}
+
+/* The fingerprint of the block and its two candidate buckets. */
+static inline uint64_t ghost_cache_buckets (const GhostCache *cache,
+        const Request *req, uint64_t *bucket)
+{
+    uint64_t hash = hash_u64 (request_key (req));
+    uint64_t fingerprint = hash >> (64 - GHOST_CACHE_FINGERPRINT_BITS);
+
+    if (fingerprint == 0) {
+        fingerprint = 1;
+    }
+    bucket[0] = hash & cache->bucket_mask;
+    bucket[1] = (bucket[0] ^ hash_u64 (fingerprint)) & cache->bucket_mask;
+
+    return fingerprint;
+}
+
+static int ghost_cache_access_compact (GhostCache *cache, Request *req)
+{
+    int ret = 0;
+    uint32_t i, b;
+    uint32_t curr   = req->sub_window_ind;
+    uint32_t n      = cache->num_sub_windows;
+    uint8_t  cb     = cache->counter_bits;
+    uint32_t curr_shift = (curr % n) * cb;
+    uint64_t ones   = window_counter_ones (n, cb);
+    uint64_t fingerprint, bucket[2];
+    uint64_t *slot, *victim = NULL;
+    uint64_t value, counters, miss_count = 0;
+    uint32_t rank, victim_rank = 0;
+
+    fingerprint = ghost_cache_buckets (cache, req, bucket);
+
+    if (curr >= cache->next_sweep) {
+        ghost_cache_sweep (cache, curr);
+    }
+
+    for (b = 0; b < 2; b++) {
+        slot = &(cache->slots[bucket[b] * GHOST_CACHE_BUCKET_SLOTS]);
+        for (i = 0; i < GHOST_CACHE_BUCKET_SLOTS; i++) {
+            value = slot[i];
+            if ((value & GHOST_SLOT_FINGERPRINT) == fingerprint) {
+                // hits in ghost cache
+                counters = (value >> GHOST_CACHE_COUNTER_SHIFT) & ones
+                         & ~window_stale_mask (n, cb,
+                                 ghost_slot_age (value, curr), curr);
+                value = counters;
+                while (value != 0) {
+                    miss_count += value & ((1ULL << cb) - 1);
+                    value >>= cb;
+                }
+                ret = (miss_count >= cache->threshold) ? 1 : 0;
+
+                if (((counters >> curr_shift) & ((1ULL << cb) - 1))
+                        < cache->counter_max) {
+                    counters += 1ULL << curr_shift;
+                }
+                slot[i] = fingerprint | GHOST_SLOT_REF
+                        | ((uint64_t) (curr & GHOST_SLOT_TAG_MASK)
+                           << GHOST_SLOT_TAG_SHIFT)
+                        | (counters << GHOST_CACHE_COUNTER_SHIFT);
+                return ret;
+            }
+
+            rank = ghost_slot_rank (cache, value, curr);
+            if ((victim == NULL) || (rank > victim_rank)) {
+                victim = &(slot[i]);
+                victim_rank = rank;
+            }
+        }
+    }
+
+    // misses in ghost cache
+    if (*victim == 0) {
+        cache->num_inserts += 1;
+        cache->entry_count += 1;
+    } else if (victim_rank == (2U << GHOST_CACHE_TAG_BITS)) {
+        cache->num_inserts += 1;
+    } else {
+        cache->num_replaces += 1;
+        slot = &(cache->slots[cache->clock_hand * GHOST_CACHE_BUCKET_SLOTS]);
+        for (i = 0; i < GHOST_CACHE_BUCKET_SLOTS; i++) {
+            slot[i] &= ~GHOST_SLOT_REF;
+        }
+        cache->clock_hand = (cache->clock_hand + 1) & cache->bucket_mask;
+    }
+
+    *victim = fingerprint | GHOST_SLOT_REF
+            | ((uint64_t) (curr & GHOST_SLOT_TAG_MASK) << GHOST_SLOT_TAG_SHIFT)
+            | ((1ULL << curr_shift) << GHOST_CACHE_COUNTER_SHIFT);
+
+    return ret;
+}
+
+/* The lookup chain of a block key in the entry layout. */
+static inline uint32_t ghost_cache_slot (const GhostCache *cache, BlockKey key)
+{
+    return (uint32_t) (hash_u64 (key) % cache->cache_size);
+}
+
 /* Return values:
  *      0  -  do nothing
  *      1  -  should be allocated
@@ -37,28 +265,30 @@ error:
 
 int ghost_cache_access  (GhostCache *cache, Request *req)
 {
-    int ret = 0, i, ind;
+    int ret = 0, i;
     uint64_t miss_count = 0;
-    uint32_t lookup_table_slot = req->block_num % cache->cache_size;
-    GhostCacheEntry *entry     = cache->lookup_table[lookup_table_slot];
-    uint32_t last_sub_window_ind;
-    uint32_t sub_window_ind_diff;
+    BlockKey key = request_key (req);
+    uint32_t lookup_table_slot;
+    GhostCacheEntry *entry;
     uint8_t num_sub_windows = cache->num_sub_windows;
     uint8_t curr_sub_window_counter_ind = req->sub_window_ind
             % num_sub_windows;
 
-/*    printf ("block_num = %"PRIu64" sever_num = %"PRIu8" "
-            "volume_num = %"PRIu8"\n", req->block_num, req->server_num,
-            req->volume_num);*/
+    if (cache->slots != NULL) {
+        return ghost_cache_access_compact (cache, req);
+    }
+    lookup_table_slot = ghost_cache_slot (cache, key);
+    entry = cache->lookup_table[lookup_table_slot];
+
+/*    printf ("block_num = %"PRIu64" volume_id = %"PRIu32"\n",
+            req->block_num, req->volume_id);*/
 
 /*    if (lookup_table_slot == 368640) {
         printf("debug\n");
     }*/
 
     while (entry != NULL) {
-        if ((entry->block_num == req->block_num)
-                && (entry->volume_num == req->volume_num)
-                && (entry->server_num == req->server_num)) {
+        if (entry->key == key) {
             break;
         }
         entry = entry->lookup_next;
@@ -67,24 +297,9 @@ int ghost_cache_access  (GhostCache *cache, Request *req)
     if (entry != NULL) {
         // hits in ghost cache
         // find the miss_count
-        last_sub_window_ind = entry->last_access_sub_window_ind;
-        sub_window_ind_diff = req->sub_window_ind - last_sub_window_ind;
-        uint8_t last_sub_window_counter_ind = last_sub_window_ind
-                % num_sub_windows;
-
-        if (sub_window_ind_diff >= num_sub_windows) {
-            for (i = 0; i < num_sub_windows; i++) {
-                entry->counter[i] = 0;
-            }
-        } else if (sub_window_ind_diff != 0) {
-            ind = last_sub_window_counter_ind;
-            ind = (ind + 1) % num_sub_windows;
-            while (ind != curr_sub_window_counter_ind) {
-                entry->counter[ind] = 0;
-                ind = (ind + 1) % num_sub_windows;
-            }
-            entry->counter[ind] = 0;
-        }
+        window_clear_stale (entry->counter, sizeof(entry->counter[0]),
+                entry->last_access_sub_window_ind, req->sub_window_ind,
+                num_sub_windows);
 
         for (i = 0; i < num_sub_windows; i++) {
             miss_count += entry->counter[i];
@@ -153,7 +368,7 @@ int ghost_cache_access  (GhostCache *cache, Request *req)
             entry = cache->lru_tail;
 
             // remove entry from the old lookup list
-            lookup_table_slot = entry->block_num % cache->cache_size;
+            lookup_table_slot = ghost_cache_slot (cache, entry->key);
             if (cache->lookup_table[lookup_table_slot] == entry) {
                 // the first entry in the lookup list
                 cache->lookup_table[lookup_table_slot] = entry->lookup_next;
@@ -169,14 +384,12 @@ int ghost_cache_access  (GhostCache *cache, Request *req)
             }
 
             // set new values to the entry
-            entry->block_num = req->block_num;
-            entry->server_num = req->server_num;
-            entry->volume_num = req->volume_num;
+            entry->key = key;
             entry->counter[curr_sub_window_counter_ind] = 1;
             entry->last_access_sub_window_ind = req->sub_window_ind;
 
             // move the new entry to the new lookup position
-            lookup_table_slot = entry->block_num % cache->cache_size;
+            lookup_table_slot = ghost_cache_slot (cache, key);
             if (cache->lookup_table[lookup_table_slot] == NULL) {
                 cache->lookup_table[lookup_table_slot] = entry;
                 entry->lookup_next = NULL;
@@ -220,14 +433,12 @@ int ghost_cache_access  (GhostCache *cache, Request *req)
             }
 
             // update entry information
-            entry->block_num = req->block_num;
-            entry->server_num = req->server_num;
-            entry->volume_num = req->volume_num;
+            entry->key = key;
             entry->counter[curr_sub_window_counter_ind] = 1;
             entry->last_access_sub_window_ind = req->sub_window_ind;
 
             // update lookup table
-            lookup_table_slot = entry->block_num % cache->cache_size;
+            lookup_table_slot = ghost_cache_slot (cache, key);
             if (cache->lookup_table[lookup_table_slot] == NULL) {
                 cache->lookup_table[lookup_table_slot] = entry;
                 entry->lookup_next = NULL;
@@ -252,13 +463,41 @@ int ghost_cache_access  (GhostCache *cache, Request *req)
     return ret;
 }
 
+/*
+ * Prefetch the lookup chain heads, or the compact buckets, of
+ * requests about to access the ghost cache.
+ */
+void ghost_cache_prefetch_batch (const GhostCache *cache, const Request *reqs,
+        uint32_t num_reqs)
+{
+    uint32_t i;
+    uint64_t bucket[2];
+
+    for (i = 0; i < num_reqs; i++) {
+        if (cache->slots != NULL) {
+            ghost_cache_buckets (cache, &(reqs[i]), bucket);
+            __builtin_prefetch (&(cache->slots[bucket[0]
+                        * GHOST_CACHE_BUCKET_SLOTS]), 1);
+            __builtin_prefetch (&(cache->slots[bucket[1]
+                        * GHOST_CACHE_BUCKET_SLOTS]), 1);
+        } else {
+            __builtin_prefetch (&(cache->lookup_table[ghost_cache_slot (cache,
+                        request_key (&(reqs[i])))]));
+        }
+    }
+}
+
 void ghost_cache_destroy (GhostCache *cache)
 {
     if (cache->cache_entry != NULL) {
-        free (cache->cache_entry);
+        table_mem_free (cache->cache_entry);
     }
 
     if (cache->lookup_table != NULL) {
-        free (cache->lookup_table);
+        table_mem_free (cache->lookup_table);
+    }
+
+    if (cache->slots != NULL) {
+        table_mem_free (cache->slots);
     }
 }
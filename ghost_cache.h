@@ -4,18 +4,39 @@
 #include <inttypes.h>
 #include "common.h"
 
+#define GHOST_CACHE_DEFAULT_SIZE        409600
+#define GHOST_CACHE_BUCKET_SLOTS        4       // Compact slots per bucket
+#define GHOST_CACHE_FINGERPRINT_BITS    16
+#define GHOST_CACHE_TAG_BITS            7
+#define GHOST_CACHE_COUNTER_SHIFT       24      // Fingerprint, ref bit and tag
+
 typedef struct GhostCacheEntry {
-    uint64_t block_num;
-    uint8_t  server_num;
-    uint8_t  volume_num;
+    BlockKey key;
     uint32_t counter[12];
     uint32_t last_access_sub_window_ind;
     struct GhostCacheEntry *lookup_prev;
     struct GhostCacheEntry *lookup_next;
     struct GhostCacheEntry *lru_prev;
     struct GhostCacheEntry *lru_next;
-}GhostCacheEntry __attribute__((aligned (64)));
+}GhostCacheEntry;
 
+/*
+ * The compact layout keeps one 64 bit slot per block instead of a
+ * GhostCacheEntry and a lookup pointer: a 16 bit fingerprint of the
+ * block key (0 - empty slot), a CLOCK reference bit, a tag with the
+ * low bits of the last access sub window, and num_sub_windows packed
+ * counters in the remaining 40 bits. A block lives in one of two
+ * buckets of GHOST_CACHE_BUCKET_SLOTS slots, the second derived from
+ * the first and the fingerprint as in a cuckoo filter.
+ *
+ * Counters saturate at counter_max = threshold, which cannot change
+ * whether their sum reaches the threshold as long as it fits in
+ * counter_bits. A full pair of buckets evicts a slot that has gone
+ * stale, else the oldest one the CLOCK hand has cleared, else the
+ * oldest. The hand clears the reference bits of one bucket per
+ * eviction, and every 2^(tag_bits-1) sub windows a sweep empties the
+ * stale slots so that tags stay unambiguous.
+ */
 typedef struct GhostCache {
     uint64_t cache_size;
     uint32_t threshold;
@@ -27,13 +48,23 @@ typedef struct GhostCache {
     GhostCacheEntry **lookup_table;
     GhostCacheEntry *lru_head;
     GhostCacheEntry *lru_tail;
+    uint64_t *slots;            // Compact layout, NULL for cache_entry
+    uint64_t  bucket_mask;      // Buckets - 1, power of 2
+    uint64_t  clock_hand;       // Next bucket to clear
+    uint8_t   counter_bits;
+    uint32_t  counter_max;
+    uint32_t  last_sweep;
+    uint64_t  next_sweep;
 }GhostCache;
 
 
 int ghost_cache_init (uint64_t cache_size, uint32_t threshold,
-        uint8_t num_sub_windows, GhostCache *cache);
+        uint8_t num_sub_windows, uint8_t compact, GhostCache *cache);
+uint64_t ghost_cache_bytes (GhostCache *cache);
 
 int  ghost_cache_access  (GhostCache *cache, Request *req);
+void ghost_cache_prefetch_batch (const GhostCache *cache, const Request *reqs,
+        uint32_t num_reqs);
 
 void ghost_cache_destroy (GhostCache *cache);
 
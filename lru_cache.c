@@ -5,50 +5,188 @@
 #include "debug.h"
 #include "common.h"
 #include "lru_cache.h"
+#include "table_mem.h"
 
 /*
- * Assuming the lookup_table_size is multiples of 512
- * so that the lookup_table would occupy multiples of
- * 4K pages.
- *
- * lookup_table_size is 8 times smaller than the
- * cache_size so that the open chaining would not
- * be longer than 8.
+ * The lookup table is an open addressing table with at least 4/3
+ * slots per cache entry. At that load a Robin Hood probe rarely goes
+ * past the first cache line of 8 byte slots.
  */
-uint32_t get_lookup_table_size (uint32_t cache_size)
+uint64_t get_lookup_table_size (uint64_t cache_size)
 {
-    uint32_t lookup_table_size = 512;
-    uint32_t multiple          = (cache_size >> 12) + 1;
+    uint64_t lookup_table_size = 64;
+
+    while (lookup_table_size < (cache_size * 4 / 3)) {
+        lookup_table_size <<= 1;
+    }
 
-    return (lookup_table_size * multiple);
+    return lookup_table_size;
 }
 
-int lru_cache_init (uint32_t cache_size, LRUCache *cache)
+/* returns the slot of key, or NULL if it is not in the cache. */
+static inline LRUCacheSlot *lru_cache_find (LRUCache *cache, BlockKey key)
+{
+    uint32_t hash = (uint32_t) hash_u64 (key);
+    uint64_t mask = cache->lookup_table_size - 1;
+    uint64_t i    = hash & mask;
+    uint64_t dist = 0;
+    LRUCacheSlot *slot;
+
+    while (1) {
+        slot = &(cache->lookup_table[i]);
+        if (slot->entry == 0) {
+            return NULL;
+        }
+        if ((slot->hash == hash)
+                && (cache->cache_entry[slot->entry - 1].key == key)) {
+            return slot;
+        }
+        /* key would have taken this slot from a richer one */
+        if (((i - slot->hash) & mask) < dist) {
+            return NULL;
+        }
+        i = (i + 1) & mask;
+        dist += 1;
+    }
+}
+
+/* add a key that is not in the lookup table yet. */
+static void lru_cache_index (LRUCache *cache, BlockKey key, uint32_t entry)
+{
+    uint64_t mask = cache->lookup_table_size - 1;
+    uint64_t dist = 0, slot_dist, i;
+    LRUCacheSlot curr, tmp;
+
+    curr.hash = (uint32_t) hash_u64 (key);
+    curr.entry = entry + 1;
+    i = curr.hash & mask;
+
+    while (cache->lookup_table[i].entry != 0) {
+        slot_dist = (i - cache->lookup_table[i].hash) & mask;
+        if (slot_dist < dist) {
+            tmp = cache->lookup_table[i];
+            cache->lookup_table[i] = curr;
+            curr = tmp;
+            dist = slot_dist;
+        }
+        i = (i + 1) & mask;
+        dist += 1;
+    }
+    cache->lookup_table[i] = curr;
+}
+
+/* empty a slot, shifting the rest of its probe run back by one. */
+static void lru_cache_unindex (LRUCache *cache, LRUCacheSlot *slot)
+{
+    uint64_t mask = cache->lookup_table_size - 1;
+    uint64_t i    = slot - cache->lookup_table;
+    uint64_t next = (i + 1) & mask;
+
+    while ((cache->lookup_table[next].entry != 0)
+            && ((cache->lookup_table[next].hash & mask) != next)) {
+        cache->lookup_table[i] = cache->lookup_table[next];
+        i = next;
+        next = (next + 1) & mask;
+    }
+    cache->lookup_table[i].entry = 0;
+}
+
+static inline void lru_cache_unlink (LRUCache *cache, uint32_t ind)
+{
+    LRUCacheEntry *cache_entry = &(cache->cache_entry[ind]);
+
+    if (cache_entry->lru_prev != LRU_CACHE_NIL) {
+        cache->cache_entry[cache_entry->lru_prev].lru_next =
+                cache_entry->lru_next;
+    } else {
+        cache->lru_head = cache_entry->lru_next;
+    }
+
+    if (cache_entry->lru_next != LRU_CACHE_NIL) {
+        cache->cache_entry[cache_entry->lru_next].lru_prev =
+                cache_entry->lru_prev;
+    } else {
+        cache->lru_tail = cache_entry->lru_prev;
+    }
+}
+
+static inline void lru_cache_push_head (LRUCache *cache, uint32_t ind)
+{
+    LRUCacheEntry *cache_entry = &(cache->cache_entry[ind]);
+
+    cache_entry->lru_prev = LRU_CACHE_NIL;
+    cache_entry->lru_next = cache->lru_head;
+    if (cache->lru_head != LRU_CACHE_NIL) {
+        cache->cache_entry[cache->lru_head].lru_prev = ind;
+    } else {
+        /* very first entry */
+        cache->lru_tail = ind;
+    }
+    cache->lru_head = ind;
+}
+
+/*
+ * A cache without a lookup table of its own, for blocks indexed by the
+ * caller (see tier_index.h). It is driven by the entry level
+ * operations only.
+ */
+int lru_cache_init_unindexed (uint32_t cache_size, LRUCache *cache)
 {
     cache->cache_size        = cache_size;
     check (cache_size>=2, "the SSD cache size should at least be 2.");
+    check (cache_size<LRU_CACHE_NIL/2, "the SSD cache size is too large.");
 
     cache->entry_count       = 0;
-    if (cache_size < 64) {
-        cache->lookup_table_size = cache_size;
-    } else {
-        cache->lookup_table_size = get_lookup_table_size (cache_size);
-    }
+    cache->lookup_table_size = 0;
 
     /* allocate space for cache_entry */
-    cache->cache_entry = (LRUCacheEntry *) calloc (cache->cache_size,
-            sizeof(LRUCacheEntry));
+    cache->cache_entry = (LRUCacheEntry *) table_mem_alloc (cache->cache_size
+            * sizeof(LRUCacheEntry));
     check(cache->cache_entry!=NULL,
             "failed to allocate space for lru_cache->cache_entry.");
 
+    cache->lru_head = LRU_CACHE_NIL;
+    cache->lru_tail = LRU_CACHE_NIL;
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+int lru_cache_init (uint32_t cache_size, LRUCache *cache)
+{
+    int ret;
+
+    ret = lru_cache_init_unindexed (cache_size, cache);
+    check (ret!=-1, "failed to initialize the cache entries.");
+
+    cache->lookup_table_size = get_lookup_table_size (cache_size);
+
     /* allocate space for lookup_table */
-    cache->lookup_table = (LRUCacheEntry **) calloc (
-            cache->lookup_table_size, sizeof(LRUCacheEntry *));
+    cache->lookup_table = (LRUCacheSlot *) table_mem_alloc (
+            cache->lookup_table_size * sizeof(LRUCacheSlot));
     check(cache->lookup_table!=NULL,
             "failed to allocate lru_cache->lookup table.");
 
-    cache->lru_head = NULL;
-    cache->lru_tail = NULL;
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Count the write hits of every entry. Only the static buffers look
+ * at the counts, so the array is left out unless asked for.
+ */
+int lru_cache_track_writes (LRUCache *cache)
+{
+    cache->write_access_count = (uint64_t *) table_mem_alloc (
+            cache->cache_size * sizeof(uint64_t));
+    check (cache->write_access_count!=NULL,
+            "failed to allocate lru_cache->write_access_count.");
 
     return 0;
 
@@ -57,6 +195,19 @@ error:
     return -1;
 }
 
+/* Bytes of memory taken by the entries and the lookup table. */
+uint64_t lru_cache_bytes (LRUCache *cache)
+{
+    uint64_t bytes = cache->cache_size * sizeof(LRUCacheEntry)
+            + cache->lookup_table_size * sizeof(LRUCacheSlot);
+
+    if (cache->write_access_count != NULL) {
+        bytes += cache->cache_size * sizeof(uint64_t);
+    }
+
+    return bytes;
+}
+
 /* check if the request could hit in the cache.
  *
  * returns 0: cache miss
@@ -65,224 +216,89 @@ error:
  */
 int lru_cache_lookup (LRUCache *cache, Request *req)
 {
-/*    if ((req->block_num == 3314217) && (req->server_num == 0)
-            && (req->volume_num == 0)) {
-        printf("debug\n");
-    }*/
-    int exists = 0;
-    int table_slot = req->block_num % cache->lookup_table_size;
-    LRUCacheEntry  *cache_entry  = cache->lookup_table[table_slot];
-
-    if (req->req_type == 0) {
-        cache->read_lookups += 1;
-    } else {
-        cache->write_lookups += 1;
-    }
-
-    while (cache_entry != NULL) {
-        if ((cache_entry->block_num == req->block_num)   &&
-            (cache_entry->server_num == req->server_num) &&
-            (cache_entry->volume_num == req->volume_num)) {
-            exists = 1;
-            break;
-        } else {
-            cache_entry = cache_entry->lookup_next;
-        }
-    }
+    return (lru_cache_lookup_handle (cache, req) != LRU_CACHE_NIL);
+}
 
-    if (exists) {
-        if (req->req_type == 0) {
-            cache->read_hits += 1;
-        } else {
-            cache->write_hits += 1;
-            cache_entry->write_access_count += 1;
-        }
-    }
+int lru_cache_read_lookup (LRUCache *cache, Request *req)
+{
+    LRUCacheSlot *slot = lru_cache_find (cache, request_key (req));
 
-    if (exists)
-    {
-        /* update LRU information */
-        if ((cache_entry->lru_prev == NULL) && (cache_entry->lru_next == NULL)) {
-            /* the only entry in the cache, do nothing. */
-        } else {
-            if (cache_entry == cache->lru_tail) {
-                cache->lru_tail = cache_entry->lru_prev;
-                cache_entry->lru_prev->lru_next = NULL;
-                cache->lru_head->lru_prev = cache_entry;
-                cache_entry->lru_next = cache->lru_head;
-                cache_entry->lru_prev = NULL;
-                cache->lru_head = cache_entry;
-            } else {
-                if (cache_entry == cache->lru_head) {
-                    /* do nothing */
-                } else {
-                    cache_entry->lru_prev->lru_next = cache_entry->lru_next;
-                    cache_entry->lru_next->lru_prev = cache_entry->lru_prev;
-                    cache_entry->lru_prev = NULL;
-                    cache_entry->lru_next = cache->lru_head;
-                    cache->lru_head->lru_prev = cache_entry;
-                    cache->lru_head = cache_entry;
-                }
-            }
-        }
+    lru_cache_count (cache, req->req_type, slot != NULL);
 
-        /* move the entry to the front of lookup chain */
-        if ((cache_entry->lookup_prev == NULL) && (cache_entry->lookup_next == NULL)) {
-            /* the only entry in the chain, do nothing */
-        } else {
-            if (cache->lookup_table[table_slot] == cache_entry) {
-                /* it is the first entry already. do nothing. */
-            } else {
-                cache_entry->lookup_prev->lookup_next = cache_entry->lookup_next;
-                if (cache_entry->lookup_next != NULL) {
-                    cache_entry->lookup_next->lookup_prev =
-                            cache_entry->lookup_prev;
-                }
-
-                cache_entry->lookup_prev = NULL;
-                cache_entry->lookup_next = cache->lookup_table[table_slot];
-                cache->lookup_table[table_slot]->lookup_prev = cache_entry;
-                cache->lookup_table[table_slot] = cache_entry;
-            } // else (the first entry in the chain)
-        } // if (the only entry in the chain )
-
-    } // if (exists)
-
-    return exists;
+    return (slot != NULL);
 }
 
-int lru_cache_read_lookup (LRUCache *cache, Request *req)
+/*
+ * Prefetch the home slots of requests that are about to be looked up,
+ * so that their lookups, still done one by one in trace order, hit
+ * the cpu cache.
+ */
+void lru_cache_prefetch_batch (const LRUCache *cache, const Request *reqs,
+        uint32_t num_reqs)
 {
-    int exists = 0;
-    int table_slot = req->block_num % cache->lookup_table_size;
-    LRUCacheEntry  *cache_entry  = cache->lookup_table[table_slot];
-    int num_lookups = 1;
-    if (req->req_type == 0) {
-        cache->read_lookups += 1;
-    } else {
-        cache->write_lookups += 1;
-    }
-
-    while (cache_entry != NULL) {
-        num_lookups += 1;
-        check (num_lookups <= cache->cache_size, "lookups more than cache size.");
-        if ((cache_entry->block_num == req->block_num)   &&
-            (cache_entry->server_num == req->server_num) &&
-            (cache_entry->volume_num == req->volume_num)) {
-            exists = 1;
-            break;
-        } else {
-            cache_entry = cache_entry->lookup_next;
-        }
-    }
+    uint64_t mask = cache->lookup_table_size - 1;
+    uint32_t i, hash;
 
-    if (exists) {
-        if (req->req_type == 0) {
-            cache->read_hits += 1;
-        } else {
-            cache->write_hits += 1;
-        }
+    for (i = 0; i < num_reqs; i++) {
+        hash = (uint32_t) hash_u64 (request_key (&(reqs[i])));
+        __builtin_prefetch (&(cache->lookup_table[hash & mask]), 1);
     }
+}
 
-    return exists;
-
-error:
+/* Handle on the entry of req, or LRU_CACHE_NIL; nothing is counted. */
+LRUCacheHandle lru_cache_peek_handle (LRUCache *cache, Request *req)
+{
+    LRUCacheSlot *slot = lru_cache_find (cache, request_key (req));
 
-    return -1;
+    return (slot != NULL) ? slot->entry - 1 : LRU_CACHE_NIL;
 }
 
-int lru_cache_peek (LRUCache *cache, Request *req)
+/* lru_cache_lookup that hands back the entry hit, or LRU_CACHE_NIL. */
+LRUCacheHandle lru_cache_lookup_handle (LRUCache *cache, Request *req)
 {
-    int exists = 0;
-    int table_slot = req->block_num % cache->lookup_table_size;
-    LRUCacheEntry  *cache_entry  = cache->lookup_table[table_slot];
-    LRUCacheEntry  *first_entry  = cache_entry;
-    int num_lookups = 0;
-
-    while (cache_entry != NULL) {
-        num_lookups += 1;
-        check (num_lookups <= cache->cache_size, "lookups more than cache size.");
-        if ((cache_entry->block_num == req->block_num)   &&
-            (cache_entry->server_num == req->server_num) &&
-            (cache_entry->volume_num == req->volume_num)) {
-            exists = 1;
-            break;
-        } else {
-            cache_entry = cache_entry->lookup_next;
-            if (cache_entry == first_entry) {
-                printf("loop detected\n.");
-            }
-        }
+    LRUCacheHandle handle = lru_cache_peek_handle (cache, req);
+
+    if (handle == LRU_CACHE_NIL) {
+        lru_cache_count (cache, req->req_type, 0);
+        return LRU_CACHE_NIL;
     }
 
-    return exists;
+    lru_cache_access_handle (cache, handle, req);
 
-error:
+    return handle;
+}
 
-    return -1;
+int lru_cache_peek (LRUCache *cache, Request *req)
+{
+    return (lru_cache_peek_handle (cache, req) != LRU_CACHE_NIL);
 }
 
-int lru_cache_update (LRUCache *cache, Request *req)
+/* Count a lookup of req that hit handle and move it to the LRU head. */
+void lru_cache_access_handle (LRUCache *cache, LRUCacheHandle handle,
+        Request *req)
 {
-/*    if ((req->block_num == 3314217) && (req->server_num == 0)
-            && (req->volume_num == 0)) {
-        printf("debug\n");
-    }*/
-    int exists = 0;
-    int table_slot = req->block_num % cache->lookup_table_size;
-    LRUCacheEntry *cache_entry = cache->lookup_table[table_slot];
-
-    while (cache_entry != NULL) {
-        if ((cache_entry->block_num == req->block_num)
-                && (cache_entry->server_num == req->server_num)
-                && (cache_entry->volume_num == req->volume_num)) {
-            exists = 1;
-            break;
-        } else {
-            cache_entry = cache_entry->lookup_next;
-        }
+    lru_cache_count (cache, req->req_type, 1);
+    if ((req->req_type != 0) && (cache->write_access_count != NULL)) {
+        cache->write_access_count[handle] += 1;
     }
 
-    check (exists == 1, "failed to find entry to update.");
+    /* update LRU information */
+    lru_cache_touch (cache, handle);
+}
 
+/* Move handle to the LRU head, counted as an update. */
+void lru_cache_update_handle (LRUCache *cache, LRUCacheHandle handle)
+{
     cache->num_updates += 1;
+    lru_cache_touch (cache, handle);
+}
 
-    // updating LRU information
-    if (cache_entry != cache->lru_head) {
-        if (cache_entry->lru_prev != NULL) {
-            cache_entry->lru_prev->lru_next = cache_entry->lru_next;
-        }
-        if (cache_entry->lru_next != NULL) {
-            cache_entry->lru_next->lru_prev = cache_entry->lru_prev;
-        }
-
-        if (cache_entry == cache->lru_tail) {
-            cache->lru_tail = cache_entry->lru_prev;
-        }
-
-        cache_entry->lru_prev = NULL;
-        cache_entry->lru_next = cache->lru_head;
-        cache->lru_head->lru_prev = cache_entry;
-        cache->lru_head = cache_entry;
-    }
-
-    /* update lookup info, move it to the front of the chain */
-    if (cache->lookup_table[table_slot] != cache_entry) {
-        if (cache_entry->lookup_prev != NULL) {
-            cache_entry->lookup_prev->lookup_next = cache_entry->lookup_next;
-        }
-        if (cache_entry->lookup_next != NULL) {
-            cache_entry->lookup_next->lookup_prev = cache_entry->lookup_prev;
-        }
-
-        cache_entry->lookup_prev = NULL;
-        cache_entry->lookup_next = cache->lookup_table[table_slot];
+int lru_cache_update (LRUCache *cache, Request *req)
+{
+    LRUCacheHandle handle = lru_cache_peek_handle (cache, req);
 
-        if (cache->lookup_table[table_slot] != NULL) {
-            cache->lookup_table[table_slot]->lookup_prev = cache_entry;
-        }
-        cache->lookup_table[table_slot] = cache_entry;
-    }
+    check (handle != LRU_CACHE_NIL, "failed to find entry to update.");
+    lru_cache_update_handle (cache, handle);
 
     return 0;
 
@@ -291,150 +307,95 @@ error:
     return -1;
 }
 
-int lru_cache_remove (LRUCache *cache, Request *req)
+/* Move handle to the LRU head. */
+void lru_cache_touch (LRUCache *cache, LRUCacheHandle handle)
 {
-/*    if ((req->block_num == 3314217) && (req->server_num == 0)
-            && (req->volume_num == 0)) {
-        printf("debug\n");
-    }*/
-    int exists = 0;
-    int table_slot = req->block_num % cache->lookup_table_size;
-    LRUCacheEntry *cache_entry = cache->lookup_table[table_slot];
-
-    while (cache_entry != NULL) {
-        if ((cache_entry->block_num == req->block_num)
-                && (cache_entry->server_num == req->server_num)
-                && (cache_entry->volume_num == req->volume_num)) {
-            exists = 1;
-            break;
-        } else {
-            cache_entry = cache_entry->lookup_next;
-        }
+    if (handle != cache->lru_head) {
+        lru_cache_unlink (cache, handle);
+        lru_cache_push_head (cache, handle);
     }
+}
 
-    check (exists == 1, "failed to find entry to remove.");
-
-    cache->num_removes += 1;
+/*
+ * Write hits of handle, NULL unless lru_cache_track_writes was called.
+ * The count may be read and updated through the pointer.
+ */
+uint64_t *lru_cache_write_count (LRUCache *cache, LRUCacheHandle handle)
+{
+    if (cache->write_access_count == NULL) {
+        return NULL;
+    }
 
-    // updating LRU information
+    return &(cache->write_access_count[handle]);
+}
 
-    if ((cache_entry == cache->lru_head) && (cache_entry == cache->lru_tail)) {
-        // the only entry in the cache
-        check (cache->entry_count == 1, "failed to verify to be the only entry.");
-        cache->lru_head = NULL;
-        cache->lru_tail = NULL;
-        cache->entry_count = 0;
-        cache->lookup_table[table_slot] = NULL;
+/* The lookup table slot of handle, found without comparing keys. */
+static inline LRUCacheSlot *lru_cache_slot_of (LRUCache *cache,
+        LRUCacheHandle handle)
+{
+    uint64_t mask = cache->lookup_table_size - 1;
+    uint64_t i    = hash_u64 (cache->cache_entry[handle].key) & mask;
 
-        return 0;
-    } else {
-        if (cache_entry == cache->lru_head) {
-            if (cache_entry->lru_next != NULL) {
-                cache_entry->lru_next->lru_prev = NULL;
-            }
-            cache->lru_head = cache_entry->lru_next;
-        } else if (cache_entry == cache->lru_tail) {
-            if (cache_entry->lru_prev != NULL) {
-                cache_entry->lru_prev->lru_next = NULL;
-            }
-            cache->lru_tail = cache_entry->lru_prev;
-        } else {
-            cache_entry->lru_prev->lru_next = cache_entry->lru_next;
-            cache_entry->lru_next->lru_prev = cache_entry->lru_prev;
-        }
-    }
-    cache_entry->lru_next = NULL;
-    cache_entry->lru_prev = NULL;
-
-    /* update lookup info */
-    if (cache->lookup_table[table_slot] == cache_entry) {
-        check(cache_entry->lookup_prev==NULL, "failed to verify lookup head.");
-        if (cache_entry->lookup_next != NULL) {
-            cache_entry->lookup_next->lookup_prev = NULL;
-        }
-        cache->lookup_table[table_slot] = cache_entry->lookup_next;
-    } else if (cache_entry->lookup_next == NULL) {
-        cache_entry->lookup_prev->lookup_next = NULL;
-    } else {
-        cache_entry->lookup_prev->lookup_next = cache_entry->lookup_next;
-        cache_entry->lookup_next->lookup_prev = cache_entry->lookup_prev;
+    while (cache->lookup_table[i].entry != handle + 1) {
+        i = (i + 1) & mask;
     }
-    cache_entry->lookup_next = NULL;
-    cache_entry->lookup_prev = NULL;
-
-    /* move the last entry to the current position*/
 
-    check (cache->entry_count >= 1, "failed to remove entry from empty cache.");
-    LRUCacheEntry *entry = &(cache->cache_entry[cache->entry_count-1]);
-/*    if ((entry->block_num == 3314217) && (entry->server_num == 0)
-            && (entry->volume_num == 0)) {
-        printf("debug\n");
-    }*/
+    return &(cache->lookup_table[i]);
+}
 
-    if (cache_entry == entry) {
-        cache->entry_count -= 1;
-        return 0;
-    }
+/*
+ * Remove the entry of handle. The last entry is moved into the hole
+ * and taken to the LRU head; returns its old handle, or LRU_CACHE_NIL
+ * if handle was the last entry. Other handles stay valid.
+ */
+LRUCacheHandle lru_cache_remove_handle (LRUCache *cache, LRUCacheHandle handle)
+{
+    uint32_t last = cache->entry_count - 1;
+    LRUCacheEntry *cache_entry = &(cache->cache_entry[handle]);
 
-    if (entry->lru_prev != NULL) {
-        entry->lru_prev->lru_next = cache_entry;
+    cache->num_removes += 1;
+    if (cache->lookup_table != NULL) {
+        lru_cache_unindex (cache, lru_cache_slot_of (cache, handle));
     }
+    lru_cache_unlink (cache, handle);
+    cache->entry_count -= 1;
 
-    if (entry->lru_next != NULL) {
-        entry->lru_next->lru_prev = cache_entry;
+    if (handle == last) {
+        return LRU_CACHE_NIL;
     }
 
-    if (entry->lookup_prev != NULL) {
-        entry->lookup_prev->lookup_next = cache_entry;
+    /* move the last entry to the hole, taking over its LRU position */
+    if (cache->lookup_table != NULL) {
+        lru_cache_slot_of (cache, last)->entry = handle + 1;
     }
-
-    if (entry->lookup_next != NULL) {
-        entry->lookup_next->lookup_prev = cache_entry;
+    *cache_entry = cache->cache_entry[last];
+    if (cache->write_access_count != NULL) {
+        cache->write_access_count[handle] = cache->write_access_count[last];
     }
 
-    table_slot = entry->block_num % cache->lookup_table_size;
-    if (cache->lookup_table[table_slot] == entry) {
-        cache->lookup_table[table_slot] = cache_entry;
+    if (cache_entry->lru_prev != LRU_CACHE_NIL) {
+        cache->cache_entry[cache_entry->lru_prev].lru_next = handle;
+    } else {
+        cache->lru_head = handle;
     }
-
-    if (cache->lru_head == entry) {
-        cache->lru_head = cache_entry;
+    if (cache_entry->lru_next != LRU_CACHE_NIL) {
+        cache->cache_entry[cache_entry->lru_next].lru_prev = handle;
+    } else {
+        cache->lru_tail = handle;
     }
 
-    if (cache->lru_tail == entry) {
-        cache->lru_tail = cache_entry;
-    }
+    /* move entry to the lru head */
+    lru_cache_touch (cache, handle);
 
-    /*copy the content of the last entry to the current position */
-    cache_entry->block_num = entry->block_num;
-    cache_entry->server_num = entry->server_num;
-    cache_entry->volume_num = entry->volume_num;
-    cache_entry->write_access_count = entry->write_access_count;
-    cache_entry->lookup_next = entry->lookup_next;
-    cache_entry->lookup_prev = entry->lookup_prev;
-    cache_entry->lru_next = entry->lru_next;
-    cache_entry->lru_prev = entry->lru_prev;
+    return last;
+}
 
-    /* move entry to the lru head */
-    if (cache->lru_head != cache_entry) {
-        if (cache->lru_tail == cache_entry ){
-            cache_entry->lru_prev->lru_next = NULL;
-            cache->lru_tail = cache_entry->lru_prev;
-            cache_entry->lru_prev = NULL;
-            cache_entry->lru_next = cache->lru_head;
-            cache->lru_head->lru_prev = cache_entry;
-            cache->lru_head = cache_entry;
-        } else {
-            cache_entry->lru_prev->lru_next = cache_entry->lru_next;
-            cache_entry->lru_next->lru_prev = cache_entry->lru_prev;
-            cache_entry->lru_prev = NULL;
-            cache_entry->lru_next = cache->lru_head;
-            cache->lru_head->lru_prev = cache_entry;
-            cache->lru_head = cache_entry;
-        }
-    }
+int lru_cache_remove (LRUCache *cache, Request *req)
+{
+    LRUCacheHandle handle = lru_cache_peek_handle (cache, req);
 
-    cache->entry_count -= 1;
+    check (handle != LRU_CACHE_NIL, "failed to find entry to remove.");
+    lru_cache_remove_handle (cache, handle);
 
     return 0;
 
@@ -443,125 +404,88 @@ error:
     return -1;
 }
 
-int lru_cache_insert  (LRUCache *cache, uint64_t block_num, uint8_t server_num,
-                        uint8_t volume_num, Request *replaced_req)
+/*
+ * Put key, which must not be cached yet, at the LRU head. Its handle
+ * goes to handle; returns 1 if that replaced the LRU tail, 0 if a
+ * free entry was taken.
+ */
+int lru_cache_insert_handle (LRUCache *cache, BlockKey key,
+        LRUCacheHandle *handle)
 {
-
-/*    if ((block_num == 3314217) && (server_num == 0)
-            && (volume_num == 0)) {
-        printf("debug\n");
-    }*/
-
-    LRUCacheEntry *cache_entry = NULL;
-    int            table_slot  = -1;
-    int            ret         = 0;
+    int ret = 0;
 
     cache->num_writes += 1;
 
     if (cache->entry_count == cache->cache_size) {
         /* replacing an existing entry */
-        cache_entry = cache->lru_tail;
-        replaced_req->block_num = cache_entry->block_num;
-        replaced_req->server_num = cache_entry->server_num;
-        replaced_req->volume_num = cache_entry->volume_num;
+        *handle = cache->lru_tail;
         cache->num_replaces += 1;
         ret = 1;
-
-        /* updating LRU info */
-        cache->lru_tail = cache_entry->lru_prev;
-        cache_entry->lru_prev->lru_next = NULL;
-
-        cache_entry->lru_prev = NULL;
-        cache_entry->lru_next = cache->lru_head;
-        cache->lru_head->lru_prev = cache_entry;
-        cache->lru_head = cache_entry;
-
-        /* update lookup info */
-        /* remove it from the original lookup chain */
-
-        table_slot = cache_entry->block_num % cache->lookup_table_size;
-
-        if (cache->lookup_table[table_slot] == cache_entry) {
-            /*if it is the first one in the chain */
-            if (cache_entry->lookup_next == NULL) {
-                /* if it is the only one in the chain */
-                cache->lookup_table[table_slot] = NULL;
-            } else {
-                /* if it is first one but not the only one */
-                cache->lookup_table[table_slot] = cache_entry->lookup_next;
-                cache_entry->lookup_next->lookup_prev = NULL;
-            }
-        } else {
-            /* if it is not the first one in the chain */
-            if (cache_entry->lookup_next == NULL) {
-                /* if it is the last one in the chain */
-                cache_entry->lookup_prev->lookup_next = NULL;
-            } else {
-                /* if it is neither the first one nor the last one */
-                cache_entry->lookup_prev->lookup_next = cache_entry->lookup_next;
-                cache_entry->lookup_next->lookup_prev = cache_entry->lookup_prev;
-            }
-        }
-
-        /* insert it to the head of the new lookup chain */
-        table_slot = block_num % cache->lookup_table_size;
-        cache_entry->lookup_prev = NULL;
-        cache_entry->lookup_next = cache->lookup_table[table_slot];
-        if (cache->lookup_table[table_slot] != NULL) {
-            cache->lookup_table[table_slot]->lookup_prev = cache_entry;
+        if (cache->lookup_table != NULL) {
+            lru_cache_unindex (cache, lru_cache_slot_of (cache, *handle));
         }
-        cache->lookup_table[table_slot] = cache_entry;
-        cache_entry->block_num  = block_num;
-        cache_entry->server_num = server_num;
-        cache_entry->volume_num = volume_num;
-        cache_entry->write_access_count = 0;
+        lru_cache_unlink (cache, *handle);
     } else {
         /* inserting a new entry */
-        cache_entry = &(cache->cache_entry[cache->entry_count]);
-        cache_entry->block_num  = block_num;
-        cache_entry->server_num = server_num;
-        cache_entry->volume_num = volume_num;
-        cache_entry->write_access_count = 0;
-
-        /* update LRU info */
-        if (cache->lru_head == NULL) {
-            /* very first entry */
-            cache->lru_head = cache_entry;
-            cache->lru_tail = cache_entry;
-            cache_entry->lru_prev = NULL;
-            cache_entry->lru_next = NULL;
-        } else {
-            cache_entry->lru_prev = NULL;
-            cache_entry->lru_next = cache->lru_head;
-            cache->lru_head->lru_prev = cache_entry;
-            cache->lru_head = cache_entry;
-        }
+        *handle = cache->entry_count;
+        cache->entry_count += 1;
+    }
 
-        /* update lookup info */
-        table_slot = block_num % cache->lookup_table_size;
+    cache->cache_entry[*handle].key = key;
+    if (cache->write_access_count != NULL) {
+        cache->write_access_count[*handle] = 0;
+    }
+    lru_cache_push_head (cache, *handle);
+    if (cache->lookup_table != NULL) {
+        lru_cache_index (cache, key, *handle);
+    }
 
-        cache_entry->lookup_prev = NULL;
-        cache_entry->lookup_next = cache->lookup_table[table_slot];
+    return ret;
+}
 
-        if (cache->lookup_table[table_slot] != NULL) {
-            cache->lookup_table[table_slot]->lookup_prev = cache_entry;
-        }
-        cache->lookup_table[table_slot] = cache_entry;
+int lru_cache_insert  (LRUCache *cache, uint64_t block_num, uint32_t volume_id,
+                        Request *replaced_req)
+{
+    uint64_t key;
+    LRUCacheHandle handle;
 
-        cache->entry_count += 1;
+    if (cache->entry_count == cache->cache_size) {
+        key = cache->cache_entry[cache->lru_tail].key;
+        replaced_req->block_num = block_key_block_num (key);
+        replaced_req->volume_id = block_key_volume_id (key);
     }
 
-    return ret;
+    return lru_cache_insert_handle (cache, block_key (block_num, volume_id),
+            &handle);
+}
+
+/*
+ * Move the block of handle from one cache to the LRU head of another,
+ * as lru_cache_remove plus lru_cache_insert without the probes.
+ */
+int lru_cache_move (LRUCache *from, LRUCacheHandle handle, LRUCache *to,
+        Request *replaced_req)
+{
+    uint64_t key = from->cache_entry[handle].key;
+
+    lru_cache_remove_handle (from, handle);
+
+    return lru_cache_insert (to, block_key_block_num (key),
+            block_key_volume_id (key), replaced_req);
 }
 
 void lru_cache_destroy (LRUCache *cache)
 {
     if (cache->cache_entry != NULL) {
-        free (cache->cache_entry);
+        table_mem_free (cache->cache_entry);
     }
 
     if (cache->lookup_table != NULL) {
-        free (cache->lookup_table);
+        table_mem_free (cache->lookup_table);
+    }
+
+    if (cache->write_access_count != NULL) {
+        table_mem_free (cache->write_access_count);
     }
 
     free (cache);
@@ -569,25 +493,23 @@ void lru_cache_destroy (LRUCache *cache)
 
 void print_lru_cache (LRUCache *cache)
 {
-    int i;
-    LRUCacheEntry *cache_entry = NULL;
+    uint64_t i;
+    uint32_t ind;
 
     printf("++++++++++++++++++++++++++++++++++++\n");
     for (i = 0; i < cache->lookup_table_size; i++) {
-        printf("SLOT %d: ", i);
-        cache_entry = cache->lookup_table[i];
-        while (cache_entry != NULL) {
-            printf("%"PRIu64"\t", cache_entry->block_num);
-            cache_entry = cache_entry->lookup_next;
+        ind = cache->lookup_table[i].entry;
+        if (ind != 0) {
+            printf("SLOT %"PRIu64": %"PRIu64"\n", i,
+                    block_key_block_num (cache->cache_entry[ind - 1].key));
         }
-        printf("\n");
     }
 
     printf("LRU:\t");
-    cache_entry = cache->lru_head;
-    while (cache_entry != NULL) {
-        printf("%"PRIu64"\t", cache_entry->block_num);
-        cache_entry = cache_entry->lru_next;
+    ind = cache->lru_head;
+    while (ind != LRU_CACHE_NIL) {
+        printf("%"PRIu64"\t", block_key_block_num (cache->cache_entry[ind].key));
+        ind = cache->cache_entry[ind].lru_next;
     }
     printf("\n++++++++++++++++++++++++++++++++++++\n\n");
 
@@ -607,13 +529,12 @@ void print_lru_cache (LRUCache *cache)
 
     for (i = 0; i < 20; i++) {
         req.block_num = block_array[i];
-        req.server_num = 0;
-        req.volume_num = 0;
+        req.volume_id = 0;
 
         ret = lru_cache_lookup(lru_cache, &req);
         if (ret == 0) {
-            lru_cache_insert(lru_cache, req.block_num, req.server_num,
-                    req.volume_num, &replaced_req);
+            lru_cache_insert(lru_cache, req.block_num, req.volume_id,
+                    &replaced_req);
         }
 
         print_lru_cache(lru_cache);
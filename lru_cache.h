@@ -3,26 +3,41 @@
 
 #include "common.h"
 
+#define LRU_CACHE_NIL       UINT32_MAX      // No entry
+
+typedef uint32_t LRUCacheHandle;            // Index into cache_entry
+
+/*
+ * 16 bytes per cached block: the block_key() of the block and the
+ * LRU neighbours as indices into cache_entry.
+ */
 typedef struct LRUCacheEntry {
-    uint64_t                     write_access_count;
-    uint64_t                     block_num;
-    uint8_t                      server_num;
-    uint8_t                      volume_num;
-    struct LRUCacheEntry        *lookup_next;
-    struct LRUCacheEntry        *lookup_prev;
-    struct LRUCacheEntry        *lru_next;
-    struct LRUCacheEntry        *lru_prev;
-} LRUCacheEntry __attribute__((aligned (64)));
+    BlockKey                     key;
+    uint32_t                     lru_next;
+    uint32_t                     lru_prev;
+} LRUCacheEntry;
+
+/*
+ * Robin Hood hashed slot of the lookup table. hash is the low half of
+ * hash_u64(key), enough to find the home slot and to skip most
+ * entries without touching them. entry is kept one up so that a zeroed
+ * table is empty and its pages need not be touched at init.
+ */
+typedef struct LRUCacheSlot {
+    uint32_t                     hash;
+    uint32_t                     entry;     // Handle + 1, 0 - empty slot
+} LRUCacheSlot;
 
 
 typedef struct LRUCache {
     uint64_t           cache_size;         // The total number of entries
     uint64_t           entry_count;        // The number of entries currently being occupied
-    uint64_t           lookup_table_size;  // The size of hash lookup table
+    uint64_t           lookup_table_size;  // The size of hash lookup table, power of 2
     LRUCacheEntry     *cache_entry;
-    LRUCacheEntry    **lookup_table;
-    LRUCacheEntry     *lru_head;
-    LRUCacheEntry     *lru_tail;
+    LRUCacheSlot      *lookup_table;
+    uint64_t          *write_access_count; // Per entry, only if tracked
+    uint32_t           lru_head;
+    uint32_t           lru_tail;
     uint64_t           read_lookups;
     uint64_t           write_lookups;
     uint64_t           read_hits;
@@ -33,15 +48,55 @@ typedef struct LRUCache {
     uint64_t           num_replaces;
 }LRUCache;
 
+uint64_t get_lookup_table_size (uint64_t cache_size);
 int  lru_cache_init    (uint32_t cache_size, LRUCache *lru_cache);
+int  lru_cache_init_unindexed (uint32_t cache_size, LRUCache *lru_cache);
+int  lru_cache_track_writes (LRUCache *lru_cache);
+uint64_t lru_cache_bytes (LRUCache *lru_cache);
 int  lru_cache_lookup  (LRUCache *lru_cache, Request *req);
 int  lru_cache_read_lookup  (LRUCache *lru_cache, Request *req);
 int  lru_cache_peek (LRUCache *cache, Request *req);
+void lru_cache_prefetch_batch (const LRUCache *lru_cache, const Request *reqs,
+        uint32_t num_reqs);
 int  lru_cache_insert  (LRUCache *lru_cache, uint64_t block_num,
-        uint8_t server_num, uint8_t volume_num, Request *replaced_req);
+        uint32_t volume_id, Request *replaced_req);
 int  lru_cache_remove  (LRUCache *lru_cache, Request *req);
 int  lru_cache_update  (LRUCache *lru_cache, Request *req);
 void lru_cache_destroy (LRUCache *lru_cache);
+
+/*
+ * Handles name cached blocks by their entry, so the operations that
+ * follow a lookup or peek do not probe the lookup table again. A
+ * handle holds until its block is removed or replaced; removing
+ * another block may move the last entry, see lru_cache_remove_handle.
+ * Caches made by lru_cache_init_unindexed are driven by handles only.
+ */
+LRUCacheHandle lru_cache_lookup_handle (LRUCache *lru_cache, Request *req);
+LRUCacheHandle lru_cache_peek_handle   (LRUCache *lru_cache, Request *req);
+void lru_cache_access_handle (LRUCache *lru_cache, LRUCacheHandle handle,
+        Request *req);
+void lru_cache_touch         (LRUCache *lru_cache, LRUCacheHandle handle);
+void lru_cache_update_handle (LRUCache *lru_cache, LRUCacheHandle handle);
+uint64_t *lru_cache_write_count (LRUCache *lru_cache, LRUCacheHandle handle);
+LRUCacheHandle lru_cache_remove_handle (LRUCache *lru_cache,
+        LRUCacheHandle handle);
+int  lru_cache_insert_handle (LRUCache *lru_cache, BlockKey key,
+        LRUCacheHandle *handle);
+int  lru_cache_move (LRUCache *from, LRUCacheHandle handle, LRUCache *to,
+        Request *replaced_req);
+
+/* Account a lookup of req_type that hit or missed. */
+static inline void lru_cache_count (LRUCache *lru_cache, uint8_t req_type,
+        int hit)
+{
+    if (req_type == 0) {
+        lru_cache->read_lookups += 1;
+        lru_cache->read_hits += hit;
+    } else {
+        lru_cache->write_lookups += 1;
+        lru_cache->write_hits += hit;
+    }
+}
 void lru_cache_test    ();
 
 #endif
@@ -16,786 +16,116 @@
 #include "miss_filter.h"
 #include "miss_table.h"
 #include "static_buffer.h"
+#include "table_mem.h"
 #include "ghost_cache.h"
+#include "trace.h"
+#include "trace_stream.h"
+#include "simulator.h"
+#include "sweep.h"
+#include "shard.h"
+#include "pipeline.h"
 
 #define LCHILD(x) ((x<<1) + 1)
 #define RCHILD(x) ((x<<1) + 2)
 
+#define SWEEP_MAX_ARGS 16
+
 /* Global variables */
 uint64_t starting_time_stamp; /* the first request timestamp in 100ns */
 uint64_t time_window_size; /* time window size in 100ns */
 
-static void usage(const char *argv0) {
-    printf("Usage: \n");
-    printf("\t base line sieve store   : %s 0\n", argv0);
-    printf("\t traditional write buffer: %s 1 tr_wb_size\n", argv0);
-    printf("\t sieved write buffer     : %s 2 s_wb_threshold s_wb_size\n", argv0);
-    printf("\t sieved + traditional write buffer: %s 3 "
-            "s_wb_threshold s_wb_size tr_wb_size\n",
-            argv0);
-}
-
-int run_sieved_write_buffer(ConfigInfo *config_info) {
-    int ret;
-    uint64_t i;
-    FILE *trace_fp = NULL;
-    FILE *out_fp = NULL;
-    char line[FILE_LINE_SIZE];
-    CSVLineData csv_data;
-
-    Request req, replaced_req;
-    int num_blocks;
-    int progress = 10;
-
-    LRUCache   *write_buffer = NULL;
-    MissFilter *miss_filter = NULL;
-    MissTable  *miss_table = NULL;
-    GhostCache *wb_ghost_cache = NULL;
-    LRUCache   *ssd_cache = NULL;
-
-    struct timeval start, end;
-    uint64_t tot_reads = 0, tot_writes = 0, tot_reqs = 0, tot_lines = 1;
-
-    /* initializations */
-
-    out_fp = fopen (config_info->result_file, "w");
-    check (out_fp!=NULL, "failed to open result file: %s.",
-                config_info->result_file);
-
-    write_buffer = (LRUCache *) calloc (1, sizeof(LRUCache));
-    check (write_buffer!=NULL, "failed to allocate write_buffer.");
-    ret = lru_cache_init (config_info->sieved_wb_size, write_buffer);
-    check (ret != -1, "failed to initialize write_buffer.");
-
-    miss_filter = (MissFilter *) calloc(1, sizeof(MissFilter));
-    check(miss_filter!=NULL, "failed to allocate miss_filter.");
-    ret = miss_filter_init(config_info->miss_filter_size,
-            config_info->miss_filter_threshold, config_info->num_sub_windows,
-            miss_filter);
-    check(ret!=-1, "failed to initialize miss_filter.");
-
-    miss_table = (MissTable *) calloc(1, sizeof(MissTable));
-    check(miss_table!=NULL, "failed to allocate miss_table.");
-    ret = miss_table_init(config_info->miss_table_lookup_size,
-            config_info->miss_table_threshold, config_info->num_sub_windows,
-            miss_table);
-    check(ret!=-1, "failed to initialize miss_table.");
-
-    wb_ghost_cache = (GhostCache *) calloc(1, sizeof(GhostCache));
-    check(wb_ghost_cache!=NULL, "failed to allocate wb_ghost_cache.");
-    ret = ghost_cache_init(config_info->sieved_ghost_cache_size,
-            config_info->sieved_wb_threshold, config_info->num_sub_windows,
-            wb_ghost_cache);
-    check(ret!=-1, "failed to initialize wb_ghost_cache.");
-
-    ssd_cache = (LRUCache *) calloc(1, sizeof(LRUCache));
-    check(ssd_cache!=NULL, "failed to allocate ssd_cache.");
-    ret = lru_cache_init(config_info->ssd_size, ssd_cache);
-    check(ret!=-1, "failed to initialize ssd_cache.");
-
-    /* start simulation */
-    gettimeofday(&start, NULL);
-
-    /* go over trace file */
-    trace_fp = fopen(config_info->trace_file, "r");
-    check(trace_fp!=NULL, "failed to open trace file:%s\n",
-            config_info->trace_file);
-
-    while (fgets(line, sizeof(line), trace_fp) != NULL) {
-        ret = sscanf(line, "%"SCNu64" %"SCNu8" %"SCNu8" %s %"SCNu64" %"SCNu32" "
-        "%"SCNu64"\n", &csv_data.timestamp, &csv_data.server_num,
-                &csv_data.volume_num, csv_data.req_type, &csv_data.start_addr,
-                &csv_data.req_size, &csv_data.duration);
-        check(ret==7, "failed to parse csv line:\n\t%s\n", line);
-        tot_lines += 1;
-
-        /* first line of trace file, extract starting timestamp */
-        if (tot_reqs == 0) {
-            starting_time_stamp = csv_data.timestamp;
-        }
-
-        req.block_num = (csv_data.start_addr >> LOG_2_BLOCK_SIZE);
-        num_blocks = (csv_data.req_size >> LOG_2_BLOCK_SIZE);
-        if (num_blocks == 0) {
-            num_blocks = 1;
-        }
-
-        if (strcmp(csv_data.req_type, "Write") == 0) {
-            req.req_type = 1;
-        } else {
-            req.req_type = 0;
-        }
-
-        req.server_num = csv_data.server_num;
-        req.volume_num = csv_data.volume_num;
-        req.sub_window_ind = (csv_data.timestamp - starting_time_stamp)
-                            / SUB_WINDOW_SIZE;
-
-        for (i = 0; i < num_blocks; i++) {
-
-            tot_reqs += 1;
-
-            if (tot_reqs % 292000000 == 0) {
-                printf("%d%% is done.\n", progress);
-                progress += 10;
-            }
-
-            if (req.req_type == 0) {
-                // read request
-                tot_reads += 1;
-                ret = lru_cache_read_lookup(write_buffer, &req);
-                if (ret == 0) {
-                    ret = lru_cache_lookup(ssd_cache, &req);
-                }
-                if (ret == 0) {
-                    ret = miss_filter_lookup(miss_filter, &req);
-                    if (ret == 1) {
-                        /*hits in miss_filter, check miss_table*/
-                        ret = miss_table_access(miss_table, &req);
-                        /*hits in miss_table, insert it to ssd_cache*/
-                        if (ret == 1) {
-                            lru_cache_insert(ssd_cache, req.block_num,
-                                    req.server_num, req.volume_num,
-                                    &replaced_req);
-                        } // hits in miss_table
-                    } // hits in miss_filter
-                }
-            } else {
-                // write request
-                tot_writes += 1;
-                ret = lru_cache_lookup(write_buffer, &req);
-                if (ret == 0) {
-                    ret = lru_cache_peek(ssd_cache, &req);
-                    if (ret == 0) {
-                        // miss in ssd_cache
-                        ret = miss_filter_lookup(miss_filter, &req);
-                        if (ret == 1) {
-                            /*hits in miss_filter, check miss_table*/
-                            ret = miss_table_access(miss_table, &req);
-                            /*hits in miss_table, insert it to ssd_cache*/
-                            if (ret == 1) {
-                                ret = ghost_cache_access (wb_ghost_cache, &req);
-                                if (ret == 0) {
-                                    // allocate to ssd
-                                    lru_cache_insert(ssd_cache, req.block_num,
-                                            req.server_num, req.volume_num,
-                                            &replaced_req);
-                                } else {
-                                    // allocate to wb
-                                    ret = lru_cache_insert(write_buffer,
-                                            req.block_num, req.server_num,
-                                            req.volume_num, &replaced_req);
-                                    if (ret == 1) {
-                                        ret = lru_cache_peek(ssd_cache,
-                                                &replaced_req);
-                                        if (ret == 1) {
-                                            ret = lru_cache_update(ssd_cache,
-                                                    &replaced_req);
-                                            check(ret==0,
-                                                    "failed to update entry in ssd_cache.");
-                                        } else {
-                                            lru_cache_insert(ssd_cache,
-                                                    replaced_req.block_num,
-                                                    replaced_req.server_num,
-                                                    replaced_req.volume_num,
-                                                    &req);
-                                        }
-                                    } // write buffer has a replaced entry
-                                } // allocate to wb
-                            } // hits in miss_table
-                        } // hits in miss_filter
-                    } else {
-                        // hits in ssd_cache
-                        ret = ghost_cache_access (wb_ghost_cache, &req);
-                        if (ret == 1) {
-                            ret = lru_cache_remove(ssd_cache, &req);
-                            check(ret==0,
-                                    "failed to remove entry from ssd_cache.");
-                            ret = lru_cache_insert(write_buffer, req.block_num,
-                                    req.server_num, req.volume_num,
-                                    &replaced_req);
-                            if (ret == 1) {
-                                ret = lru_cache_peek(ssd_cache, &replaced_req);
-                                if (ret == 1) {
-                                    ret = lru_cache_update(ssd_cache,
-                                            &replaced_req);
-                                    check(ret==0,
-                                            "failed to update entry in ssd_cache.");
-                                } else {
-                                    lru_cache_insert(ssd_cache,
-                                            replaced_req.block_num,
-                                            replaced_req.server_num,
-                                            replaced_req.volume_num, &req);
-                                }
-                            } // write buffer has a replaced entry
-                        } else {
-                            // cannot make into the write buffer
-                            // write to ssd instead.
-                            ret = lru_cache_lookup(ssd_cache, &req);
-                        }
-                    }
-                }
-            } // write request
-            req.block_num += 1;
-        } // loop through each request
-    } // loop through each line from the trace file
-
-    gettimeofday(&end, NULL);
-
-    fprintf(out_fp, "total number of requests: %"PRIu64"\n", tot_reqs);
-    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", tot_reads);
-    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", tot_writes);
-    long duration = (end.tv_sec - start.tv_sec) * 1000000
-                + (end.tv_usec - start.tv_usec);
-    fprintf(out_fp, "time consumed = %.4f (min)\n",
-                (double) duration / (1000000.0 * 60.0));
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "sieved write buffer: \n");
-    fprintf(out_fp, "sieved_wb_size  :  %"PRIu64"\n", write_buffer->cache_size);
-    fprintf(out_fp, "read hits       :  %"PRIu64"\n", write_buffer->read_hits);
-    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", write_buffer->read_lookups);
-    fprintf(out_fp, "read hits ratio :  %.4f\n",
-          (double) write_buffer->read_hits/(double) write_buffer->read_lookups);
-    fprintf(out_fp, "write hits      :  %"PRIu64"\n", write_buffer->write_hits);
-    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", write_buffer->write_lookups);
-    fprintf(out_fp, "write hits ratio:  %.4f\n",
-          (double) write_buffer->write_hits/(double) write_buffer->write_lookups);
-    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", write_buffer->num_writes);
-    fprintf(out_fp, "num updates     :  %"PRIu64"\n", write_buffer->num_updates);
-    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", write_buffer->num_replaces);
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "ssd cache: \n");
-
-    fprintf(out_fp, "ssd cache size: %"PRIu64":\n", ssd_cache->cache_size);
-    fprintf(out_fp, "ssd cache miss filter threshold: %"PRIu32"\n",
-            miss_filter->threshold);
-    fprintf(out_fp, "ssd cache miss table threshold: %"PRIu32"\n",
-            miss_table->threshold);
-    fprintf(out_fp, "num sub windows: %"PRIu8"\n", miss_filter->num_sub_windows);
-    fprintf(out_fp, "read hits       :  %"PRIu64"\n", ssd_cache->read_hits);
-    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", ssd_cache->read_lookups);
-    fprintf(out_fp, "read hits ratio :  %.4f\n",
-          (double) ssd_cache->read_hits/(double) ssd_cache->read_lookups);
-    fprintf(out_fp, "write hits      :  %"PRIu64"\n", ssd_cache->write_hits);
-    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", ssd_cache->write_lookups);
-    fprintf(out_fp, "write hits ratio:  %.4f\n",
-          (double) ssd_cache->write_hits/(double) ssd_cache->write_lookups);
-    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", ssd_cache->num_writes);
-    fprintf(out_fp, "num removes     :  %"PRIu64"\n", ssd_cache->num_removes);
-    fprintf(out_fp, "num updates     :  %"PRIu64"\n", ssd_cache->num_updates);
-    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", ssd_cache->num_replaces);
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "ghost cache: \n");
-
-    fprintf (out_fp, "ghost cache size: %"PRIu64"\n", wb_ghost_cache->cache_size);
-    fprintf (out_fp, "ghost cache threshold: %"PRIu32"\n", wb_ghost_cache->threshold);
-    fprintf (out_fp, "ghost cache num_sub_windows: %"PRIu8"\n",
-            wb_ghost_cache->num_sub_windows);
-    fprintf (out_fp, "num_inserts    :  %"PRIu32"\n", wb_ghost_cache->num_inserts);
-    fprintf (out_fp, "num_replaces    : %"PRIu32"\n", wb_ghost_cache->num_replaces);
-
-    /* destroy resource */
-    fclose(trace_fp);
-    fclose(out_fp);
-    lru_cache_destroy (write_buffer);
-    miss_filter_destroy(miss_filter);
-    miss_table_destroy(miss_table);
-    ghost_cache_destroy(wb_ghost_cache);
-    lru_cache_destroy(ssd_cache);
-
-    return 0;
-
-error:
-    if (trace_fp != NULL) {
-        fclose(trace_fp);
-    }
-
-    if (out_fp != NULL) {
-        fclose(out_fp);
-    }
-
-    if (write_buffer != NULL) {
-        lru_cache_destroy (write_buffer);
-    }
-
-    if (miss_filter != NULL) {
-        miss_filter_destroy(miss_filter);
-    }
-
-    if (miss_table != NULL) {
-        miss_table_destroy(miss_table);
-    }
-
-    if (wb_ghost_cache != NULL) {
-        ghost_cache_destroy(wb_ghost_cache);
-    }
-
-    if (ssd_cache != NULL) {
-        lru_cache_destroy(ssd_cache);
-    }
-
-    return -1;
-}
-
-int run_traditional_write_buffer(ConfigInfo *config_info) {
-    int ret;
-    uint64_t i;
-    FILE *trace_fp = NULL;
-    FILE *out_fp = NULL;
-    char line[FILE_LINE_SIZE];
-    CSVLineData csv_data;
-
-    Request req, replaced_req;
-    int num_blocks;
-    int progress = 10;
-
-    LRUCache   *write_buffer = NULL;
-    MissFilter *miss_filter = NULL;
-    MissTable  *miss_table = NULL;
-    LRUCache   *ssd_cache = NULL;
-
-    struct timeval start, end;
-    uint64_t tot_reads = 0, tot_writes = 0, tot_reqs = 0, tot_lines = 1;
-
-    /* initializations */
-
-    out_fp = fopen (config_info->result_file, "w");
-    check (out_fp!=NULL, "failed to open result file: %s.",
-                config_info->result_file);
-
-    write_buffer = (LRUCache *) calloc (1, sizeof(LRUCache));
-    check (write_buffer!=NULL, "failed to allocate write_buffer.");
-    ret = lru_cache_init (config_info->traditional_wb_size, write_buffer);
-    check (ret != -1, "failed to initialize write_buffer.");
-
-    miss_filter = (MissFilter *) calloc(1, sizeof(MissFilter));
-    check(miss_filter!=NULL, "failed to allocate miss_filter.");
-    ret = miss_filter_init(config_info->miss_filter_size,
-            config_info->miss_filter_threshold, config_info->num_sub_windows,
-            miss_filter);
-    check(ret!=-1, "failed to initialize miss_filter.");
-
-    miss_table = (MissTable *) calloc(1, sizeof(MissTable));
-    check(miss_table!=NULL, "failed to allocate miss_table.");
-    ret = miss_table_init(config_info->miss_table_lookup_size,
-            config_info->miss_table_threshold, config_info->num_sub_windows,
-            miss_table);
-    check(ret!=-1, "failed to initialize miss_table.");
-
-    ssd_cache = (LRUCache *) calloc(1, sizeof(LRUCache));
-    check(ssd_cache!=NULL, "failed to allocate ssd_cache.");
-    ret = lru_cache_init(config_info->ssd_size, ssd_cache);
-    check(ret!=-1, "failed to initialize ssd_cache.");
-
-    /* start simulation */
-    gettimeofday(&start, NULL);
-
-    /* go over trace file */
-    trace_fp = fopen(config_info->trace_file, "r");
-    check(trace_fp!=NULL, "failed to open trace file:%s\n",
-            config_info->trace_file);
-
-    while (fgets(line, sizeof(line), trace_fp) != NULL) {
-        ret = sscanf(line, "%"SCNu64" %"SCNu8" %"SCNu8" %s %"SCNu64" %"SCNu32" "
-        "%"SCNu64"\n", &csv_data.timestamp, &csv_data.server_num,
-                &csv_data.volume_num, csv_data.req_type, &csv_data.start_addr,
-                &csv_data.req_size, &csv_data.duration);
-        check(ret==7, "failed to parse csv line:\n\t%s\n", line);
-        tot_lines += 1;
-
-        /* first line of trace file, extract starting timestamp */
-        if (tot_reqs == 0) {
-            starting_time_stamp = csv_data.timestamp;
-        }
-
-        req.block_num = (csv_data.start_addr >> LOG_2_BLOCK_SIZE);
-        num_blocks = (csv_data.req_size >> LOG_2_BLOCK_SIZE);
-        if (num_blocks == 0) {
-            num_blocks = 1;
-        }
-
-        if (strcmp(csv_data.req_type, "Write") == 0) {
-            req.req_type = 1;
-        } else {
-            req.req_type = 0;
-        }
-
-        req.server_num = csv_data.server_num;
-        req.volume_num = csv_data.volume_num;
-        req.sub_window_ind = (csv_data.timestamp - starting_time_stamp)
-                            / SUB_WINDOW_SIZE;
-
-        for (i = 0; i < num_blocks; i++) {
-            tot_reqs += 1;
-            if (tot_reqs % 292000000 == 0) {
-                printf("%d%% is done.\n", progress);
-                progress += 10;
-            }
-
-            if (req.req_type == 0) {
-                // read request
-                tot_reads += 1;
-                ret = lru_cache_read_lookup(write_buffer, &req);
-                if (ret == 1) {
-                    continue;
-                } else {
-                    ret = lru_cache_lookup(ssd_cache, &req);
-                }
-                if (ret == 0) {
-                    ret = miss_filter_lookup(miss_filter, &req);
-                    if (ret == 1) {
-                        /*hits in miss_filter, check miss_table*/
-                        ret = miss_table_access(miss_table, &req);
-                        /*hits in miss_table, insert it to ssd_cache*/
-                        if (ret == 1) {
-                            lru_cache_insert(ssd_cache, req.block_num,
-                                    req.server_num, req.volume_num,
-                                    &replaced_req);
-                        } // hits in miss_table
-                    } // hits in miss_filter
-                }
-            } else {
-                // write request
-                tot_writes += 1;
-                ret = lru_cache_lookup(write_buffer, &req);
-                if (ret == 0) {
-                    ret = lru_cache_peek(ssd_cache, &req);
-                    if (ret == 0) {
-                        // miss in ssd_cache
-                        ret = miss_filter_lookup(miss_filter, &req);
-                        if (ret == 1) {
-                            /*hits in miss_filter, check miss_table*/
-                            ret = miss_table_access(miss_table, &req);
-                            /*hits in miss_table, insert it to ssd_cache*/
-                            if (ret == 1) {
-
-                                ret = lru_cache_insert(write_buffer,
-                                        req.block_num, req.server_num,
-                                        req.volume_num, &replaced_req);
-                                if (ret == 1) {
-                                    ret = lru_cache_peek (ssd_cache, &replaced_req);
-                                    if (ret == 1) {
-                                        ret = lru_cache_update(ssd_cache,
-                                                &replaced_req);
-                                        check(ret==0,
-                                                "failed to update entry in ssd_cache.");
-                                    } else {
-                                        lru_cache_insert(ssd_cache,
-                                            replaced_req.block_num,
-                                            replaced_req.server_num,
-                                            replaced_req.volume_num, &req);
-                                    }
-                                } // write buffer has a replaced entry
-                            } // hits in miss_table
-                        } // hits in miss_filter
-                    } else {
-                        // hits in ssd_cache
-                        ret = lru_cache_remove (ssd_cache, &req);
-                        check (ret==0, "failed to remove entry from ssd_cache.");
-                        ret = lru_cache_insert(write_buffer, req.block_num,
-                                req.server_num, req.volume_num, &replaced_req);
-                        if (ret == 1) {
-                            ret = lru_cache_peek(ssd_cache, &replaced_req);
-                            if (ret == 1) {
-                                ret = lru_cache_update(ssd_cache,
-                                        &replaced_req);
-                                check(ret==0,
-                                        "failed to update entry in ssd_cache.");
-                            } else {
-                                lru_cache_insert(ssd_cache,
-                                        replaced_req.block_num,
-                                        replaced_req.server_num,
-                                        replaced_req.volume_num, &req);
-                            }
-                        } // write buffer has a replaced entry
-                    } // hits in ssd cache
-                } // miss in write buffer
-            } // write request
-            req.block_num += 1;
-        } // loop through each request
-    } // loop through each line from the trace file
-
-    gettimeofday(&end, NULL);
-
-    fprintf(out_fp, "total number of requests: %"PRIu64"\n", tot_reqs);
-    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", tot_reads);
-    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", tot_writes);
-    long duration = (end.tv_sec - start.tv_sec) * 1000000
-                + (end.tv_usec - start.tv_usec);
-    fprintf(out_fp, "time consumed = %.4f (min)\n",
-                (double) duration / (1000000.0 * 60.0));
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "write buffer: \n");
-
-    fprintf(out_fp, "wb size         :  %"PRIu64"\n", write_buffer->cache_size);
-    fprintf(out_fp, "read hits       :  %"PRIu64"\n", write_buffer->read_hits);
-    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", write_buffer->read_lookups);
-    fprintf(out_fp, "read hits ratio :  %.4f\n",
-          (double) write_buffer->read_hits/(double) write_buffer->read_lookups);
-    fprintf(out_fp, "write hits      :  %"PRIu64"\n", write_buffer->write_hits);
-    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", write_buffer->write_lookups);
-    fprintf(out_fp, "write hits ratio:  %.4f\n",
-          (double) write_buffer->write_hits/(double) write_buffer->write_lookups);
-    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", write_buffer->num_writes);
-    fprintf(out_fp, "num updates     :  %"PRIu64"\n", write_buffer->num_updates);
-    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", write_buffer->num_replaces);
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "ssd cache: \n");
-
-    fprintf(out_fp, "ssd cache size  :  %"PRIu64"\n", ssd_cache->cache_size);
-    fprintf(out_fp, "read hits       :  %"PRIu64"\n", ssd_cache->read_hits);
-    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", ssd_cache->read_lookups);
-    fprintf(out_fp, "read hits ratio :  %.4f\n",
-          (double) ssd_cache->read_hits/(double) ssd_cache->read_lookups);
-    fprintf(out_fp, "write hits      :  %"PRIu64"\n", ssd_cache->write_hits);
-    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", ssd_cache->write_lookups);
-    fprintf(out_fp, "write hits ratio:  %.4f\n",
-          (double) ssd_cache->write_hits/(double) ssd_cache->write_lookups);
-    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", ssd_cache->num_writes);
-    fprintf(out_fp, "num removes     :  %"PRIu64"\n", ssd_cache->num_removes);
-    fprintf(out_fp, "num updates     :  %"PRIu64"\n", ssd_cache->num_updates);
-    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", ssd_cache->num_replaces);
-
-    /* destroy resource */
-    fclose(trace_fp);
-    fclose(out_fp);
-    lru_cache_destroy (write_buffer);
-    miss_filter_destroy(miss_filter);
-    miss_table_destroy(miss_table);
-    lru_cache_destroy(ssd_cache);
-
-    return 0;
-
-error:
-    if (trace_fp != NULL) {
-        fclose(trace_fp);
-    }
-
-    if (out_fp != NULL) {
-        fclose(out_fp);
-    }
-
-    if (write_buffer != NULL) {
-        lru_cache_destroy (write_buffer);
-    }
-
-    if (miss_filter != NULL) {
-        miss_filter_destroy(miss_filter);
-    }
-
-    if (miss_table != NULL) {
-        miss_table_destroy(miss_table);
-    }
-
-    if (ssd_cache != NULL) {
-        lru_cache_destroy(ssd_cache);
-    }
-
-    return -1;
-}
-
-int run_sieve_store_base (ConfigInfo *config_info) {
-    int ret;
-    int64_t i;
-    FILE *trace_fp = NULL;
-    FILE *out_fp   = NULL;
-    char line[FILE_LINE_SIZE];
-    CSVLineData csv_data;
-
-    Request req, replaced_req;
-    int num_blocks;
-    int progress = 10;
-
-    MissFilter *miss_filter  = NULL;
-    MissTable  *miss_table   = NULL;
-    LRUCache   *ssd_cache    = NULL;
-
-    struct timeval start, end;
-    uint64_t  tot_reqs = 0;
-
-    /* initializations */
-
-    out_fp = fopen (config_info->result_file, "w");
-    check (out_fp!=NULL, "failed to open result file: %s.",
-            config_info->result_file);
-
-    miss_filter = (MissFilter *) calloc(1, sizeof(MissFilter));
-    check(miss_filter!=NULL, "failed to allocate miss_filter.");
-    ret = miss_filter_init(config_info->miss_filter_size,
-            config_info->miss_filter_threshold, config_info->num_sub_windows,
-            miss_filter);
-    check(ret!=-1, "failed to initialize miss_filter.");
-
-    miss_table = (MissTable *) calloc(1, sizeof(MissTable));
-    check(miss_table!=NULL, "failed to allocate miss_table.");
-    ret = miss_table_init(config_info->miss_table_lookup_size,
-            config_info->miss_table_threshold, config_info->num_sub_windows,
-            miss_table);
-    check(ret!=-1, "failed to initialize miss_table.");
-
-    ssd_cache = (LRUCache *) calloc(1, sizeof(LRUCache));
-    check(ssd_cache!=NULL, "failed to allocate ssd_cache.");
-    ret = lru_cache_init(config_info->ssd_size, ssd_cache);
-    check(ret!=-1, "failed to initialize ssd_cache.");
-
-    /* start simulation */
-    gettimeofday(&start, NULL);
-
-    /* go over trace file */
-    trace_fp = fopen(config_info->trace_file, "r");
-    check(trace_fp!=NULL, "failed to open trace file:%s\n",
-            config_info->trace_file);
-
-/*    out_fp = fopen ("allocations.txt", "w");
-    check (out_fp!=NULL, "failed to open output file.\n");*/
-
-    while (fgets(line, sizeof(line), trace_fp) != NULL) {
-        ret = sscanf(line, "%"SCNu64" %"SCNu8" %"SCNu8" %s %"SCNu64" %"SCNu32" "
-        "%"SCNu64"\n", &csv_data.timestamp, &csv_data.server_num,
-                &csv_data.volume_num, csv_data.req_type, &csv_data.start_addr,
-                &csv_data.req_size, &csv_data.duration);
-        check(ret==7, "failed to parse csv line:\n\t%s\n", line);
-
-        /* first line of trace file, extract starting timestamp */
-        if (tot_reqs == 0) {
-            starting_time_stamp = csv_data.timestamp;
-        }
-
-        req.server_num = csv_data.server_num;
-        req.volume_num = csv_data.volume_num;
-        req.sub_window_ind = (csv_data.timestamp - starting_time_stamp)
-                / SUB_WINDOW_SIZE;
-
-        req.block_num = (csv_data.start_addr >> LOG_2_BLOCK_SIZE);
-        num_blocks = (csv_data.req_size >> LOG_2_BLOCK_SIZE);
-        if (num_blocks == 0) {
-            num_blocks = 1;
-        }
-
-        if (strcmp(csv_data.req_type, "Write") == 0) {
-            req.req_type = 1;
-        } else {
-            req.req_type = 0;
-        }
-
-        for (i = 0; i < num_blocks; i++) {
-            tot_reqs += 1;
-
-            if (tot_reqs % 292000000 == 0) {
-                printf("%d%% is done.\n", progress);
-                progress += 10;
-            }
-
-            ret = lru_cache_lookup(ssd_cache, &req);
-            if (ret == 0) {
-                /*miss in ssd_cache, check miss_filter*/
-                ret = miss_filter_lookup(miss_filter, &req);
-                if (ret == 1) {
-                    /*hits in miss_filter, check miss_table*/
-                    ret = miss_table_access(miss_table, &req);
-                    /*hits in miss_table, insert it to ssd_cache*/
-                    if (ret == 1) {
-                        lru_cache_insert(ssd_cache, req.block_num,
-                                req.server_num, req.volume_num, &replaced_req);
-                    } // hits in miss_table
-                } // hits in miss_filter
-            } // miss in ssd_cache
-
-            req.block_num += 1;
-        } // loop through each request
-    } // loop through each line from the trace file
-
-    gettimeofday(&end, NULL);
-
-    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", ssd_cache->read_lookups);
-    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", ssd_cache->write_lookups);
-    fprintf(out_fp, "total number of requests: %"PRIu64"\n", tot_reqs);
-    long duration = (end.tv_sec - start.tv_sec) * 1000000
-               + (end.tv_usec - start.tv_usec);
-    fprintf(out_fp, "time consumed = %.4f (min)\n",
-               (double) duration / (1000000.0 * 60.0));
-
-    fprintf(out_fp, "\n\n");
-    fprintf(out_fp, "read hits       :  %"PRIu64"\n", ssd_cache->read_hits);
-    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", ssd_cache->read_lookups);
-    fprintf(out_fp, "read hits ratio :  %.4f\n",
-            (double) ssd_cache->read_hits / (double) ssd_cache->read_lookups);
-    fprintf(out_fp, "write hits      :  %"PRIu64"\n", ssd_cache->write_hits);
-    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", ssd_cache->write_lookups);
-    fprintf(out_fp, "write hits ratio:  %.4f\n",
-            (double) ssd_cache->write_hits / (double) ssd_cache->write_lookups);
-    fprintf(out_fp, "tot_hits_ratio  :  %.4f\n",
-            (double) (ssd_cache->write_hits + ssd_cache->read_hits)
-                    / (double) (ssd_cache->write_lookups
-                            + ssd_cache->read_lookups));
-
-    fprintf(out_fp, "ssd cache writes :  %"PRIu64"\n", ssd_cache->num_writes);
-    fprintf(out_fp, "ssd cache replacements: %"PRIu64"\n", ssd_cache->num_replaces);
-
-    /* destroy resource */
-    fclose(trace_fp);
-    fclose(out_fp);
-    miss_filter_destroy(miss_filter);
-    miss_table_destroy(miss_table);
-    lru_cache_destroy(ssd_cache);
-
-    return 0;
-
-    error: if (trace_fp != NULL) {
-        fclose(trace_fp);
-    }
-
-    if (out_fp != NULL) {
-        fclose(out_fp);
-    }
-
-    if (miss_filter != NULL) {
-        miss_filter_destroy(miss_filter);
-    }
-
-    if (miss_table != NULL) {
-        miss_table_destroy(miss_table);
-    }
-
-    if (ssd_cache != NULL) {
-        lru_cache_destroy(ssd_cache);
-    }
-
-    return -1;
+static void usage(const char *argv0) {
+    printf("Usage: \n");
+    printf("\t base line sieve store   : %s 0 num_sub_windows "
+            "miss_filter_threshold miss_table_threshold\n", argv0);
+    printf("\t traditional write buffer: %s 1 tr_wb_size num_sub_windows "
+            "miss_filter_threshold miss_table_threshold\n", argv0);
+    printf("\t sieved write buffer     : %s 2 s_wb_threshold s_wb_size\n", argv0);
+    printf("\t sieved + traditional write buffer: %s 3 "
+            "s_wb_threshold num_sub_windows miss_filter_threshold "
+            "miss_table_threshold\n",
+            argv0);
+    printf("\t lru miss ratio curve    : %s 4 max_ssd_size_gib "
+            "curve_points\n", argv0);
+    printf("\t parameter sweep         : %s -S sweep_file\n", argv0);
+    printf("Options: \n");
+    printf("\t -f trace_file: text or binary (see trace_convert) trace, "
+            "default ./ensemble_trace.csv\n");
+    printf("\t -p num_parsers: trace parser threads running ahead of the "
+            "simulation, 0 parses inline, default %d\n",
+            TRACE_STREAM_DEFAULT_PARSERS);
+    printf("\t -S sweep_file: simulate every configuration listed in "
+            "sweep_file,\n\t    one per line as the arguments above "
+            "(e.g. \"0 4 9 4\"), in one pass over the trace\n");
+    printf("\t -j num_workers: load the trace once and simulate the "
+            "configurations\n\t    on num_workers threads instead, one "
+            "configuration per thread at a time\n");
+    printf("\t -P: pin each -j worker thread to its own cpu\n");
+    printf("\t -I: advance the configurations of a sweep one request each "
+            "in turn,\n\t    prefetching the next one's tables, instead of "
+            "a batch at a time\n");
+    printf("\t -B iterations: time the configurations replaying the trace "
+            "one after\n\t    another, a batch at a time and interleaved "
+            "on one core, and\n\t    print requests/sec; no results are "
+            "written\n");
+    printf("\t -N num_shards: split each configuration by block hash over "
+            "num_shards\n\t    threads (up to %d), each with that share of "
+            "every cache and table\n", SHARD_MAX_SHARDS);
+    printf("\t -V: with -N, also simulate unsharded and report the "
+            "deviation\n");
+    printf("\t -L: simulate each sieved + traditional write buffer "
+            "configuration with\n\t    the tiers, miss filter, miss table "
+            "and ghost cache on threads of their own\n");
+    printf("\t -T: run a base line sieve store configuration with a "
+            "STATIC_SSD_SIZE block\n\t    ssd cache, build static ssd and "
+            "write buffers from it and\n\t    replay the trace against "
+            "them\n");
+    printf("\t -H num_hashes: count-min miss filter with num_hashes rows "
+            "(1-%d) hashed\n\t    on server, volume and block, default 0 "
+            "indexes the filter by block number\n", MISS_FILTER_MAX_HASHES);
+    printf("\t -g ghost_size: blocks tracked by the sieved write buffer "
+            "ghost cache,\n\t    default %d\n", GHOST_CACHE_DEFAULT_SIZE);
+    printf("\t -G: compact ghost cache of block key fingerprints with "
+            "CLOCK eviction,\n\t    about a tenth of the memory per "
+            "block\n");
+    printf("\t -m table_mode: backing of the large tables, 0 calloc, "
+            "1 lazily zeroed mmap\n\t    with transparent huge pages, "
+            "2 explicit huge pages, default %d\n", TABLE_MEM_DEFAULT_MODE);
+    printf("\t -Z: fault in every table page at startup\n");
+    printf("\t -r sample_rate: only simulate the blocks whose hashed key "
+            "falls under\n\t    sample_rate (0 < rate <= 1) with all sizes "
+            "scaled to match, default 1\n");
 }
 
-int sort_ssd_cache (LRUCache *ssd_cache, LRUCacheEntry ** entry_ptr)
+int sort_ssd_cache (LRUCache *ssd_cache, uint32_t *entry_ind)
 {
     uint64_t num_entries = ssd_cache->entry_count;
+    uint64_t *write_access_count = ssd_cache->write_access_count;
     int64_t i, j;
-    LRUCacheEntry *entry = NULL;
+    uint32_t entry;
     int pass = 1;
 
     for (i = 0; i < num_entries; i++) {
-        entry_ptr[i] = &(ssd_cache->cache_entry[i]);
+        entry_ind[i] = i;
     }
 
     for (i = 1; i < num_entries; i++) {
-        entry = entry_ptr[i];
+        entry = entry_ind[i];
         j = i - 1;
         while (j >= 0) {
-            if (entry->write_access_count > entry_ptr[j]->write_access_count) {
-                entry_ptr[j+1] = entry_ptr[j];
+            if (write_access_count[entry] > write_access_count[entry_ind[j]]) {
+                entry_ind[j+1] = entry_ind[j];
                 j -= 1;
             } else {
                 break;
             }
         }
-        entry_ptr[j+1] = entry;
+        entry_ind[j+1] = entry;
     }
 
     for (i = 0; i < num_entries-1; i++) {
-        if (entry_ptr[i]->write_access_count < entry_ptr[i+1]->write_access_count) {
+        if (write_access_count[entry_ind[i]]
+                < write_access_count[entry_ind[i+1]]) {
             pass = 0;
             break;
         }
@@ -809,32 +139,33 @@ error:
    return -1;
 }
 
-void max_heapify (LRUCacheEntry **entry_ptr, int64_t root, int64_t len)
+void max_heapify (uint64_t *write_access_count, uint32_t *entry_ind,
+        int64_t root, int64_t len)
 {
     int64_t l = LCHILD (root);
     int64_t r = RCHILD (root);
     int64_t largest;
-    LRUCacheEntry *entry;
+    uint32_t entry;
 
     while ((l<len) || (r<len)) {
         if ((l < len)
-                && (entry_ptr[l]->write_access_count
-                        > entry_ptr[root]->write_access_count)) {
+                && (write_access_count[entry_ind[l]]
+                        > write_access_count[entry_ind[root]])) {
             largest = l;
         } else {
             largest = root;
         }
 
         if ((r < len)
-                && (entry_ptr[r]->write_access_count
-                        > entry_ptr[root]->write_access_count)) {
+                && (write_access_count[entry_ind[r]]
+                        > write_access_count[entry_ind[root]])) {
             largest = r;
         }
 
         if (largest != root) {
-            entry = entry_ptr[largest];
-            entry_ptr[largest] = entry_ptr[root];
-            entry_ptr[root] = entry;
+            entry = entry_ind[largest];
+            entry_ind[largest] = entry_ind[root];
+            entry_ind[root] = entry;
         } else {
             break;
         }
@@ -848,30 +179,28 @@ void max_heapify (LRUCacheEntry **entry_ptr, int64_t root, int64_t len)
 int run_static_buffer (ConfigInfo *config_info) {
     int ret;
     int64_t i;
-    FILE *trace_fp = NULL;
-    char line[FILE_LINE_SIZE];
-    CSVLineData csv_data;
+    TraceStream *trace_stream = NULL;
+    TraceData *trace_data = NULL;
+    RequestBatch *batch;
 
     Request req, replaced_req;
-    ReplayReq replay_req;
-    int num_blocks;
 
     MissFilter   *miss_filter  = NULL;
     MissTable    *miss_table   = NULL;
     LRUCache     *ssd_cache    = NULL;
     StaticBuffer *static_ssd   = NULL;
     StaticBuffer *static_wb    = NULL;
-/*    ReplayReq    *req_array    = NULL;*/
 
     struct timeval start, end;
     uint64_t  tot_reqs = 0;
+    long      num_cpus;
     /* initializations */
 
     miss_filter = (MissFilter *) calloc(1, sizeof(MissFilter));
     check(miss_filter!=NULL, "failed to allocate miss_filter.");
     ret = miss_filter_init(config_info->miss_filter_size,
             config_info->miss_filter_threshold, config_info->num_sub_windows,
-            miss_filter);
+            config_info->miss_filter_hashes, miss_filter);
     check(ret!=-1, "failed to initialize miss_filter.");
 
     miss_table = (MissTable *) calloc(1, sizeof(MissTable));
@@ -885,6 +214,8 @@ int run_static_buffer (ConfigInfo *config_info) {
     check(ssd_cache!=NULL, "failed to allocate ssd_cache.");
     ret = lru_cache_init(config_info->ssd_size, ssd_cache);
     check(ret!=-1, "failed to initialize ssd_cache.");
+    ret = lru_cache_track_writes(ssd_cache);
+    check(ret!=-1, "failed to track ssd_cache writes.");
 
     static_ssd = (StaticBuffer *) calloc (1, sizeof(StaticBuffer));
     check (static_ssd!=NULL, "failed to allocate static_ssd.");
@@ -896,65 +227,23 @@ int run_static_buffer (ConfigInfo *config_info) {
     ret = static_buffer_init (static_wb, STATIC_WB_SIZE);
     check (ret==0, "failed to initialize static_wb.");
 
-/*    req_array = (ReplayReq *) calloc (NUM_REQS, sizeof(ReplayReq));
-    check (req_array!=NULL, "failed to allocate req_array");*/
-
     /* start simulation */
     gettimeofday(&start, NULL);
 
     /* go over trace file */
-    trace_fp = fopen(config_info->trace_file, "r");
-    check(trace_fp!=NULL, "failed to open trace file:%s\n",
+    trace_stream = (TraceStream *) calloc(1, sizeof(TraceStream));
+    check(trace_stream!=NULL, "failed to allocate trace_stream.");
+    ret = trace_stream_open(config_info->trace_file,
+            config_info->num_parser_threads, trace_stream);
+    check(ret==0, "failed to open trace file:%s\n",
             config_info->trace_file);
+    starting_time_stamp = trace_stream->starting_time_stamp;
 
-    while (fgets(line, sizeof(line), trace_fp) != NULL) {
-        ret = sscanf(line, "%"SCNu64" %"SCNu8" %"SCNu8" %s %"SCNu64" %"SCNu32" "
-        "%"SCNu64"\n", &csv_data.timestamp, &csv_data.server_num,
-                &csv_data.volume_num, csv_data.req_type, &csv_data.start_addr,
-                &csv_data.req_size, &csv_data.duration);
-        check(ret==7, "failed to parse csv line:\n\t%s\n", line);
-
-        /* first line of trace file, extract starting timestamp */
-        if (tot_reqs == 0) {
-            starting_time_stamp = csv_data.timestamp;
-        }
-
-/*        if (csv_data.start_addr == 412225536) {
-            printf("debug\n");
-        }*/
-
-        req.block_num = (csv_data.start_addr >> LOG_2_BLOCK_SIZE);
-        num_blocks = (csv_data.req_size >> LOG_2_BLOCK_SIZE);
-        if (num_blocks == 0) {
-            num_blocks = 1;
-        }
-
-        if (strcmp(csv_data.req_type, "Write") == 0) {
-            req.req_type = 1;
-        } else {
-            req.req_type = 0;
-        }
-
-        req.server_num = csv_data.server_num;
-        req.volume_num = csv_data.volume_num;
-        req.sub_window_ind = (csv_data.timestamp - starting_time_stamp)
-                / SUB_WINDOW_SIZE;
-
-        for (i = 0; i < num_blocks; i++) {
-
-/*            req_array[tot_reqs].block_num = req.block_num;
-            req_array[tot_reqs].server_num = req.server_num;
-            req_array[tot_reqs].volume_num = req.volume_num;
-            req_array[tot_reqs].req_type = req.req_type;*/
-
-            /*printf ("%"PRIu8" %"PRIu8" %"PRIu64" %"PRIu32"\n", req.server_num,
-             req.volume_num, req.block_num, req.sub_window_ind);*/
+    while ((ret = trace_stream_next(trace_stream, &batch)) == 1) {
+        for (i = 0; i < batch->num_reqs; i++) {
+            req = batch->reqs[i];
 
             tot_reqs += 1;
-/*            if (req.block_num == 100746) {
-                debug_counter += 1;
-                printf("%s\n", line);
-            }*/
 
             ret = lru_cache_lookup(ssd_cache, &req);
             if (ret == 0) {
@@ -966,17 +255,17 @@ int run_static_buffer (ConfigInfo *config_info) {
                     /*hits in miss_table, insert it to ssd_cache*/
                     if (ret == 1) {
                         lru_cache_insert(ssd_cache, req.block_num,
-                                req.server_num, req.volume_num, &replaced_req);
+                                req.volume_id, &replaced_req);
                     } // hits in miss_table
                 } // hits in miss_filter
             } // miss in ssd_cache
-
-            req.block_num += 1;
         } // loop through each request
-    } // loop through each line from the trace file
+    } // loop through each batch from the trace file
+    check(ret==0, "failed to read trace file:%s\n",
+            config_info->trace_file);
 
-    fclose(trace_fp);
-    trace_fp = NULL;
+    trace_stream_destroy(trace_stream);
+    trace_stream = NULL;
 
     gettimeofday(&end, NULL);
     long duration = (end.tv_sec - start.tv_sec) * 1000000
@@ -990,46 +279,56 @@ int run_static_buffer (ConfigInfo *config_info) {
     check (ssd_cache->entry_count==STATIC_SSD_SIZE,
             "ssd_cache->entry_count = %"PRIu64"", ssd_cache->entry_count);
     uint64_t tot_entries = ssd_cache->entry_count;
-    uint64_t block_num, server_num, volume_num;
+    uint64_t block_num;
+    uint32_t volume_id;
     for (i = 0; i < tot_entries; i++) {
-        block_num  = ssd_cache->cache_entry[i].block_num;
-        server_num = ssd_cache->cache_entry[i].server_num;
-        volume_num = ssd_cache->cache_entry[i].volume_num;
-        ret = static_buffer_insert (static_ssd, block_num, server_num, volume_num);
+        block_num = block_key_block_num (ssd_cache->cache_entry[i].key);
+        volume_id = block_key_volume_id (ssd_cache->cache_entry[i].key);
+        ret = static_buffer_insert (static_ssd, block_num, volume_id);
         check (ret==0, "failed to insert to static_ssd.");
     }
 
     /* build static write buffer */
-    LRUCacheEntry **entry_ptr = (LRUCacheEntry **) calloc (STATIC_SSD_SIZE,
-            sizeof(LRUCacheEntry *));
-    check (entry_ptr!=NULL, "failed to allocate entry_ptr.");
+    uint32_t *entry_ind = (uint32_t *) calloc (STATIC_SSD_SIZE,
+            sizeof(uint32_t));
+    check (entry_ind!=NULL, "failed to allocate entry_ind.");
     for (i = 0; i < STATIC_SSD_SIZE; i++) {
-        entry_ptr[i] = &(ssd_cache->cache_entry[i]);
+        entry_ind[i] = i;
     }
-/*    ret = sort_ssd_cache (ssd_cache, entry_ptr);
-    check (ret==0, "failed to sort ssd cache.");*/
     /* building max heap based on write_access_count */
     uint64_t half_array_len = (STATIC_SSD_SIZE >> 1);
     for (i = half_array_len; i >= 0; i--) {
-        max_heapify (entry_ptr, i, STATIC_SSD_SIZE);
+        max_heapify (ssd_cache->write_access_count, entry_ind, i,
+                STATIC_SSD_SIZE);
     }
 
     tot_entries = STATIC_WB_SIZE;
     int64_t len = STATIC_WB_SIZE;
 
     for (i = 0; i < tot_entries; i++) {
-        block_num = entry_ptr[0]->block_num;
-        server_num = entry_ptr[0]->server_num;
-        volume_num = entry_ptr[0]->volume_num;
-        ret = static_buffer_insert (static_wb, block_num, server_num, volume_num);
+        block_num = block_key_block_num (ssd_cache->cache_entry[entry_ind[0]].key);
+        volume_id = block_key_volume_id (ssd_cache->cache_entry[entry_ind[0]].key);
+        ret = static_buffer_insert (static_wb, block_num, volume_id);
         check (ret==0, "failed to insert to static_wb.");
 
-        entry_ptr[0] = entry_ptr[len-1];
+        entry_ind[0] = entry_ind[len-1];
         len -= 1;
-        max_heapify (entry_ptr, 0, len);
+        max_heapify (ssd_cache->write_access_count, entry_ind, 0, len);
     }
-    free (entry_ptr);
+    free (entry_ind);
     printf ("finish building static wb.\n");
+
+    /* both buffers are read only from here on */
+    ret = static_buffer_freeze (static_ssd);
+    check (ret==0, "failed to freeze static_ssd.");
+    ret = static_buffer_freeze (static_wb);
+    check (ret==0, "failed to freeze static_wb.");
+    printf ("static_ssd: %"PRIu64" blocks, %.1f bytes per block\n",
+            static_ssd->num_keys, (double) static_buffer_bytes (static_ssd)
+                    / (double) static_ssd->num_keys);
+    printf ("static_wb: %"PRIu64" blocks, %.1f bytes per block\n",
+            static_wb->num_keys, (double) static_buffer_bytes (static_wb)
+                    / (double) static_wb->num_keys);
     gettimeofday(&end, NULL);
     duration = (end.tv_sec - start.tv_sec) * 1000000
             + (end.tv_usec - start.tv_usec);
@@ -1039,52 +338,21 @@ int run_static_buffer (ConfigInfo *config_info) {
     gettimeofday(&start, NULL);
 
     /* replay request trace */
-/*    uint64_t step_size = tot_reqs / 10;
-    for (i = 0; i < tot_reqs; i++) {
-        ret = static_buffer_lookup (static_wb, &(req_array[i]));
-        if (ret == 0) {
-            ret = static_buffer_lookup (static_ssd, &(req_array[i]));
-        }
-        if (((i+1) % step_size) == 0) {
-            printf ("%"PRIu64" out of %"PRIu64" are done.\n", i, tot_reqs);
-        }
-    }*/
-    trace_fp = fopen(config_info->trace_file, "r");
-    check(trace_fp!=NULL, "failed to open trace file:%s\n",
+    /* the replay only reads the frozen buffers, split it over the cpus */
+    trace_data = (TraceData *) calloc(1, sizeof(TraceData));
+    check(trace_data!=NULL, "failed to allocate trace_data.");
+    ret = trace_data_load(config_info->trace_file, trace_data);
+    check(ret==0, "failed to load trace file:%s\n", config_info->trace_file);
+    num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus < 1) {
+        num_cpus = 1;
+    }
+    ret = static_buffer_replay(static_wb, static_ssd, trace_data,
+            (uint32_t) num_cpus);
+    check(ret==0, "failed to replay trace file:%s\n",
             config_info->trace_file);
-
-    while (fgets(line, sizeof(line), trace_fp) != NULL) {
-        ret = sscanf(line, "%"SCNu64" %"SCNu8" %"SCNu8" %s %"SCNu64" %"SCNu32" "
-        "%"SCNu64"\n", &csv_data.timestamp, &csv_data.server_num,
-                &csv_data.volume_num, csv_data.req_type, &csv_data.start_addr,
-                &csv_data.req_size, &csv_data.duration);
-        check(ret==7, "failed to parse csv line:\n\t%s\n", line);
-
-        replay_req.block_num = (csv_data.start_addr >> 12);
-        num_blocks = (csv_data.req_size >> 12);
-        if (num_blocks == 0) {
-            num_blocks = 1;
-        }
-
-        if (strcmp(csv_data.req_type, "Write") == 0) {
-            replay_req.req_type = 1;
-        } else {
-            replay_req.req_type = 0;
-        }
-
-        replay_req.server_num = csv_data.server_num;
-        replay_req.volume_num = csv_data.volume_num;
-
-        for (i = 0; i < num_blocks; i++) {
-/*            ret = static_buffer_lookup(static_wb, &replay_req);
-            if (ret == 0) {
-                ret = static_buffer_lookup(static_ssd, &replay_req);
-            }*/
-            static_buffer_lookup(static_ssd, &replay_req);
-            replay_req.block_num += 1;
-        }
-    }
-    fclose (trace_fp);
+    trace_data_destroy(trace_data);
+    trace_data = NULL;
 
     gettimeofday(&end, NULL);
 
@@ -1129,13 +397,16 @@ int run_static_buffer (ConfigInfo *config_info) {
     lru_cache_destroy(ssd_cache);
     static_buffer_destroy(static_ssd);
     static_buffer_destroy(static_wb);
-    /*free (req_array);*/
     return 0;
 
 error:
 
-    if (trace_fp != NULL) {
-        fclose(trace_fp);
+    if (trace_stream != NULL) {
+        trace_stream_destroy(trace_stream);
+    }
+
+    if (trace_data != NULL) {
+        trace_data_destroy(trace_data);
     }
 
     if (miss_filter != NULL) {
@@ -1158,447 +429,215 @@ error:
         static_buffer_destroy(static_wb);
     }
 
-/*    if (req_array != NULL) {
-        free (req_array);
-    }*/
-
     return -1;
 }
 
-int run_sieved_plus_traditional_wb (ConfigInfo *config_info) {
-    int ret;
-    uint64_t i;
-    FILE *trace_fp = NULL;
-    FILE *out_fp = NULL;
-    FILE *debug_fp = NULL;
-    char line[FILE_LINE_SIZE];
-    CSVLineData csv_data;
-
-    Request req, replaced_req;
-    int num_blocks;
-    int progress = 10;
-
-    LRUCache   *s_wb = NULL;
-    LRUCache   *tr_wb = NULL;
-    MissFilter *miss_filter = NULL;
-    MissTable  *miss_table = NULL;
-    GhostCache *wb_ghost_cache = NULL;
-    LRUCache   *ssd_cache = NULL;
-
-    struct timeval start, end;
-    uint64_t tot_reads = 0, tot_writes = 0, tot_reqs = 0, tot_lines = 1;
-
-    /* initializations */
-
-    out_fp = fopen (config_info->result_file, "w");
-    check (out_fp!=NULL, "failed to open result file: %s.",
-                config_info->result_file);
-
-    debug_fp = fopen (config_info->debug_file, "w");
-    check (debug_fp!=NULL, "failed to open debug file: %s.",
-            config_info->debug_file);
-
-    s_wb = (LRUCache *) calloc (1, sizeof(LRUCache));
-    check (s_wb!=NULL, "failed to allocate s_wb.");
-    ret = lru_cache_init (config_info->sieved_wb_size, s_wb);
-    check (ret != -1, "failed to initialize s_wb.");
-
-    miss_filter = (MissFilter *) calloc(1, sizeof(MissFilter));
-    check(miss_filter!=NULL, "failed to allocate miss_filter.");
-    ret = miss_filter_init(config_info->miss_filter_size,
-            config_info->miss_filter_threshold, config_info->num_sub_windows,
-            miss_filter);
-    check(ret!=-1, "failed to initialize miss_filter.");
-
-    miss_table = (MissTable *) calloc(1, sizeof(MissTable));
-    check(miss_table!=NULL, "failed to allocate miss_table.");
-    ret = miss_table_init(config_info->miss_table_lookup_size,
-            config_info->miss_table_threshold, config_info->num_sub_windows,
-            miss_table);
-    check(ret!=-1, "failed to initialize miss_table.");
-
-    wb_ghost_cache = (GhostCache *) calloc(1, sizeof(GhostCache));
-    check(wb_ghost_cache!=NULL, "failed to allocate wb_ghost_cache.");
-    ret = ghost_cache_init(config_info->sieved_ghost_cache_size,
-            config_info->sieved_wb_threshold, config_info->num_sub_windows,
-            wb_ghost_cache);
-    check(ret!=-1, "failed to initialize wb_ghost_cache.");
-
-    tr_wb = (LRUCache *) calloc(1, sizeof(LRUCache));
-    check(tr_wb!=NULL, "failed to allocate tr_wb.");
-    ret = lru_cache_init(config_info->traditional_wb_size, tr_wb);
-    check(ret!=-1, "failed to initialize tr_wb.");
-
-    ssd_cache = (LRUCache *) calloc(1, sizeof(LRUCache));
-    check(ssd_cache!=NULL, "failed to allocate ssd_cache.");
-    ret = lru_cache_init(config_info->ssd_size, ssd_cache);
-    check(ret!=-1, "failed to initialize ssd_cache.");
-
-    /* start simulation */
-    gettimeofday(&start, NULL);
-
-    /* go over trace file */
-    trace_fp = fopen(config_info->trace_file, "r");
-    check(trace_fp!=NULL, "failed to open trace file:%s\n",
-            config_info->trace_file);
-
-    while (fgets(line, sizeof(line), trace_fp) != NULL) {
-        ret = sscanf(line, "%"SCNu64" %"SCNu8" %"SCNu8" %s %"SCNu64" %"SCNu32" "
-        "%"SCNu64"\n", &csv_data.timestamp, &csv_data.server_num,
-                &csv_data.volume_num, csv_data.req_type, &csv_data.start_addr,
-                &csv_data.req_size, &csv_data.duration);
-        check(ret==7, "failed to parse csv line:\n\t%s\n", line);
-        tot_lines += 1;
-
-        /* first line of trace file, extract starting timestamp */
-        if (tot_reqs == 0) {
-            starting_time_stamp = csv_data.timestamp;
+/*
+ * Fill in the test type, its parameters and the result file names
+ * of config_info from the positional arguments
+ *
+ *   test_type arg ...
+ *
+ * as given on the command line or on one line of a sweep file.
+ * argv[0] is only used in the usage messages.
+ */
+static int parse_test_args(int argc, char *argv[], ConfigInfo *config_info) {
+    if (atoi(argv[1]) == 0) {
+        if (argc != 5) {
+            printf("base line sieve store: ./%s 0 num_sub_window miss_filter_threshold miss_table_threshold\n", argv[0]);
+            return -1;
         }
-
-        req.block_num = (csv_data.start_addr >> LOG_2_BLOCK_SIZE);
-        num_blocks = (csv_data.req_size >> LOG_2_BLOCK_SIZE);
-        if (num_blocks == 0) {
-            num_blocks = 1;
+        config_info->test_type = SIM_SIEVE_STORE_BASE;
+        config_info->num_sub_windows = atoi(argv[2]);
+        config_info->miss_filter_threshold = atoi(argv[3]);
+        config_info->miss_table_threshold = atoi(argv[4]);
+        sprintf(config_info->result_file, "./results/ss_%"PRIu8"_%"PRIu32"_%"PRIu32".out",
+                config_info->num_sub_windows, config_info->miss_filter_threshold,
+                config_info->miss_table_threshold);
+    } else if (atoi(argv[1]) == 1) {
+        if (argc != 6) {
+            printf("traditional write buffer: ./%s 1 tr_wb_size num_sub_window miss_filter_threshold miss_table_threshold\n", argv[0]);
+            return -1;
         }
-
-        if (strcmp(csv_data.req_type, "Write") == 0) {
-            req.req_type = 1;
-        } else {
-            req.req_type = 0;
+        config_info->test_type = SIM_TRADITIONAL_WB;
+        config_info->traditional_wb_size = atoi(argv[2]);
+        config_info->num_sub_windows = atoi(argv[3]);
+        config_info->miss_filter_threshold = atoi(argv[4]);
+        config_info->miss_table_threshold = atoi(argv[5]);
+        sprintf(config_info->result_file,
+                "./results/tr_wb_%"PRIu64"_%"PRIu8"_%"PRIu32"_%"PRIu32".out",
+                config_info->traditional_wb_size,
+                config_info->num_sub_windows,
+                config_info->miss_filter_threshold,
+                config_info->miss_table_threshold);
+    } else if (atoi(argv[1]) == 2) {
+        if (argc != 4) {
+            printf("sieved write buffer: ./%s 2 s_wb_threshold s_wb_size\n", argv[0]);
+            return -1;
         }
+        config_info->test_type = SIM_SIEVED_WB;
+        if (config_info->sieved_ghost_cache_size == 0) {
+            config_info->sieved_ghost_cache_size = GHOST_CACHE_DEFAULT_SIZE;
+        }
+        config_info->sieved_wb_threshold = atoi(argv[2]);
+        config_info->sieved_wb_size = atoi(argv[3]);
+        sprintf(config_info->result_file, "./results/s_wb_%"PRIu32"_%"PRIu64".out",
+                config_info->sieved_wb_threshold, config_info->sieved_wb_size);
+    } else if (atoi(argv[1]) == 3) {
+        if (argc != 6) {
+            printf("\t sieved + traditional write buffer: %s 3 "
+                    "s_wb_threshold num_time_windows miss_filter_threshold "
+                    "miss_table_threshold\n", argv[0]);
+            return -1;
+        }
+        config_info->test_type = SIM_SIEVED_PLUS_TRADITIONAL_WB;
+        if (config_info->sieved_ghost_cache_size == 0) {
+            config_info->sieved_ghost_cache_size = GHOST_CACHE_DEFAULT_SIZE;
+        }
+        config_info->sieved_wb_size = 51200;
+        config_info->traditional_wb_size = 51200;
+        config_info->sieved_wb_threshold = atoi(argv[2]);
+        config_info->num_sub_windows = atoi(argv[3]);
+        config_info->miss_filter_threshold = atoi(argv[4]);
+        config_info->miss_table_threshold = atoi(argv[5]);
+        sprintf(config_info->result_file,
+                "./results/s_tr_wb_%"PRIu32"_%"PRIu8"_%"PRIu32"_%"PRIu32".out",
+                config_info->sieved_wb_threshold, config_info->num_sub_windows,
+                config_info->miss_filter_threshold,
+                config_info->miss_table_threshold);
+        sprintf(config_info->debug_file,
+                "./debug/s_tr_wb_%"PRIu32"_%"PRIu8"_%"PRIu32"_%"PRIu32".out",
+                config_info->sieved_wb_threshold, config_info->num_sub_windows,
+                config_info->miss_filter_threshold,
+                config_info->miss_table_threshold);
+    } else if (atoi(argv[1]) == 4) {
+        if (argc != 4) {
+            printf("lru miss ratio curve: ./%s 4 max_ssd_size_gib curve_points\n", argv[0]);
+            return -1;
+        }
+        config_info->test_type = SIM_MRC;
+        config_info->ssd_size = ((uint64_t) atoi(argv[2]) << 30) >> 12;
+        config_info->mrc_points = atoi(argv[3]);
+        sprintf(config_info->result_file, "./results/mrc_%d_%"PRIu32".out",
+                atoi(argv[2]), config_info->mrc_points);
+    } else {
+        printf("unknown test type: %s\n", argv[1]);
+        return -1;
+    }
 
-        req.server_num = csv_data.server_num;
-        req.volume_num = csv_data.volume_num;
-        req.sub_window_ind = (csv_data.timestamp - starting_time_stamp)
-                            / SUB_WINDOW_SIZE;
-
-        for (i = 0; i < num_blocks; i++) {
-
-            tot_reqs += 1;
-
-            if (tot_reqs % 292000000 == 0) {
-                printf("%d%% is done.\n", progress);
-                progress += 10;
-            }
+    return 0;
+}
 
-            if (req.req_type == 0) {
-                // read request
-                tot_reads += 1;
-                ret = lru_cache_read_lookup(s_wb, &req);
-                if (ret == 0) {
-                    ret = lru_cache_read_lookup(tr_wb, &req);
-                }
-                if (ret == 0) {
-                    ret = lru_cache_lookup(ssd_cache, &req);
-                }
-                if (ret == 0) {
-                    ret = miss_filter_lookup(miss_filter, &req);
-                    if (ret == 1) {
-                        /*hits in miss_filter, check miss_table*/
-                        ret = miss_table_access(miss_table, &req);
-                        /*hits in miss_table, insert it to ssd_cache*/
-                        if (ret == 1) {
-                            lru_cache_insert(ssd_cache, req.block_num,
-                                    req.server_num, req.volume_num,
-                                    &replaced_req);
-                        } // hits in miss_table
-                    } // hits in miss_filter
-                }
-            } else {
-                // write request
-                tot_writes += 1;
-                ret = lru_cache_lookup(s_wb, &req);
-                if (ret == 0) {
-                    ret = lru_cache_peek(tr_wb, &req);
-                    if (ret == 1) {
-                        // hits in tr_wb
-                        ret = ghost_cache_access(wb_ghost_cache, &req);
-                        if (ret == 1) {
-                            fprintf(debug_fp, "%"PRIu64" %"PRIu64" %"PRIu8" %"PRIu8"\n",
-                                csv_data.timestamp, req.block_num, req.server_num, req.volume_num);
-                            ret = lru_cache_remove(tr_wb, &req);
-                            check(ret==0,
-                                    "failed to remove entry from tr_wb.");
-                            ret = lru_cache_insert(s_wb, req.block_num,
-                                    req.server_num, req.volume_num,
-                                    &replaced_req);
-                            if (ret == 1) {
-                                ret = lru_cache_peek(tr_wb, &replaced_req);
-                                if (ret == 1) {
-                                    ret = lru_cache_update(tr_wb,
-                                            &replaced_req);
-                                    check(ret==0,
-                                            "failed to update entry in tr_wb.");
-                                } else {
-                                    ret = lru_cache_insert(tr_wb,
-                                            replaced_req.block_num,
-                                            replaced_req.server_num,
-                                            replaced_req.volume_num, &req);
-                                    if (ret == 1) {
-                                        ret = lru_cache_peek(ssd_cache,
-                                                &req);
-                                        if (ret == 1) {
-                                            ret = lru_cache_update(ssd_cache,
-                                                    &req);
-                                            check(ret==0,
-                                                    "failed to update entry in ssd_cache.");
-                                        } else {
-                                            lru_cache_insert(ssd_cache,
-                                                    req.block_num,
-                                                    req.server_num,
-                                                    req.volume_num,
-                                                    &replaced_req);
-                                        }
-                                    }
-                                }
-                            } // write buffer has a replaced entry
-                        } else {
-                            // cannot make into the write buffer
-                            // write to ssd instead.
-                            ret = lru_cache_lookup(tr_wb, &req);
-                        }
-
-                    } // hits in tr_wb
-                    else {
-                        ret = lru_cache_peek(ssd_cache, &req);
-                        if (ret == 0) {
-                            // miss in ssd_cache
-                            ret = miss_filter_lookup(miss_filter, &req);
-                            if (ret == 1) {
-                                /*hits in miss_filter, check miss_table*/
-                                ret = miss_table_access(miss_table, &req);
-                                /*hits in miss_table, insert it to ssd_cache*/
-                                if (ret == 1) {
-                                    ret = ghost_cache_access(wb_ghost_cache,
-                                            &req);
-                                    if (ret == 0) {
-                                        // allocate to tr_wb
-                                        ret = lru_cache_insert(tr_wb,
-                                                req.block_num, req.server_num,
-                                                req.volume_num, &replaced_req);
-                                        if (ret == 1) {
-                                            ret = lru_cache_peek(ssd_cache,
-                                                    &replaced_req);
-                                            if (ret == 1) {
-                                                ret = lru_cache_update(
-                                                        ssd_cache,
-                                                        &replaced_req);
-                                                check(ret==0,
-                                                        "failed to update entry in ssd_cache.");
-                                            } else {
-                                                lru_cache_insert(ssd_cache,
-                                                        replaced_req.block_num,
-                                                        replaced_req.server_num,
-                                                        replaced_req.volume_num,
-                                                        &req);
-                                            }
-                                        }
-                                    } else {
-                                        // allocate to wb
-                                        fprintf(debug_fp, "%"PRIu64" %"PRIu64" %"PRIu8" %"PRIu8"\n",
-                                            csv_data.timestamp, req.block_num, req.server_num, req.volume_num);
-                                        ret = lru_cache_insert(s_wb,
-                                                req.block_num, req.server_num,
-                                                req.volume_num, &replaced_req);
-                                        if (ret == 1) {
-                                            ret = lru_cache_peek(tr_wb,
-                                                    &replaced_req);
-                                            if (ret == 1) {
-                                                ret = lru_cache_update(
-                                                        ssd_cache,
-                                                        &replaced_req);
-                                                check(ret==0,
-                                                        "failed to update entry in wr_wb.");
-                                            } else {
-                                                ret = lru_cache_insert(tr_wb,
-                                                        replaced_req.block_num,
-                                                        replaced_req.server_num,
-                                                        replaced_req.volume_num,
-                                                        &req);
-                                                if (ret == 1) {
-                                                    ret = lru_cache_peek(
-                                                            ssd_cache, &req);
-                                                    if (ret == 1) {
-                                                        ret = lru_cache_update(
-                                                                ssd_cache,
-                                                                &req);
-                                                        check(ret==0,
-                                                                "failed to update entry in ssd_cache.");
-                                                    } else {
-                                                        ret = lru_cache_insert(
-                                                                ssd_cache,
-                                                                req.block_num,
-                                                                req.server_num,
-                                                                req.volume_num,
-                                                                &replaced_req);
-                                                    }
-                                                }
-                                            }
-                                        } // write buffer has a replaced entry
-                                    } // allocate to wb
-                                } // hits in miss_table
-                            } // hits in miss_filter
-                        } else {
-                            // hits in ssd_cache
-                            ret = ghost_cache_access(wb_ghost_cache, &req);
-                            if (ret == 1) {
-                                fprintf(debug_fp, "%"PRIu64" %"PRIu64" %"PRIu8" %"PRIu8"\n",
-                                    csv_data.timestamp, req.block_num, req.server_num, req.volume_num);
-                                ret = lru_cache_remove(ssd_cache, &req);
-                                check(ret==0,
-                                        "failed to remove entry from ssd_cache.");
-                                ret = lru_cache_insert(s_wb,
-                                        req.block_num, req.server_num,
-                                        req.volume_num, &replaced_req);
-                                if (ret == 1) {
-                                    ret = lru_cache_peek(ssd_cache,
-                                            &replaced_req);
-                                    if (ret == 1) {
-                                        ret = lru_cache_update(ssd_cache,
-                                                &replaced_req);
-                                        check(ret==0,
-                                                "failed to update entry in ssd_cache.");
-                                    } else {
-                                        lru_cache_insert(ssd_cache,
-                                                replaced_req.block_num,
-                                                replaced_req.server_num,
-                                                replaced_req.volume_num, &req);
-                                    }
-                                } // write buffer has a replaced entry
-                            } else {
-                                // cannot make into the write buffer
-                                // write to ssd instead.
-                                ret = lru_cache_lookup(ssd_cache, &req);
-                            }
-                        }
-                    } // misses in tr_wb
-                } // misses in sieved_wb
-            } // write request
-            req.block_num += 1;
-        } // loop through each request
-    } // loop through each line from the trace file
+/*
+ * Read a sweep file, one configuration per line in the same
+ * positional form as the command line ('#' starts a comment line).
+ * Every configuration starts out as a copy of defaults.
+ */
+static int parse_sweep_file(char *sweep_file, ConfigInfo *defaults,
+        ConfigInfo **configs, uint32_t *num_configs) {
+    FILE *fp = NULL;
+    char line[FILE_LINE_SIZE];
+    char *args[SWEEP_MAX_ARGS];
+    int num_args, ret;
+    uint32_t capacity = 0, line_num = 0;
+    ConfigInfo *new_configs;
+
+    *configs = NULL;
+    *num_configs = 0;
+
+    fp = fopen(sweep_file, "r");
+    check(fp!=NULL, "failed to open sweep file: %s", sweep_file);
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_num += 1;
+
+        num_args = 0;
+        args[num_args++] = "sweep";
+        args[num_args] = strtok(line, " \t\r\n");
+        while ((args[num_args] != NULL) && (args[num_args][0] != '#')) {
+            num_args += 1;
+            check(num_args<SWEEP_MAX_ARGS, "too many arguments on sweep "
+                    "file line %"PRIu32".", line_num);
+            args[num_args] = strtok(NULL, " \t\r\n");
+        }
+        if (num_args == 1) {
+            continue;
+        }
 
-    gettimeofday(&end, NULL);
+        if (*num_configs == capacity) {
+            capacity = (capacity == 0) ? 16 : (capacity << 1);
+            new_configs = (ConfigInfo *) realloc(*configs,
+                    capacity * sizeof(ConfigInfo));
+            check(new_configs!=NULL, "failed to allocate sweep configurations.");
+            *configs = new_configs;
+        }
 
-    fprintf(out_fp, "total number of requests: %"PRIu64"\n", tot_reqs);
-    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", tot_reads);
-    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", tot_writes);
-    long duration = (end.tv_sec - start.tv_sec) * 1000000
-                + (end.tv_usec - start.tv_usec);
-    fprintf(out_fp, "time consumed = %.4f (min)\n",
-                (double) duration / (1000000.0 * 60.0));
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "sieved write buffer: \n");
-    fprintf(out_fp, "sieved_wb_size  :  %"PRIu64"\n", s_wb->cache_size);
-    fprintf(out_fp, "read hits       :  %"PRIu64"\n", s_wb->read_hits);
-    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", s_wb->read_lookups);
-    fprintf(out_fp, "read hits ratio :  %.4f\n",
-          (double) s_wb->read_hits/(double) s_wb->read_lookups);
-    fprintf(out_fp, "write hits      :  %"PRIu64"\n", s_wb->write_hits);
-    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", s_wb->write_lookups);
-    fprintf(out_fp, "write hits ratio:  %.4f\n",
-          (double) s_wb->write_hits/(double) s_wb->write_lookups);
-    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", s_wb->num_writes);
-    fprintf(out_fp, "num updates     :  %"PRIu64"\n", s_wb->num_updates);
-    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", s_wb->num_replaces);
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "traditional write buffer: \n");
-    fprintf(out_fp, "sieved_wb_size  :  %"PRIu64"\n", tr_wb->cache_size);
-    fprintf(out_fp, "read hits       :  %"PRIu64"\n", tr_wb->read_hits);
-    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", tr_wb->read_lookups);
-    fprintf(out_fp, "read hits ratio :  %.4f\n",
-            (double) tr_wb->read_hits / (double) tr_wb->read_lookups);
-    fprintf(out_fp, "write hits      :  %"PRIu64"\n", tr_wb->write_hits);
-    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", tr_wb->write_lookups);
-    fprintf(out_fp, "write hits ratio:  %.4f\n",
-            (double) tr_wb->write_hits / (double) tr_wb->write_lookups);
-    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", tr_wb->num_writes);
-    fprintf(out_fp, "num removes     :  %"PRIu64"\n", tr_wb->num_removes);
-    fprintf(out_fp, "num updates     :  %"PRIu64"\n", tr_wb->num_updates);
-    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", tr_wb->num_replaces);
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "ssd cache: \n");
-
-    fprintf(out_fp, "ssd cache size: %"PRIu64":\n", ssd_cache->cache_size);
-    fprintf(out_fp, "ssd cache miss filter threshold: %"PRIu32"\n",
-            miss_filter->threshold);
-    fprintf(out_fp, "ssd cache miss table threshold: %"PRIu32"\n",
-            miss_table->threshold);
-    fprintf(out_fp, "num sub windows: %"PRIu8"\n", miss_filter->num_sub_windows);
-    fprintf(out_fp, "read hits       :  %"PRIu64"\n", ssd_cache->read_hits);
-    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", ssd_cache->read_lookups);
-    fprintf(out_fp, "read hits ratio :  %.4f\n",
-          (double) ssd_cache->read_hits/(double) ssd_cache->read_lookups);
-    fprintf(out_fp, "write hits      :  %"PRIu64"\n", ssd_cache->write_hits);
-    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", ssd_cache->write_lookups);
-    fprintf(out_fp, "write hits ratio:  %.4f\n",
-          (double) ssd_cache->write_hits/(double) ssd_cache->write_lookups);
-    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", ssd_cache->num_writes);
-    fprintf(out_fp, "num removes     :  %"PRIu64"\n", ssd_cache->num_removes);
-    fprintf(out_fp, "num updates     :  %"PRIu64"\n", ssd_cache->num_updates);
-    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", ssd_cache->num_replaces);
-
-    fprintf(out_fp, "\n");
-    fprintf(out_fp, "ghost cache: \n");
-
-    fprintf (out_fp, "ghost cache size: %"PRIu64"\n", wb_ghost_cache->cache_size);
-    fprintf (out_fp, "ghost cache threshold: %"PRIu32"\n", wb_ghost_cache->threshold);
-    fprintf (out_fp, "ghost cache num_sub_windows: %"PRIu8"\n",
-            wb_ghost_cache->num_sub_windows);
-    fprintf (out_fp, "num_inserts    :  %"PRIu32"\n", wb_ghost_cache->num_inserts);
-    fprintf (out_fp, "num_replaces    : %"PRIu32"\n", wb_ghost_cache->num_replaces);
+        (*configs)[*num_configs] = *defaults;
+        ret = parse_test_args(num_args, args, &((*configs)[*num_configs]));
+        check(ret==0, "bad configuration on sweep file line %"PRIu32".",
+                line_num);
+        *num_configs += 1;
+    }
+    check(*num_configs>0, "no configuration in sweep file: %s", sweep_file);
 
-    /* destroy resource */
-    fclose(trace_fp);
-    fclose(out_fp);
-    fclose(debug_fp);
-    lru_cache_destroy (s_wb);
-    lru_cache_destroy (tr_wb);
-    miss_filter_destroy(miss_filter);
-    miss_table_destroy(miss_table);
-    ghost_cache_destroy(wb_ghost_cache);
-    lru_cache_destroy(ssd_cache);
+    fclose(fp);
 
     return 0;
 
 error:
-    if (trace_fp != NULL) {
-        fclose(trace_fp);
-    }
 
-    if (out_fp != NULL) {
-        fclose(out_fp);
+    if (fp != NULL) {
+        fclose(fp);
     }
 
-    if (debug_fp != NULL) {
-        fclose(debug_fp);
+    if (*configs != NULL) {
+        free(*configs);
+        *configs = NULL;
     }
 
-    if (s_wb != NULL) {
-        lru_cache_destroy (s_wb);
-    }
+    return -1;
+}
 
-    if (tr_wb != NULL) {
-        lru_cache_destroy (tr_wb);
-    }
+/* Simulate all configurations in one pass over the trace. */
+static int run_simulators(ConfigInfo *configs, uint32_t num_configs,
+        uint8_t interleave) {
+    int ret;
+    uint32_t i;
+    Simulator **sims = NULL;
 
-    if (miss_filter != NULL) {
-        miss_filter_destroy(miss_filter);
-    }
+    sims = (Simulator **) calloc(num_configs, sizeof(Simulator *));
+    check(sims!=NULL, "failed to allocate simulators.");
 
-    if (miss_table != NULL) {
-        miss_table_destroy(miss_table);
+    for (i = 0; i < num_configs; i++) {
+        sims[i] = (Simulator *) calloc(1, sizeof(Simulator));
+        check(sims[i]!=NULL, "failed to allocate simulator.");
+        ret = simulator_init(&(configs[i]), sims[i]);
+        check(ret==0, "failed to initialize simulator for %s.",
+                configs[i].result_file);
     }
 
-    if (wb_ghost_cache != NULL) {
-        ghost_cache_destroy(wb_ghost_cache);
+    ret = simulator_run(configs[0].trace_file, configs[0].num_parser_threads,
+            sims, num_configs, interleave);
+    check(ret==0, "failed to run simulation.");
+
+    for (i = 0; i < num_configs; i++) {
+        simulator_report(sims[i]);
+        simulator_destroy(sims[i]);
+        sims[i] = NULL;
     }
+    free(sims);
 
-    if (ssd_cache != NULL) {
-        lru_cache_destroy(ssd_cache);
+    return 0;
+
+error:
+
+    if (sims != NULL) {
+        for (i = 0; i < num_configs; i++) {
+            if (sims[i] != NULL) {
+                simulator_destroy(sims[i]);
+            }
+        }
+        free(sims);
     }
 
     return -1;
@@ -1606,12 +645,15 @@ error:
 
 int main(int argc, char *argv[]) {
     int ret = 0;
+    int opt;
+    char *sweep_file = NULL;
+    uint32_t num_configs = 0, num_workers = 0, num_shards = 0, i;
+    uint32_t bench_iterations = 0;
+    uint8_t pin_cpus = 0, validate_shards = 0, pipelined = 0, interleave = 0;
+    uint8_t static_buffers = 0;
+    uint8_t table_mode = TABLE_MEM_DEFAULT_MODE, table_prefault = 0;
     ConfigInfo *config_info;
-
-    if (argc < 2) {
-        usage(argv[0]);
-        return 1;
-    }
+    ConfigInfo *configs = NULL;
 
     /* memory allocation */
     config_info = (ConfigInfo *) calloc(1, sizeof(ConfigInfo));
@@ -1624,97 +666,192 @@ int main(int argc, char *argv[]) {
     config_info->ssd_size = (uint64_t)12 * 1024 * 1024 *1024;
     config_info->ssd_size = (config_info->ssd_size >> LOG_2_BLOCK_SIZE);
     config_info->num_sub_windows = 4;
+    config_info->num_parser_threads = TRACE_STREAM_DEFAULT_PARSERS;
+    config_info->sample_rate = 1.0;
 
-    /* parse configuration file */
-/*    ret = parse_config_file(argv[1], config_info);
-    check(ret==0, "failed to parse configuration file: %s", argv[1]);*/
-
-    if (atoi(argv[1]) == 0) {
-        if (argc != 5) {
-            printf("base line sieve store: ./%s 0 num_sub_window miss_filter_threshold miss_table_threshold\n", argv[0]);
+    while ((opt = getopt(argc, argv, "f:p:S:j:PIB:N:VLTr:H:g:Gm:Z")) != -1) {
+        switch (opt) {
+        case 'f':
+            strncpy (config_info->trace_file, optarg, FILE_LINE_SIZE - 1);
+            break;
+        case 'p':
+            ret = atoi(optarg);
+            check (ret>=0, "invalid number of parser threads: %s", optarg);
+            config_info->num_parser_threads = ret;
+            break;
+        case 'S':
+            sweep_file = optarg;
+            break;
+        case 'j':
+            ret = atoi(optarg);
+            check (ret>=0, "invalid number of sweep workers: %s", optarg);
+            num_workers = ret;
+            break;
+        case 'P':
+            pin_cpus = 1;
+            break;
+        case 'I':
+            interleave = 1;
+            break;
+        case 'B':
+            ret = atoi(optarg);
+            check (ret>0, "invalid number of benchmark iterations: %s",
+                    optarg);
+            bench_iterations = ret;
+            break;
+        case 'N':
+            ret = atoi(optarg);
+            check ((ret>=1) && (ret<=SHARD_MAX_SHARDS),
+                    "invalid number of shards: %s", optarg);
+            num_shards = ret;
+            break;
+        case 'V':
+            validate_shards = 1;
+            break;
+        case 'L':
+            pipelined = 1;
+            break;
+        case 'T':
+            static_buffers = 1;
+            break;
+        case 'H':
+            ret = atoi(optarg);
+            check ((ret>=0) && (ret<=MISS_FILTER_MAX_HASHES),
+                    "invalid number of miss filter hashes: %s", optarg);
+            config_info->miss_filter_hashes = ret;
+            break;
+        case 'g':
+            ret = atoi(optarg);
+            check (ret>0, "invalid ghost cache size: %s", optarg);
+            config_info->sieved_ghost_cache_size = ret;
+            break;
+        case 'G':
+            config_info->ghost_cache_compact = 1;
+            break;
+        case 'm':
+            ret = atoi(optarg);
+            check ((ret>=TABLE_MEM_CALLOC) && (ret<=TABLE_MEM_HUGETLB),
+                    "invalid table memory mode: %s", optarg);
+            table_mode = ret;
+            break;
+        case 'Z':
+            table_prefault = 1;
+            break;
+        case 'r':
+            config_info->sample_rate = atof(optarg);
+            check ((config_info->sample_rate>0.0)
+                    && (config_info->sample_rate<=1.0),
+                    "invalid sample rate: %s", optarg);
+            break;
+        default:
+            usage(argv[0]);
+            free(config_info);
             return 1;
         }
-        config_info->num_sub_windows = atoi(argv[2]);
-        config_info->miss_filter_threshold = atoi(argv[3]);
-        config_info->miss_table_threshold = atoi(argv[4]);
-        sprintf(config_info->result_file, "./results/ss_%"PRIu8"_%"PRIu32"_%"PRIu32".out",
-                config_info->num_sub_windows, config_info->miss_filter_threshold,
-                config_info->miss_table_threshold);
+    }
 
-        ret = run_sieve_store_base(config_info);
-        check(ret==0, "failed to run sieve store base.");
-    } else if (atoi(argv[1]) == 1) {
-        if (argc != 6) {
-            printf("traditional write buffer: ./%s 1 tr_wb_size num_sub_window miss_filter_threshold miss_table_threshold\n", argv[0]);
+    table_mem_configure(table_mode, table_prefault);
+
+    /* drop the options so that the test arguments start at argv[1] */
+    argv[optind - 1] = argv[0];
+    argc -= (optind - 1);
+    argv += (optind - 1);
+
+    if (sweep_file != NULL) {
+        ret = parse_sweep_file(sweep_file, config_info, &configs, &num_configs);
+        check(ret==0, "failed to parse sweep file: %s", sweep_file);
+    } else {
+        if (argc < 2) {
+            usage(argv[0]);
+            free(config_info);
             return 1;
         }
-        config_info->traditional_wb_size = atoi(argv[2]);
-        config_info->num_sub_windows = atoi(argv[3]);
-        config_info->miss_filter_threshold = atoi(argv[4]);
-        config_info->miss_table_threshold = atoi(argv[5]);
-        sprintf(config_info->result_file,
-                "./results/tr_wb_%"PRIu64"_%"PRIu8"_%"PRIu32"_%"PRIu32".out",
-                config_info->traditional_wb_size,
-                config_info->num_sub_windows,
-                config_info->miss_filter_threshold,
-                config_info->miss_table_threshold);
 
-        ret = run_traditional_write_buffer(config_info);
-        check(ret==0, "failed to run traditional write buffer.");
-    } else if (atoi(argv[1]) == 2) {
-        if (argc != 4) {
-            printf("sieved write buffer: ./%s 2 s_wb_threshold s_wb_size\n", argv[0]);
-        }
-        config_info->sieved_ghost_cache_size = 409600;
-        config_info->sieved_wb_threshold = atoi(argv[2]);
-        config_info->sieved_wb_size = atoi(argv[3]);
-        sprintf(config_info->result_file, "./results/s_wb_%"PRIu32"_%"PRIu64".out",
-                config_info->sieved_wb_threshold, config_info->sieved_wb_size);
+        /* parse configuration file */
+/*        ret = parse_config_file(argv[1], config_info);
+        check(ret==0, "failed to parse configuration file: %s", argv[1]);*/
 
-        ret = run_sieved_write_buffer (config_info);
-        check (ret==0, "failed to run sieved write buffer.");
-    } else if (atoi(argv[1]) == 3) {
-        if (argc != 6) {
-            printf("\t sieved + traditional write buffer: %s 3 "
-                    "s_wb_threshold num_time_windows miss_filter_threshold "
-                    "miss_table_threshold\n", argv[0]);
+        ret = parse_test_args(argc, argv, config_info);
+        if (ret != 0) {
+            free(config_info);
+            return 1;
         }
-        config_info->sieved_ghost_cache_size = 409600;
-        config_info->sieved_wb_size = 51200;
-        config_info->traditional_wb_size = 51200;
-        config_info->sieved_wb_threshold = atoi(argv[2]);
-		config_info->num_sub_windows = atoi(argv[3]);
-        config_info->miss_filter_threshold = atoi(argv[4]);
-        config_info->miss_table_threshold = atoi(argv[5]);
-		sprintf(config_info->result_file,
-		        "./results/s_tr_wb_%"PRIu32"_%"PRIu8"_%"PRIu32"_%"PRIu32".out",
-                config_info->sieved_wb_threshold, config_info->num_sub_windows,
-                config_info->miss_filter_threshold,
-                config_info->miss_table_threshold);
-        sprintf(config_info->debug_file,
-                "./debug/s_tr_wb_%"PRIu32"_%"PRIu8"_%"PRIu32"_%"PRIu32".out",
-                config_info->sieved_wb_threshold, config_info->num_sub_windows,
-                config_info->miss_filter_threshold,
-                config_info->miss_table_threshold);
-        //config_info->sieved_wb_threshold = atoi(argv[2]);
-        //config_info->sieved_wb_size = atoi(argv[3]);
-        //config_info->traditional_wb_size = atoi(argv[4]);
-        /*sprintf(config_info->result_file, "./results/s_tr_wb_%"PRIu32"_%"PRIu64"_%"PRIu64".out",
-                config_info->sieved_wb_threshold, config_info->sieved_wb_size,
-                config_info->traditional_wb_size);
-				*/
-
-        ret = run_sieved_plus_traditional_wb (config_info);
-        check(ret == 0, "failed to run sieved plus traditional write buffer.");
+        configs = config_info;
+        config_info = NULL;
+        num_configs = 1;
+    }
+
+#ifndef BOUNCER_THREADS
+    if (num_workers > 0) {
+        log_info("built without pthreads, running the sweep in one pass.");
+        num_workers = 0;
+    }
+#endif
+
+    check((num_shards==0) || (num_workers==0),
+            "-N and -j cannot be combined.");
+    check(validate_shards==0 || (num_shards>0), "-V needs -N.");
+    check((pipelined==0) || ((num_shards==0) && (num_workers==0)),
+            "-L cannot be combined with -N or -j.");
+
+    check((interleave==0)
+            || ((num_shards==0) && (num_workers==0) && (pipelined==0)),
+            "-I cannot be combined with -N, -j or -L.");
+    check((bench_iterations==0)
+            || ((num_shards==0) && (num_workers==0) && (pipelined==0)),
+            "-B cannot be combined with -N, -j or -L.");
+    check((static_buffers==0) || ((num_shards==0) && (num_workers==0)
+                && (pipelined==0) && (interleave==0)
+                && (bench_iterations==0)),
+            "-T cannot be combined with -N, -j, -L, -I or -B.");
+
+    if (bench_iterations > 0) {
+        ret = sweep_bench(configs, num_configs, bench_iterations);
+        check(ret==0, "failed to run benchmark.");
+    } else if (static_buffers) {
+        for (i = 0; i < num_configs; i++) {
+            check(configs[i].test_type==SIM_SIEVE_STORE_BASE,
+                    "-T needs base line sieve store configurations.");
+            // the static buffers are sized at compile time
+            configs[i].ssd_size = STATIC_SSD_SIZE;
+            ret = run_static_buffer(&(configs[i]));
+            check(ret==0, "failed to run static buffers of %s.",
+                    configs[i].result_file);
+        }
+    } else if (pipelined) {
+        for (i = 0; i < num_configs; i++) {
+            ret = pipeline_run(&(configs[i]));
+            check(ret==0, "failed to run pipelined simulation of %s.",
+                    configs[i].result_file);
+        }
+    } else if (num_shards > 0) {
+        for (i = 0; i < num_configs; i++) {
+            ret = shard_run(&(configs[i]), num_shards, validate_shards);
+            check(ret==0, "failed to run sharded simulation of %s.",
+                    configs[i].result_file);
+        }
+    } else if (num_workers > 0) {
+        ret = sweep_run_parallel(configs, num_configs, num_workers, pin_cpus);
+        check(ret==0, "failed to run parallel sweep.");
+    } else {
+        ret = run_simulators(configs, num_configs, interleave);
+        check(ret==0, "failed to run simulation.");
     }
 
     /* memory deallocation*/
-    free(config_info);
+    free(configs);
+    if (config_info != NULL) {
+        free(config_info);
+    }
 
     return 0;
 
 error:
 
+    if (configs != NULL) {
+        free(configs);
+    }
+
     if (config_info != NULL) {
         free(config_info);
     }
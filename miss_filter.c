@@ -3,15 +3,138 @@
 #include "debug.h"
 #include "common.h"
 #include "miss_filter.h"
+#include "window_counter.h"
+#include "table_mem.h"
+
+static inline uint64_t slot_load (MissFilter *miss_filter, uint64_t ind)
+{
+    switch (miss_filter->slot_bytes) {
+    case 1:
+        return ((uint8_t *) miss_filter->slots)[ind];
+    case 2:
+        return ((uint16_t *) miss_filter->slots)[ind];
+    case 4:
+        return ((uint32_t *) miss_filter->slots)[ind];
+    default:
+        return ((uint64_t *) miss_filter->slots)[ind];
+    }
+}
+
+static inline void slot_store (MissFilter *miss_filter, uint64_t ind,
+        uint64_t value)
+{
+    switch (miss_filter->slot_bytes) {
+    case 1:
+        ((uint8_t *) miss_filter->slots)[ind] = value;
+        break;
+    case 2:
+        ((uint16_t *) miss_filter->slots)[ind] = value;
+        break;
+    case 4:
+        ((uint32_t *) miss_filter->slots)[ind] = value;
+        break;
+    default:
+        ((uint64_t *) miss_filter->slots)[ind] = value;
+        break;
+    }
+}
+
+/*
+ * Every slot with live counters was last accessed within
+ * [last_sweep - num_sub_windows + 1, next_sweep), a range shorter than
+ * 2^tag_bits, so its tag gives back the full sub window. Zero the
+ * counters of the slots that are stale at curr, after which the range
+ * starts over from curr.
+ */
+static void miss_filter_sweep (MissFilter *miss_filter, uint32_t curr)
+{
+    uint32_t n         = miss_filter->num_sub_windows;
+    uint8_t  shift     = n * miss_filter->counter_bits;
+    uint64_t ones      = window_counter_ones (n, miss_filter->counter_bits);
+    uint64_t tag_mask  = (1ULL << miss_filter->tag_bits) - 1;
+    int64_t  base      = (int64_t) miss_filter->last_sweep - n + 1;
+    uint64_t i, value;
+    int64_t  last;
+
+    for (i = 0; i < miss_filter->size; i++) {
+        value = slot_load (miss_filter, i);
+        if ((value & ones) == 0) {
+            continue;
+        }
+        last = base + (int64_t) (((value >> shift) - (uint64_t) base)
+                                 & tag_mask);
+        if ((int64_t) curr - last >= n) {
+            slot_store (miss_filter, i, value & ~ones);
+        }
+    }
+
+    miss_filter->last_sweep = curr;
+    miss_filter->next_sweep = (uint64_t) curr
+                            + (1ULL << (miss_filter->tag_bits - 1));
+}
+
+/*
+ * Pick the narrowest slot that holds the counters and a tag of at
+ * least 1 + log2(num_sub_windows) bits, the rest of the slot goes to
+ * the tag. Returns 0 if no slot of up to 64 bits is wide enough.
+ */
+static int miss_filter_pack (MissFilter *miss_filter)
+{
+    uint32_t n = miss_filter->num_sub_windows;
+    uint32_t min_tag_bits = 1, slot_bits;
+
+    miss_filter->counter_max = miss_filter->threshold + 1;
+    if (miss_filter->counter_max > MISS_FILTER_COUNTER_MAX) {
+        miss_filter->counter_max = MISS_FILTER_COUNTER_MAX;
+    }
+
+    miss_filter->counter_bits = 1;
+    while ((1U << miss_filter->counter_bits) <= miss_filter->counter_max) {
+        miss_filter->counter_bits += 1;
+    }
+
+    while ((1U << (min_tag_bits - 1)) < n) {
+        min_tag_bits += 1;
+    }
+
+    for (slot_bits = 8; slot_bits <= 64; slot_bits <<= 1) {
+        if (n * miss_filter->counter_bits + min_tag_bits <= slot_bits) {
+            miss_filter->slot_bytes = slot_bits >> 3;
+            miss_filter->tag_bits = slot_bits - n * miss_filter->counter_bits;
+            miss_filter->last_sweep = 0;
+            miss_filter->next_sweep = 1ULL << (miss_filter->tag_bits - 1);
+            return 1;
+        }
+    }
+
+    return 0;
+}
 
 int miss_filter_init(uint64_t size, uint32_t threshold,
-        uint8_t num_sub_windows, MissFilter *miss_filter) {
+        uint8_t num_sub_windows, uint8_t num_hashes, MissFilter *miss_filter) {
     miss_filter->size             = size;
     miss_filter->threshold        = threshold;
     miss_filter->num_sub_windows  = num_sub_windows;
+    miss_filter->num_hashes       = num_hashes;
+    check((num_sub_windows>=1) && (num_sub_windows<=12),
+            "the miss filter needs 1 to 12 sub windows.");
+    check(num_hashes<=MISS_FILTER_MAX_HASHES,
+            "the miss filter takes at most %d hashes.", MISS_FILTER_MAX_HASHES);
 
-    miss_filter->entry = (MissFilterEntry *)calloc(size, sizeof(MissFilterEntry));
-    check(miss_filter->entry!=NULL, "failed to allocate miss filter entry.");
+    if (num_hashes > 0) {
+        miss_filter->row_size = size / num_hashes;
+        check(miss_filter->row_size>=1, "the miss filter is too small.");
+        check(miss_filter_pack(miss_filter),
+                "the count-min miss filter needs the counters to fit in 64 bits.");
+        miss_filter->slots = table_mem_alloc(size * miss_filter->slot_bytes);
+        check(miss_filter->slots!=NULL, "failed to allocate miss filter slots.");
+    } else if (miss_filter_pack(miss_filter)) {
+        miss_filter->slots = table_mem_alloc(size * miss_filter->slot_bytes);
+        check(miss_filter->slots!=NULL, "failed to allocate miss filter slots.");
+    } else {
+        miss_filter->entry = (MissFilterEntry *)table_mem_alloc(size * sizeof(MissFilterEntry));
+        check(miss_filter->entry!=NULL, "failed to allocate miss filter entry.");
+    }
 
     return 0;
 
@@ -20,11 +143,118 @@ int miss_filter_init(uint64_t size, uint32_t threshold,
     return -1;
 }
 
+/*
+ * Bring a slot up to sub window curr: zero the stale counters and
+ * retag it.
+ */
+static inline uint64_t slot_refresh(MissFilter *miss_filter, uint64_t value,
+        uint32_t curr) {
+    uint32_t n        = miss_filter->num_sub_windows;
+    uint8_t  cb       = miss_filter->counter_bits;
+    uint8_t  shift    = n * cb;
+    uint64_t tag_mask = (1ULL << miss_filter->tag_bits) - 1;
+    uint32_t diff     = (curr - (value >> shift)) & tag_mask;
+
+    value &= window_counter_ones(n, cb) & ~window_stale_mask(n, cb, diff, curr);
+
+    return (value | (((uint64_t) curr & tag_mask) << shift));
+}
+
+static inline uint32_t slot_sum(MissFilter *miss_filter, uint64_t value) {
+    uint8_t  cb    = miss_filter->counter_bits;
+    uint64_t cmask = (1ULL << cb) - 1;
+    uint32_t i, sum = 0;
+
+    for (i = 0; i < miss_filter->num_sub_windows; i++) {
+        sum += (value >> (i * cb)) & cmask;
+    }
+
+    return sum;
+}
+
+static inline uint64_t slot_bump(MissFilter *miss_filter, uint64_t value,
+        uint32_t curr) {
+    uint8_t  cb    = miss_filter->counter_bits;
+    uint8_t  shift = (curr % miss_filter->num_sub_windows) * cb;
+
+    if (((value >> shift) & ((1ULL << cb) - 1)) != miss_filter->counter_max) {
+        value += (1ULL << shift);
+    }
+
+    return value;
+}
+
+static int miss_filter_lookup_packed(MissFilter *miss_filter, Request *req) {
+    uint32_t curr     = req->sub_window_ind;
+    uint32_t miss_filter_slot = req->block_num % miss_filter->size;
+    uint32_t miss_count;
+    uint64_t value;
+
+    if (curr >= miss_filter->next_sweep) {
+        miss_filter_sweep(miss_filter, curr);
+    }
+
+    /* update stale miss count information */
+    value = slot_refresh(miss_filter, slot_load(miss_filter, miss_filter_slot),
+            curr);
+    miss_count = slot_sum(miss_filter, value);
+    slot_store(miss_filter, miss_filter_slot, slot_bump(miss_filter, value, curr));
+
+    return (miss_count > miss_filter->threshold);
+}
+
+/*
+ * Row i of the count-min sketch uses h1 + i * h2, double hashing of
+ * the full block key.
+ */
+static int miss_filter_lookup_count_min(MissFilter *miss_filter, Request *req) {
+    uint32_t curr = req->sub_window_ind;
+    uint64_t h1   = hash_u64(request_key(req));
+    uint64_t h2   = hash_u64(h1) | 1;
+    uint64_t ind[MISS_FILTER_MAX_HASHES], value[MISS_FILTER_MAX_HASHES];
+    uint32_t sum[MISS_FILTER_MAX_HASHES], miss_count = UINT32_MAX;
+    uint32_t i;
+
+    if (curr >= miss_filter->next_sweep) {
+        miss_filter_sweep(miss_filter, curr);
+    }
+
+    for (i = 0; i < miss_filter->num_hashes; i++) {
+        ind[i] = i * miss_filter->row_size
+               + (h1 + i * h2) % miss_filter->row_size;
+        value[i] = slot_refresh(miss_filter, slot_load(miss_filter, ind[i]),
+                curr);
+        sum[i] = slot_sum(miss_filter, value[i]);
+        if (sum[i] < miss_count) {
+            miss_count = sum[i];
+        }
+    }
+
+    /* conservative update, only the smallest counts grow */
+    for (i = 0; i < miss_filter->num_hashes; i++) {
+        if (sum[i] == miss_count) {
+            value[i] = slot_bump(miss_filter, value[i], curr);
+        }
+        slot_store(miss_filter, ind[i], value[i]);
+    }
+
+    return (miss_count > miss_filter->threshold);
+}
+
 int miss_filter_lookup(MissFilter *miss_filter, Request *req) {
     int i;
     int hits = 0;
     int ind = 0;
     int miss_count = 0;
+
+    miss_filter->curr_sub_window = req->sub_window_ind;
+    if (miss_filter->num_hashes > 0) {
+        return miss_filter_lookup_count_min(miss_filter, req);
+    }
+    if (miss_filter->slots != NULL) {
+        return miss_filter_lookup_packed(miss_filter, req);
+    }
+
     int num_sub_windows = miss_filter->num_sub_windows;
     uint32_t miss_filter_slot = req->block_num % miss_filter->size;
     MissFilterEntry *entry = &(miss_filter->entry[miss_filter_slot]);
@@ -75,9 +305,108 @@ int miss_filter_lookup(MissFilter *miss_filter, Request *req) {
     return hits;
 }
 
+/*
+ * Prefetch the slots that miss_filter_lookup will touch for requests
+ * about to be looked up.
+ */
+void miss_filter_prefetch_batch(const MissFilter *miss_filter,
+        const Request *reqs, uint32_t num_reqs) {
+    uint32_t i, j, miss_filter_slot;
+    uint64_t h1, h2;
+    const char *slots = (const char *) miss_filter->slots;
+
+    for (i = 0; i < num_reqs; i++) {
+        if (miss_filter->num_hashes > 0) {
+            h1 = hash_u64(request_key(&(reqs[i])));
+            h2 = hash_u64(h1) | 1;
+            for (j = 0; j < miss_filter->num_hashes; j++) {
+                __builtin_prefetch(slots + miss_filter->slot_bytes
+                        * (j * miss_filter->row_size
+                           + (h1 + j * h2) % miss_filter->row_size), 1);
+            }
+        } else {
+            miss_filter_slot = reqs[i].block_num % miss_filter->size;
+            if (slots != NULL) {
+                __builtin_prefetch(slots + miss_filter->slot_bytes
+                        * (uint64_t) miss_filter_slot, 1);
+            } else {
+                __builtin_prefetch(&(miss_filter->entry[miss_filter_slot]), 1);
+            }
+        }
+    }
+}
+
+/* Bytes of memory taken by the slots or entries. */
+uint64_t miss_filter_bytes(MissFilter *miss_filter) {
+    if (miss_filter->slots != NULL) {
+        return miss_filter->size * miss_filter->slot_bytes;
+    }
+
+    return miss_filter->size * sizeof(MissFilterEntry);
+}
+
+/* The windowed miss count a lookup of slot ind at curr would see. */
+static uint32_t miss_filter_slot_count(MissFilter *miss_filter, uint64_t ind,
+        uint32_t curr) {
+    MissFilterEntry *entry;
+    uint32_t i, diff, count = 0;
+    uint32_t n = miss_filter->num_sub_windows;
+
+    if (miss_filter->slots != NULL) {
+        return slot_sum(miss_filter, slot_refresh(miss_filter,
+                    slot_load(miss_filter, ind), curr));
+    }
+
+    entry = &(miss_filter->entry[ind]);
+    diff = curr - entry->last_access_sub_window_ind;
+    if (diff >= n) {
+        return 0;
+    }
+    /* counters after the last access up to curr's are stale */
+    for (i = 0; i < n - diff; i++) {
+        count += entry->counter[(entry->last_access_sub_window_ind + n - i) % n];
+    }
+
+    return count;
+}
+
+/*
+ * The chance that a block with no misses of its own is admitted at
+ * the end of the run: for a single slot the fraction of slots over
+ * the threshold, for the count-min sketch the product of that
+ * fraction over the rows, treating the rows as independent.
+ */
+double miss_filter_false_positive_rate(MissFilter *miss_filter) {
+    uint32_t curr = miss_filter->curr_sub_window;
+    uint32_t num_rows = (miss_filter->num_hashes > 0)
+                      ? miss_filter->num_hashes : 1;
+    uint64_t row_size = (miss_filter->num_hashes > 0)
+                      ? miss_filter->row_size : miss_filter->size;
+    uint64_t i, over;
+    uint32_t row;
+    double rate = 1.0;
+
+    for (row = 0; row < num_rows; row++) {
+        over = 0;
+        for (i = row * row_size; i < (row + 1) * row_size; i++) {
+            if (miss_filter_slot_count(miss_filter, i, curr)
+                    > miss_filter->threshold) {
+                over += 1;
+            }
+        }
+        rate *= (double) over / (double) row_size;
+    }
+
+    return rate;
+}
+
 void miss_filter_destroy(MissFilter *miss_filter) {
     if (miss_filter->entry != NULL) {
-        free(miss_filter->entry);
+        table_mem_free(miss_filter->entry);
+    }
+
+    if (miss_filter->slots != NULL) {
+        table_mem_free(miss_filter->slots);
     }
 
     free(miss_filter);
@@ -2,22 +2,57 @@
 #define MISS_FILTER_H_
 
 #include <inttypes.h>
+#include "common.h"
+
+#define MISS_FILTER_MAX_HASHES      8
 
 typedef struct MissFilterEntry {
     uint8_t   counter[12];
     uint32_t  last_access_sub_window_ind;
-} MissFilterEntry __attribute__((aligned(16)));
+} MissFilterEntry;
 
+/*
+ * Each slot holds num_sub_windows counters followed by a tag, the low
+ * tag_bits of the sub window the slot was last accessed in. Counters
+ * saturate at counter_max = threshold + 1, which cannot change whether
+ * their sum exceeds the threshold. Every 2^(tag_bits-1) sub windows a
+ * sweep zeroes the slots that have gone stale, so the tag of a slot
+ * with live counters is never ambiguous.
+ *
+ * When the counters do not fit in 64 bits the filter falls back to
+ * the MissFilterEntry layout.
+ *
+ * With num_hashes = 0 a block uses slot block_num % size, shared by
+ * that block number on every server and volume. Otherwise the slots
+ * form a count-min sketch of num_hashes rows, indexed by hashes of
+ * the whole block key. The windowed miss count of a block is the
+ * smallest among its slots, and only those slots are incremented
+ * (conservative update).
+ */
 typedef struct MissFilter {
     uint64_t         size;
     uint32_t         threshold;
     uint8_t          num_sub_windows;
-    MissFilterEntry *entry;
+    uint8_t          num_hashes;        // 0 - direct mapped on block_num
+    uint64_t         row_size;          // Slots per count-min row
+    uint32_t         curr_sub_window;   // Of the latest lookup
+    MissFilterEntry *entry;             // Legacy layout, NULL if packed
+    void            *slots;             // Packed layout
+    uint8_t          slot_bytes;        // 1, 2, 4 or 8
+    uint8_t          counter_bits;
+    uint8_t          tag_bits;
+    uint32_t         counter_max;
+    uint32_t         last_sweep;        // Sub window of the last sweep
+    uint64_t         next_sweep;
 } MissFilter;
 
 int  miss_filter_init    (uint64_t size, uint32_t threshold,
-        uint8_t num_sub_windows, MissFilter *miss_filter);
+        uint8_t num_sub_windows, uint8_t num_hashes, MissFilter *miss_filter);
 int  miss_filter_lookup  (MissFilter *miss_filter, Request *req);
+void miss_filter_prefetch_batch (const MissFilter *miss_filter,
+        const Request *reqs, uint32_t num_reqs);
+uint64_t miss_filter_bytes (MissFilter *miss_filter);
+double   miss_filter_false_positive_rate (MissFilter *miss_filter);
 void miss_filter_destroy (MissFilter *miss_filter);
 
 #endif
@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "common.h"
 #include "debug.h"
 #include "miss_table.h"
+#include "window_counter.h"
+#include "table_mem.h"
 
 
 int miss_table_init (uint64_t size, uint32_t threshold,
@@ -12,12 +15,13 @@ int miss_table_init (uint64_t size, uint32_t threshold,
     miss_table->lookup_table_size = size;
     miss_table->threshold         = threshold;
     miss_table->entry_count       = 0;
-    miss_table->num_prunes        = 0;
     miss_table->num_sub_windows   = num_sub_windows;
-    miss_table->lookup_table = (MissTableEntry **) calloc (size,
-            sizeof(MissTableEntry *));
+    miss_table->lookup_table = (MissTableEntry **) table_mem_alloc (size
+            * sizeof(MissTableEntry *));
     check(miss_table->lookup_table!=NULL,
             "failed to allocate miss_table->lookup_table.");
+    check(timer_wheel_init (num_sub_windows, &(miss_table->wheel)) == 0,
+            "failed to initialize miss_table->wheel.");
 
     return 0;
 
@@ -26,31 +30,117 @@ error:
     return -1;
 }
 
+static MissTableEntry *miss_table_alloc_entry (MissTable *miss_table)
+{
+    uint32_t i;
+    MissTableEntry *slab, *entry;
+
+    if (miss_table->free_list == NULL) {
+        if (miss_table->num_slabs == miss_table->max_slabs) {
+            miss_table->max_slabs = (miss_table->max_slabs == 0)
+                                  ? 64 : (miss_table->max_slabs << 1);
+            miss_table->slabs = (MissTableEntry **) realloc (miss_table->slabs,
+                    miss_table->max_slabs * sizeof(MissTableEntry *));
+            check (miss_table->slabs!=NULL, "failed to grow miss_table->slabs.");
+        }
+
+        slab = (MissTableEntry *) malloc (MISS_TABLE_SLAB_ENTRIES
+                * sizeof(MissTableEntry));
+        check (slab!=NULL, "failed to allocate a miss table slab.");
+        miss_table->slabs[miss_table->num_slabs] = slab;
+        miss_table->num_slabs += 1;
+
+        for (i = 0; i < MISS_TABLE_SLAB_ENTRIES - 1; i++) {
+            slab[i].next = &(slab[i + 1]);
+        }
+        slab[i].next = NULL;
+        miss_table->free_list = slab;
+    }
+
+    entry = miss_table->free_list;
+    miss_table->free_list = entry->next;
+    memset (entry, 0, sizeof(MissTableEntry));
+
+    return entry;
+
+error:
+
+    return NULL;
+}
+
+static inline void miss_table_free_entry (MissTable *miss_table,
+        MissTableEntry *entry)
+{
+    entry->next = miss_table->free_list;
+    miss_table->free_list = entry;
+}
+
+/* The chain a block key hangs off. */
+static inline uint64_t miss_table_slot (const MissTable *miss_table,
+        BlockKey key)
+{
+    return hash_u64 (key) % miss_table->lookup_table_size;
+}
+
+/*
+ * Move the wheel to sub_window_ind and drop the entries it expires.
+ * An expired entry has had no access for num_sub_windows sub windows,
+ * so all of its counters would be cleared on the next access anyway.
+ */
+static void miss_table_expire (MissTable *miss_table, uint32_t sub_window_ind)
+{
+    uint64_t slot;
+    TimerWheelNode *node, *next;
+    MissTableEntry *curr_entry;
+
+    node = timer_wheel_advance (&(miss_table->wheel), sub_window_ind);
+    while (node != NULL) {
+        next = node->next;
+        curr_entry = TIMER_WHEEL_ENTRY(node, MissTableEntry, timer);
+        slot = miss_table_slot (miss_table, curr_entry->key);
+
+        if (curr_entry->prev != NULL) {
+            curr_entry->prev->next = curr_entry->next;
+        }
+        if (curr_entry->next != NULL) {
+            curr_entry->next->prev = curr_entry->prev;
+        }
+        if (curr_entry == miss_table->lookup_table[slot]) {
+            miss_table->lookup_table[slot] = curr_entry->next;
+        }
+        miss_table_free_entry (miss_table, curr_entry);
+        miss_table->entry_count -= 1;
+
+        node = next;
+    }
+}
+
 /* Return hits if the entry existed in the miss_table
  * Otherwise, return miss, insert the entry into the
  * miss_table.
  *
- * When the number of entries is larger than the threshold,
- * Start pruning the miss_table.
+ * Entries that fell out of the window are dropped first, as the
+ * sub window advances.
  *
  */
 int miss_table_access (MissTable *miss_table, Request *req)
 {
     int hits       = 0;
     int miss_count = 0;
-    int ind        = 0;
     uint32_t i     = 0;
-    uint32_t lookup_table_slot = req->block_num % miss_table->lookup_table_size;
-    MissTableEntry *entry = miss_table->lookup_table[lookup_table_slot];
-    uint32_t last_sub_window_ind;
-    uint32_t sub_window_ind_diff;
+    BlockKey key   = request_key (req);
+    uint64_t lookup_table_slot = miss_table_slot (miss_table, key);
+    MissTableEntry *entry;
     uint8_t  num_sub_windows = miss_table->num_sub_windows;
 
+    if (req->sub_window_ind != miss_table->wheel.curr_sub_window_ind) {
+        miss_table_expire (miss_table, req->sub_window_ind);
+    }
+    entry = miss_table->lookup_table[lookup_table_slot];
+
     /* try to find a match */
     while (entry != NULL) {
-        if ((entry->block_num == req->block_num) &&
-            (entry->volume_num == req->volume_num) &&
-            (entry->server_num == req->server_num)) {
+        if (entry->key == key) {
             break;
         }
         entry = entry->next;
@@ -58,26 +148,12 @@ int miss_table_access (MissTable *miss_table, Request *req)
 
     if (entry != NULL) {
         /* find a match */
-        last_sub_window_ind = entry->last_access_sub_window_ind;
-        sub_window_ind_diff = req->sub_window_ind - last_sub_window_ind;
-        uint8_t last_sub_window_counter_ind = last_sub_window_ind
-                % num_sub_windows;
         uint8_t curr_sub_window_counter_ind = req->sub_window_ind
                 % num_sub_windows;
 
-        if (sub_window_ind_diff >= num_sub_windows) {
-            for (i = 0; i < num_sub_windows; i++) {
-                entry->counter[i] = 0;
-            }
-        } else if (sub_window_ind_diff != 0) {
-            ind = last_sub_window_counter_ind;
-            ind = (ind + 1) % num_sub_windows;
-            while (ind != curr_sub_window_counter_ind) {
-                entry->counter[ind] = 0;
-                ind = (ind + 1) % num_sub_windows;
-            }
-            entry->counter[ind] = 0;
-        }
+        window_clear_stale (entry->counter, sizeof(entry->counter[0]),
+                entry->last_access_sub_window_ind, req->sub_window_ind,
+                num_sub_windows);
 
         for (i = 0; i < num_sub_windows; i++) {
             miss_count += entry->counter[i];
@@ -91,6 +167,7 @@ int miss_table_access (MissTable *miss_table, Request *req)
             entry->counter[curr_sub_window_counter_ind] += 1;
         }
         entry->last_access_sub_window_ind = req->sub_window_ind;
+        timer_wheel_touch (&(miss_table->wheel), &(entry->timer));
 
 /*        if ((req->block_num == 815716) && (req->server_num == 9)
                 && (req->volume_num == 0)) {
@@ -104,18 +181,16 @@ int miss_table_access (MissTable *miss_table, Request *req)
     } else {
         /* no match found */
         miss_table->num_inserts += 1;
-        MissTableEntry *new_entry = (MissTableEntry *) calloc (1,
-                sizeof(MissTableEntry));
+        MissTableEntry *new_entry = miss_table_alloc_entry (miss_table);
         check(new_entry!=NULL,
                 "failed to allocate MissTableEntry for insertion.");
 
-        new_entry->block_num  = req->block_num;
-        new_entry->server_num = req->server_num;
-        new_entry->volume_num = req->volume_num;
+        new_entry->key = key;
         new_entry->last_access_sub_window_ind = req->sub_window_ind;
         uint8_t curr_sub_window_counter_ind = req->sub_window_ind
                         % num_sub_windows;
         new_entry->counter[curr_sub_window_counter_ind] = 1;
+        timer_wheel_touch (&(miss_table->wheel), &(new_entry->timer));
 
 /*        if ((req->block_num == 815716) && (req->server_num == 9)
                 && (req->volume_num == 0)) {
@@ -132,34 +207,6 @@ int miss_table_access (MissTable *miss_table, Request *req)
         miss_table->lookup_table[lookup_table_slot] = new_entry;
 
         miss_table->entry_count += 1;
-        /* Prune the miss table */
-        MissTableEntry *curr_entry = NULL;
-        MissTableEntry *next_entry = NULL;
-        if (miss_table->entry_count == (miss_table->lookup_table_size << 3)) {
-            for (i = 0; i < miss_table->lookup_table_size; i++) {
-                curr_entry = miss_table->lookup_table[i];
-                while (curr_entry != NULL) {
-                    next_entry = curr_entry->next;
-                    last_sub_window_ind = curr_entry->last_access_sub_window_ind;
-                    sub_window_ind_diff = req->sub_window_ind - last_sub_window_ind;
-                    if (sub_window_ind_diff >= num_sub_windows) {
-                        if (curr_entry->prev != NULL) {
-                            curr_entry->prev->next = next_entry;
-                        }
-                        if (next_entry != NULL) {
-                            next_entry->prev = curr_entry->prev;
-                        }
-                        if (curr_entry == miss_table->lookup_table[i]) {
-                            miss_table->lookup_table[i] = next_entry;
-                        }
-                        free(curr_entry);
-                        miss_table->entry_count -= 1;
-                    }
-                    curr_entry = next_entry;
-                }
-            } // end of loop through miss_table->lookup_table
-            miss_table->num_prunes += 1;
-        } // end of pruning
     } // miss in the miss_table
 
     return hits;
@@ -169,22 +216,33 @@ error:
     return -1;
 }
 
+/* Prefetch the chain heads of requests about to access the table. */
+void miss_table_prefetch_batch (const MissTable *miss_table,
+        const Request *reqs, uint32_t num_reqs)
+{
+    uint32_t i;
+
+    for (i = 0; i < num_reqs; i++) {
+        __builtin_prefetch (&(miss_table->lookup_table[miss_table_slot (
+                        miss_table, request_key (&(reqs[i])))]));
+    }
+}
+
 void miss_table_destroy (MissTable *miss_table)
 {
     uint32_t i;
-    MissTableEntry *curr_entry = NULL;
-    MissTableEntry *next_entry = NULL;
 
     if (miss_table->lookup_table != NULL) {
-        for (i = 0; i < miss_table->lookup_table_size; i++) {
-            curr_entry = miss_table->lookup_table[i];
-            while (curr_entry != NULL) {
-                next_entry = curr_entry->next;
-                free (curr_entry);
-                curr_entry = next_entry;
-            }
+        table_mem_free (miss_table->lookup_table);
+    }
+
+    timer_wheel_destroy (&(miss_table->wheel));
+
+    if (miss_table->slabs != NULL) {
+        for (i = 0; i < miss_table->num_slabs; i++) {
+            free (miss_table->slabs[i]);
         }
-        free (miss_table->lookup_table);
+        free (miss_table->slabs);
     }
 
     free (miss_table);
@@ -1,30 +1,41 @@
 #ifndef MISS_TABLE_H_
 #define MISS_TABLE_H_
 
+#include "common.h"
+#include "timer_wheel.h"
+
+#define MISS_TABLE_SLAB_ENTRIES     4096    // Entries allocated at a time
+
 typedef struct MissTableEntry {
-    uint64_t        block_num;
-    uint8_t         server_num;
-    uint8_t         volume_num;
+    BlockKey        key;
     uint8_t         counter[12];
     uint32_t        last_access_sub_window_ind;
     struct MissTableEntry *prev;
-    struct MissTableEntry *next;
-} MissTableEntry __attribute__((aligned (64)));
+    struct MissTableEntry *next;    // Also links the free list
+    TimerWheelNode  timer;          // Filed under the last access
+} MissTableEntry;
 
 typedef struct MissTable {
     uint64_t         lookup_table_size;
     uint32_t         threshold;
-    uint64_t         entry_count; // threshold for starting pruning
-    uint32_t         num_prunes;
+    uint64_t         entry_count;
     uint8_t          num_sub_windows;
     uint32_t         num_inserts;
     MissTableEntry **lookup_table;
+    TimerWheel       wheel;         // Reclaims entries out of the window
+    /* entries come from slabs and go back to the free list */
+    MissTableEntry **slabs;
+    uint32_t         num_slabs;
+    uint32_t         max_slabs;
+    MissTableEntry  *free_list;
 } MissTable;
 
 
 int  miss_table_init    (uint64_t size, uint32_t threshold,
         uint8_t num_sub_windwos, MissTable *miss_table);
 int  miss_table_access  (MissTable *miss_table, Request *req);
+void miss_table_prefetch_batch (const MissTable *miss_table,
+        const Request *reqs, uint32_t num_reqs);
 void miss_table_destroy (MissTable *miss_table);
 
 #endif
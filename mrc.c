@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "debug.h"
+#include "common.h"
+#include "mrc.h"
+
+static inline void fenwick_add (MissRatioCurve *mrc, uint64_t slot,
+        int32_t delta)
+{
+    uint64_t i;
+
+    for (i = slot + 1; i <= mrc->num_slots; i += (i & -i)) {
+        mrc->fenwick[i] += delta;
+    }
+}
+
+/* The number of marked slots in [0, slot]. */
+static inline uint64_t fenwick_prefix (MissRatioCurve *mrc, uint64_t slot)
+{
+    uint64_t i, sum = 0;
+
+    for (i = slot + 1; i > 0; i -= (i & -i)) {
+        sum += mrc->fenwick[i];
+    }
+
+    return sum;
+}
+
+static inline MrcEntry *mrc_find (MissRatioCurve *mrc, BlockKey key)
+{
+    uint64_t i = hash_u64 (key) & mrc->table_mask;
+
+    while (mrc->table[i].key != MRC_EMPTY_KEY) {
+        if (mrc->table[i].key == key) {
+            return &(mrc->table[i]);
+        }
+        i = (i + 1) & mrc->table_mask;
+    }
+
+    return NULL;
+}
+
+static inline MrcEntry *mrc_insert (MissRatioCurve *mrc, BlockKey key)
+{
+    uint64_t i = hash_u64 (key) & mrc->table_mask;
+
+    while (mrc->table[i].key != MRC_EMPTY_KEY) {
+        i = (i + 1) & mrc->table_mask;
+    }
+    mrc->table[i].key = key;
+
+    return &(mrc->table[i]);
+}
+
+/* Linear probing delete: shift later entries of the run back. */
+static void mrc_remove (MissRatioCurve *mrc, MrcEntry *entry)
+{
+    uint64_t hole = entry - mrc->table;
+    uint64_t i = hole, home;
+
+    while (1) {
+        i = (i + 1) & mrc->table_mask;
+        if (mrc->table[i].key == MRC_EMPTY_KEY) {
+            break;
+        }
+        home = hash_u64 (mrc->table[i].key) & mrc->table_mask;
+        // move i into the hole unless its home lies in (hole, i]
+        if (((i - home) & mrc->table_mask) >= ((i - hole) & mrc->table_mask)) {
+            mrc->table[hole] = mrc->table[i];
+            hole = i;
+        }
+    }
+    mrc->table[hole].key = MRC_EMPTY_KEY;
+}
+
+/*
+ * Renumber the marked slots to 0 .. num_live - 1 keeping their order
+ * and rebuild the Fenwick tree in O(num_slots).
+ */
+static void mrc_compact (MissRatioCurve *mrc)
+{
+    uint64_t i, j, next = 0;
+    MrcEntry *entry;
+
+    for (i = mrc->oldest_slot; i < mrc->next_slot; i++) {
+        if (mrc->slot_keys[i] == MRC_EMPTY_KEY) {
+            continue;
+        }
+        entry = mrc_find (mrc, mrc->slot_keys[i]);
+        entry->slot = next;
+        mrc->slot_keys[next] = mrc->slot_keys[i];
+        next += 1;
+    }
+
+    for (i = next; i < mrc->num_slots; i++) {
+        mrc->slot_keys[i] = MRC_EMPTY_KEY;
+    }
+
+    for (i = 1; i <= mrc->num_slots; i++) {
+        mrc->fenwick[i] = (i <= next);
+    }
+    for (i = 1; i <= mrc->num_slots; i++) {
+        j = i + (i & -i);
+        if (j <= mrc->num_slots) {
+            mrc->fenwick[j] += mrc->fenwick[i];
+        }
+    }
+
+    mrc->oldest_slot = 0;
+    mrc->next_slot = next;
+    mrc->num_compactions += 1;
+}
+
+int mrc_init (uint64_t max_size, MissRatioCurve *mrc)
+{
+    uint64_t i, table_size = 1;
+
+    check (max_size>=1, "the miss ratio curve needs a max size of at least 1.");
+    mrc->max_size = max_size;
+    // half the slots are free after a compaction
+    mrc->num_slots = (max_size << 1) + 1;
+
+    // max_size + 1 keys live for a moment before an eviction
+    while (table_size < ((max_size + 1) << 1)) {
+        table_size <<= 1;
+    }
+    mrc->table_mask = table_size - 1;
+
+    mrc->fenwick = (uint32_t *) calloc (mrc->num_slots + 1, sizeof(uint32_t));
+    check (mrc->fenwick!=NULL, "failed to allocate mrc->fenwick.");
+
+    mrc->slot_keys = (uint64_t *) malloc (mrc->num_slots * sizeof(uint64_t));
+    check (mrc->slot_keys!=NULL, "failed to allocate mrc->slot_keys.");
+    for (i = 0; i < mrc->num_slots; i++) {
+        mrc->slot_keys[i] = MRC_EMPTY_KEY;
+    }
+
+    mrc->table = (MrcEntry *) malloc (table_size * sizeof(MrcEntry));
+    check (mrc->table!=NULL, "failed to allocate mrc->table.");
+    for (i = 0; i < table_size; i++) {
+        mrc->table[i].key = MRC_EMPTY_KEY;
+    }
+
+    mrc->read_hist = (uint64_t *) calloc (max_size + 1, sizeof(uint64_t));
+    check (mrc->read_hist!=NULL, "failed to allocate mrc->read_hist.");
+    mrc->write_hist = (uint64_t *) calloc (max_size + 1, sizeof(uint64_t));
+    check (mrc->write_hist!=NULL, "failed to allocate mrc->write_hist.");
+
+    mrc->next_slot = 0;
+    mrc->oldest_slot = 0;
+    mrc->num_live = 0;
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Record the stack distance of one block access and move the block
+ * to the top of the stack. A demand filled LRU cache of size c hits
+ * exactly the accesses with distance <= c.
+ */
+void mrc_access (MissRatioCurve *mrc, Request *req)
+{
+    BlockKey key = request_key (req);
+    uint64_t distance, victim;
+    MrcEntry *entry;
+
+    entry = mrc_find (mrc, key);
+    if (entry != NULL) {
+        distance = mrc->num_live - fenwick_prefix (mrc, entry->slot) + 1;
+        if (req->req_type == 0) {
+            mrc->read_hist[distance] += 1;
+        } else {
+            mrc->write_hist[distance] += 1;
+        }
+        fenwick_add (mrc, entry->slot, -1);
+        mrc->slot_keys[entry->slot] = MRC_EMPTY_KEY;
+    } else {
+        if (req->req_type == 0) {
+            mrc->read_misses += 1;
+        } else {
+            mrc->write_misses += 1;
+        }
+        entry = mrc_insert (mrc, key);
+        mrc->num_live += 1;
+    }
+
+    if (mrc->next_slot == mrc->num_slots) {
+        // entry has no slot right now, keep it out of the renumbering
+        mrc_compact (mrc);
+    }
+    entry->slot = mrc->next_slot;
+    mrc->slot_keys[entry->slot] = key;
+    fenwick_add (mrc, entry->slot, 1);
+    mrc->next_slot += 1;
+
+    if (mrc->num_live > mrc->max_size) {
+        // the bottom of the stack can no longer hit in any cache size
+        victim = mrc->oldest_slot;
+        while (mrc->slot_keys[victim] == MRC_EMPTY_KEY) {
+            victim += 1;
+        }
+        mrc_remove (mrc, mrc_find(mrc, mrc->slot_keys[victim]));
+        fenwick_add (mrc, victim, -1);
+        mrc->slot_keys[victim] = MRC_EMPTY_KEY;
+        mrc->oldest_slot = victim + 1;
+        mrc->num_live -= 1;
+    }
+}
+
+void mrc_destroy (MissRatioCurve *mrc)
+{
+    if (mrc->fenwick != NULL) {
+        free (mrc->fenwick);
+    }
+
+    if (mrc->slot_keys != NULL) {
+        free (mrc->slot_keys);
+    }
+
+    if (mrc->table != NULL) {
+        free (mrc->table);
+    }
+
+    if (mrc->read_hist != NULL) {
+        free (mrc->read_hist);
+    }
+
+    if (mrc->write_hist != NULL) {
+        free (mrc->write_hist);
+    }
+
+    free (mrc);
+}
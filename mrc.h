@@ -0,0 +1,45 @@
+#ifndef MRC_H_
+#define MRC_H_
+
+#include "common.h"
+
+#define MRC_EMPTY_KEY       UINT64_MAX
+
+/* Last access time slot of a block, open addressing on the block key. */
+typedef struct MrcEntry {
+    BlockKey  key;
+    uint64_t  slot;
+} MrcEntry;
+
+/*
+ * Miss ratio curve of a demand filled LRU cache from Mattson stack
+ * distances. Every block on the (truncated) LRU stack marks the time
+ * slot of its last access in a Fenwick tree, so the stack distance
+ * of a re-access is the number of marked slots after its previous
+ * one. Only the max_size most recent blocks are tracked: anything
+ * deeper misses in every cache size on the curve. Slots are
+ * renumbered in place once they run out, so memory stays O(max_size)
+ * however long the trace is.
+ */
+typedef struct MissRatioCurve {
+    uint64_t   max_size;        // The largest cache size on the curve
+    uint64_t   num_slots;       // Time slots between compactions
+    uint32_t  *fenwick;         // Marked slots, 1-indexed
+    BlockKey  *slot_keys;       // Key last accessed at a slot, or MRC_EMPTY_KEY
+    uint64_t   next_slot;
+    uint64_t   oldest_slot;     // No marked slot below this one
+    uint64_t   num_live;        // Blocks on the stack
+    MrcEntry  *table;
+    uint64_t   table_mask;
+    uint64_t  *read_hist;       // read_hist[d]: reads at stack distance d
+    uint64_t  *write_hist;
+    uint64_t   read_misses;     // Cold misses or deeper than max_size
+    uint64_t   write_misses;
+    uint64_t   num_compactions;
+} MissRatioCurve;
+
+int  mrc_init    (uint64_t max_size, MissRatioCurve *mrc);
+void mrc_access  (MissRatioCurve *mrc, Request *req);
+void mrc_destroy (MissRatioCurve *mrc);
+
+#endif
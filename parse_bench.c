@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "debug.h"
+#include "common.h"
+#include "trace.h"
+
+static double now_seconds (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+
+    return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+/* Parse every line of [buffer, end) with the vectorized parser. */
+static int bench_parser (const char *buffer, const char *end,
+        uint64_t *num_records, uint64_t *checksum)
+{
+    int ret;
+    const char *line, *line_end;
+    TraceRecord record;
+    uint64_t volume;
+
+    for (line = buffer; line < end; line = line_end + 1) {
+        line_end = trace_find_line_end (line, end);
+        ret = trace_parse_line (line, line_end, &record, &volume);
+        check (ret!=-1, "failed to parse trace line %"PRIu64".",
+                *num_records + 1);
+        if (ret == 1) {
+            *num_records += 1;
+            *checksum += record.start_block + record.req_type;
+        }
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/* The fgets/sscanf path the vectorized parser replaced, for reference. */
+static int bench_sscanf (const char *buffer, const char *end,
+        uint64_t *num_records, uint64_t *checksum)
+{
+    int ret;
+    size_t len;
+    const char *line, *line_end;
+    char line_copy[FILE_LINE_SIZE];
+    CSVLineData csv_data;
+
+    for (line = buffer; line < end; line = line_end + 1) {
+        line_end = trace_find_line_end (line, end);
+        len = line_end - line;
+        check (len<sizeof(line_copy), "trace line is too long.");
+        memcpy (line_copy, line, len);
+        line_copy[len] = '\0';
+
+        ret = sscanf(line_copy, "%"SCNu64" %"SCNu32" %"SCNu32" %5s %"SCNu64
+                " %"SCNu32" %"SCNu64"\n", &csv_data.timestamp,
+                &csv_data.server_num, &csv_data.volume_num, csv_data.req_type,
+                &csv_data.start_addr, &csv_data.req_size, &csv_data.duration);
+        check (ret==7, "failed to parse csv line:\n\t%s\n", line_copy);
+        *num_records += 1;
+        *checksum += (csv_data.start_addr >> LOG_2_BLOCK_SIZE)
+            + (strcmp(csv_data.req_type, "Write") == 0);
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Parse-only throughput: the whole text trace is loaded into memory
+ * first so only the conversion to TraceRecord is timed.
+ */
+int main (int argc, char *argv[])
+{
+    int fd = -1, i, iterations = 5, ret;
+    char *buffer = NULL;
+    ssize_t len;
+    size_t size = 0;
+    struct stat st;
+    double start, elapsed, best_parser = 0, best_sscanf = 0;
+    uint64_t num_records, checksum, parser_checksum = 0, sscanf_checksum = 0;
+
+    if ((argc != 2) && (argc != 3)) {
+        printf ("Usage: %s text_trace [iterations]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 3) {
+        iterations = atoi (argv[2]);
+        check (iterations>0, "iterations must be positive.");
+    }
+
+    fd = open (argv[1], O_RDONLY);
+    check (fd!=-1, "failed to open trace file: %s", argv[1]);
+    check (fstat(fd, &st)==0, "failed to stat trace file: %s", argv[1]);
+    buffer = (char *) calloc (1, st.st_size + TRACE_READ_BUFFER_PAD);
+    check (buffer!=NULL, "failed to allocate %lld bytes.",
+            (long long) st.st_size);
+    while (size < st.st_size) {
+        len = read (fd, buffer + size, st.st_size - size);
+        check (len>0, "failed to read trace file: %s", argv[1]);
+        size += len;
+    }
+    close (fd);
+    fd = -1;
+
+    for (i = 0; i < iterations; i++) {
+        num_records = checksum = 0;
+        start = now_seconds ();
+        ret = bench_parser (buffer, buffer + size, &num_records, &checksum);
+        elapsed = now_seconds () - start;
+        check (ret==0, "vectorized parser failed.");
+        if ((best_parser == 0) || (elapsed < best_parser)) {
+            best_parser = elapsed;
+        }
+        parser_checksum = checksum;
+
+        num_records = checksum = 0;
+        start = now_seconds ();
+        ret = bench_sscanf (buffer, buffer + size, &num_records, &checksum);
+        elapsed = now_seconds () - start;
+        check (ret==0, "sscanf parser failed.");
+        if ((best_sscanf == 0) || (elapsed < best_sscanf)) {
+            best_sscanf = elapsed;
+        }
+        sscanf_checksum = checksum;
+    }
+
+    printf ("trace: %s, %zu bytes, %"PRIu64" records, best of %d\n",
+            argv[1], size, num_records, iterations);
+    printf ("vectorized: %.3f s, %.3f GB/s, %.2f Mrecords/s\n", best_parser,
+            size / best_parser / 1e9, num_records / best_parser / 1e6);
+    printf ("sscanf:     %.3f s, %.3f GB/s, %.2f Mrecords/s\n", best_sscanf,
+            size / best_sscanf / 1e9, num_records / best_sscanf / 1e6);
+    if (parser_checksum != sscanf_checksum) {
+        printf ("warning: parsers disagree (checksum %"PRIu64" vs %"PRIu64")\n",
+                parser_checksum, sscanf_checksum);
+    }
+
+    free (buffer);
+
+    return 0;
+
+error:
+
+    if (fd != -1) {
+        close (fd);
+    }
+
+    if (buffer != NULL) {
+        free (buffer);
+    }
+
+    return -1;
+}
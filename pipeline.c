@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "debug.h"
+#include "common.h"
+#include "config_parser.h"
+#include "tier_index.h"
+#include "trace_stream.h"
+#include "simulator.h"
+#include "pipeline.h"
+
+#ifdef BOUNCER_THREADS
+/* The high half of the key hash, the tier index uses the low half. */
+static inline uint32_t pipeline_conflict_slot (const Request *req)
+{
+    return (uint32_t) (hash_u64 (request_key (req)) >> 32)
+        & (PIPELINE_CONFLICT_SLOTS - 1);
+}
+
+/* Make the requests queued on port visible to its consumer. */
+static inline void pipeline_publish (StagePort *port)
+{
+    if (port->tail != port->pos) {
+        port->tail = port->pos;
+        atomic_store_explicit (&port->queue->tail, port->pos,
+                memory_order_release);
+    }
+}
+
+static inline void pipeline_push (StagePort *port, uint64_t seq)
+{
+    port->queue->seqs[port->pos & (PIPELINE_WINDOW - 1)] = seq;
+    port->pos += 1;
+    if (port->pos - port->tail >= PIPELINE_PUBLISH_STEP) {
+        pipeline_publish (port);
+    }
+}
+
+/* Take the next request queued on port. Returns 0 if there is none yet. */
+static inline int pipeline_pop (StagePort *port, uint64_t *seq)
+{
+    if (port->pos == port->tail) {
+        port->tail = atomic_load_explicit (&port->queue->tail,
+                memory_order_acquire);
+        if (port->pos == port->tail) {
+            return 0;
+        }
+    }
+
+    *seq = port->queue->seqs[port->pos & (PIPELINE_WINDOW - 1)];
+    port->pos += 1;
+
+    return 1;
+}
+
+static void *pipeline_stage_run (void *arg)
+{
+    PipelineStage *stage = (PipelineStage *) arg;
+    Pipeline *pipeline = stage->pipeline;
+    PipelineSlot *slot;
+    uint64_t seq;
+
+    while (1) {
+        if (!pipeline_pop (&stage->in, &seq)) {
+            // hand on what there is before waiting for more
+            if (stage->forward != 0) {
+                pipeline_publish (&stage->out);
+            }
+            if (atomic_load_explicit(&pipeline->done, memory_order_acquire)) {
+                break;
+            }
+            sched_yield ();
+            continue;
+        }
+
+        slot = &(pipeline->slots[seq & (PIPELINE_WINDOW - 1)]);
+        stage->resolve (pipeline->sim, &(slot->staged));
+        if (stage->forward & (1U << slot->staged.act)) {
+            pipeline_push (&stage->out, seq);
+        } else {
+            atomic_store_explicit (&slot->resolved, seq + 1,
+                    memory_order_release);
+        }
+    }
+
+    return NULL;
+}
+
+/* Place the oldest request in flight. Returns 0 if it is not resolved yet. */
+static inline int pipeline_retire (Pipeline *pipeline)
+{
+    uint64_t seq = pipeline->retired_seq;
+    PipelineSlot *slot = &(pipeline->slots[seq & (PIPELINE_WINDOW - 1)]);
+
+    if (atomic_load_explicit(&slot->resolved, memory_order_acquire)
+            != seq + 1) {
+        return 0;
+    }
+
+    simulator_stage_place (pipeline->sim, &(slot->staged));
+    pipeline->conflict[pipeline_conflict_slot (&(slot->staged.req))] -= 1;
+    pipeline->retired_seq = seq + 1;
+
+    return 1;
+}
+
+/* Wait until no more than max_in_flight requests are in flight. */
+static void pipeline_drain (Pipeline *pipeline, uint64_t max_in_flight)
+{
+    pipeline_publish (&pipeline->out);
+    while (pipeline->next_seq - pipeline->retired_seq > max_in_flight) {
+        if (!pipeline_retire (pipeline)) {
+            sched_yield ();
+        }
+    }
+}
+
+/*
+ * A block in a tier may be moved or evicted by the requests in flight
+ * and a block in flight may be placed, so either waits for them. Any
+ * other block misses every tier whatever they do, and a miss changes
+ * nothing but the counters until it is placed.
+ */
+static void pipeline_access (Pipeline *pipeline, const Request *req)
+{
+    Simulator *sim = pipeline->sim;
+    uint32_t conflict = pipeline_conflict_slot (req);
+    PipelineSlot *slot;
+
+    if ((pipeline->next_seq != pipeline->retired_seq)
+            && ((pipeline->conflict[conflict] > 0)
+                || (tier_index_find (sim->tier_index, request_key (req))
+                    != TIER_INDEX_NIL))) {
+        pipeline_drain (pipeline, 0);
+    }
+
+    if (pipeline->next_seq - pipeline->retired_seq == PIPELINE_WINDOW) {
+        pipeline_drain (pipeline, PIPELINE_WINDOW - 1);
+    }
+
+    sim->tot_reqs += 1;
+    slot = &(pipeline->slots[pipeline->next_seq & (PIPELINE_WINDOW - 1)]);
+    slot->staged.req = *req;
+    simulator_stage_tiers (sim, &(slot->staged));
+    if (slot->staged.act == SIM_ACT_NONE) {
+        return;
+    }
+
+    pipeline_push (&pipeline->out, pipeline->next_seq);
+    pipeline->conflict[conflict] += 1;
+    pipeline->next_seq += 1;
+}
+
+/* pipeline_access over reqs, with the tier index prefetched ahead. */
+static void pipeline_access_batch (Pipeline *pipeline, const Request *reqs,
+        uint32_t num_reqs)
+{
+    TierIndex *index = pipeline->sim->tier_index;
+    uint32_t i, end, next_end;
+
+    end = (num_reqs < SIM_PREFETCH_GROUP) ? num_reqs : SIM_PREFETCH_GROUP;
+    tier_index_prefetch_batch (index, reqs, end);
+
+    for (i = 0; i < num_reqs; ) {
+        next_end = (num_reqs - end < SIM_PREFETCH_GROUP)
+                 ? num_reqs : (end + SIM_PREFETCH_GROUP);
+        tier_index_prefetch_batch (index, &(reqs[end]), next_end - end);
+
+        for (; i < end; i++) {
+            pipeline_access (pipeline, &(reqs[i]));
+        }
+        end = next_end;
+    }
+}
+
+/* Stop the stage threads and free the pipeline, not its simulator. */
+static void pipeline_destroy (Pipeline *pipeline)
+{
+    uint32_t i;
+
+    atomic_store (&pipeline->done, 1);
+    for (i = 0; i < PIPELINE_NUM_STAGES; i++) {
+        if (pipeline->stages[i].started) {
+            pthread_join (pipeline->stages[i].thread, NULL);
+        }
+    }
+
+    for (i = 0; i < PIPELINE_NUM_STAGES; i++) {
+        if (pipeline->queues[i].seqs != NULL) {
+            free (pipeline->queues[i].seqs);
+        }
+    }
+    if (pipeline->slots != NULL) {
+        free (pipeline->slots);
+    }
+    free (pipeline);
+}
+
+static Pipeline *pipeline_init (Simulator *sim)
+{
+    static void (* const resolve[PIPELINE_NUM_STAGES]) (Simulator *,
+            StagedRequest *) = { simulator_stage_filter,
+                                 simulator_stage_table,
+                                 simulator_stage_ghost };
+    // ghost cache hits pass through the filters to keep their order
+    static const uint32_t forward[PIPELINE_NUM_STAGES] = {
+        (1U << SIM_ACT_TABLE) | (1U << SIM_ACT_GHOST_HIT),
+        (1U << SIM_ACT_GHOST_NEW) | (1U << SIM_ACT_GHOST_HIT),
+        0 };
+    int ret;
+    uint32_t i;
+    Pipeline *pipeline;
+
+    pipeline = (Pipeline *) calloc (1, sizeof(Pipeline));
+    check (pipeline!=NULL, "failed to allocate pipeline.");
+    pipeline->sim = sim;
+    atomic_init (&pipeline->done, 0);
+
+    pipeline->slots = (PipelineSlot *) calloc (PIPELINE_WINDOW,
+            sizeof(PipelineSlot));
+    check (pipeline->slots!=NULL, "failed to allocate pipeline slots.");
+    for (i = 0; i < PIPELINE_WINDOW; i++) {
+        atomic_init (&pipeline->slots[i].resolved, 0);
+    }
+
+    for (i = 0; i < PIPELINE_NUM_STAGES; i++) {
+        atomic_init (&pipeline->queues[i].tail, 0);
+        pipeline->queues[i].seqs = (uint64_t *) calloc (PIPELINE_WINDOW,
+                sizeof(uint64_t));
+        check (pipeline->queues[i].seqs!=NULL,
+                "failed to allocate pipeline queue.");
+    }
+
+    // queues[i] feeds stage i
+    pipeline->out.queue = &(pipeline->queues[0]);
+    for (i = 0; i < PIPELINE_NUM_STAGES; i++) {
+        pipeline->stages[i].pipeline = pipeline;
+        pipeline->stages[i].resolve = resolve[i];
+        pipeline->stages[i].forward = forward[i];
+        pipeline->stages[i].in.queue = &(pipeline->queues[i]);
+        if (forward[i] != 0) {
+            pipeline->stages[i].out.queue = &(pipeline->queues[i + 1]);
+        }
+    }
+
+    for (i = 0; i < PIPELINE_NUM_STAGES; i++) {
+        ret = pthread_create (&pipeline->stages[i].thread, NULL,
+                pipeline_stage_run, &pipeline->stages[i]);
+        check (ret==0, "failed to start pipeline stage %"PRIu32".", i);
+        pipeline->stages[i].started = 1;
+    }
+
+    return pipeline;
+
+error:
+
+    if (pipeline != NULL) {
+        pipeline_destroy (pipeline);
+    }
+
+    return NULL;
+}
+
+/* simulator_run of a single simulator through a pipeline. */
+static int pipeline_run_trace (Simulator *sim, char *trace_file,
+        uint32_t num_parser_threads)
+{
+    int ret;
+    uint64_t tot_reqs = 0, next_progress = SIM_PROGRESS_STEP;
+    int progress = 10;
+    struct timeval start, end;
+    TraceStream *trace_stream = NULL;
+    Pipeline *pipeline = NULL;
+    RequestBatch *batch;
+
+    gettimeofday (&start, NULL);
+
+    trace_stream = (TraceStream *) calloc (1, sizeof(TraceStream));
+    check (trace_stream!=NULL, "failed to allocate trace_stream.");
+    ret = trace_stream_open (trace_file, num_parser_threads, trace_stream);
+    check (ret==0, "failed to open trace file:%s\n", trace_file);
+    // the ghost cache stage logs by raw volume
+    sim->volume_dict = trace_stream->reader->volumes;
+
+    pipeline = pipeline_init (sim);
+    check (pipeline!=NULL, "failed to start pipeline.");
+
+    while ((ret = trace_stream_next(trace_stream, &batch)) == 1) {
+        pipeline_access_batch (pipeline, batch->reqs, batch->num_reqs);
+
+        tot_reqs += batch->num_reqs;
+        while (tot_reqs >= next_progress) {
+            printf("%d%% is done.\n", progress);
+            progress += 10;
+            next_progress += SIM_PROGRESS_STEP;
+        }
+    }
+    check (ret==0, "failed to read trace file:%s\n", trace_file);
+
+    pipeline_drain (pipeline, 0);
+    pipeline_destroy (pipeline);
+    pipeline = NULL;
+
+    gettimeofday (&end, NULL);
+    sim->start = start;
+    sim->end = end;
+    sim->volume_dict = NULL;    // goes with the stream
+
+    trace_stream_destroy (trace_stream);
+
+    return 0;
+
+error:
+
+    if (pipeline != NULL) {
+        pipeline_destroy (pipeline);
+    }
+    sim->volume_dict = NULL;
+    if (trace_stream != NULL) {
+        trace_stream_destroy (trace_stream);
+    }
+
+    return -1;
+}
+#endif
+
+/*
+ * Simulate a sieved + traditional wb configuration with the tiers,
+ * miss filter, miss table and ghost cache each on a thread of their
+ * own, and write its result file.
+ */
+int pipeline_run (ConfigInfo *config_info)
+{
+    int ret;
+    Simulator *sim = NULL;
+
+    check (config_info->test_type==SIM_SIEVED_PLUS_TRADITIONAL_WB,
+            "only sieved + traditional write buffers can be pipelined.");
+    check (config_info->sample_rate>=1.0,
+            "sampled simulations cannot be pipelined.");
+
+    sim = (Simulator *) calloc (1, sizeof(Simulator));
+    check (sim!=NULL, "failed to allocate simulator.");
+    ret = simulator_init (config_info, sim);
+    check (ret==0, "failed to initialize simulator for %s.",
+            config_info->result_file);
+
+#ifdef BOUNCER_THREADS
+    ret = pipeline_run_trace (sim, config_info->trace_file,
+            config_info->num_parser_threads);
+#else
+    log_info ("built without pthreads, simulating the stages inline.");
+    ret = simulator_run (config_info->trace_file,
+            config_info->num_parser_threads, &sim, 1, 0);
+#endif
+    check (ret==0, "failed to run pipelined simulation.");
+
+    simulator_report (sim);
+    simulator_destroy (sim);
+
+    return 0;
+
+error:
+
+    if (sim != NULL) {
+        simulator_destroy (sim);
+    }
+
+    return -1;
+}
@@ -0,0 +1,88 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <stdatomic.h>
+#ifdef BOUNCER_THREADS
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "config_parser.h"
+#include "simulator.h"
+
+#define PIPELINE_NUM_STAGES         3       // Miss filter, miss table, ghost cache
+#define PIPELINE_WINDOW             1024    // Requests in flight, power of 2
+#define PIPELINE_PUBLISH_STEP       32      // Requests queued per publish
+#define PIPELINE_CONFLICT_SLOTS     4096    // Power of 2
+
+/*
+ * Lock-free single producer single consumer queue of the sequence
+ * numbers of requests in flight, PIPELINE_WINDOW long. Only tail is
+ * shared: at most PIPELINE_WINDOW requests are in flight and they
+ * retire in order, so a slot has always been consumed by the time its
+ * producer comes around to it again.
+ */
+typedef struct StageQueue {
+    _Atomic uint64_t  tail;
+    char              tail_pad[56];
+    uint64_t         *seqs;
+} StageQueue;
+
+/* One end of a StageQueue, private to the thread using it. */
+typedef struct StagePort {
+    StageQueue  *queue;
+    uint64_t     pos;           // Next slot to fill or take
+    uint64_t     tail;          // Producer: published, consumer: last seen
+} StagePort;
+
+/* A request in flight, resolved is set once no stage is left for it. */
+typedef struct PipelineSlot {
+    StagedRequest     staged;
+    _Atomic uint64_t  resolved;     // Sequence number + 1
+} PipelineSlot;
+
+struct Pipeline;
+
+/*
+ * A thread resolving its part of the requests queued on in. Requests
+ * whose act is in forward go on to out, the rest are resolved.
+ */
+typedef struct PipelineStage {
+    struct Pipeline *pipeline;
+    void           (*resolve) (Simulator *sim, StagedRequest *staged);
+    uint32_t         forward;       // 1 << act
+    StagePort        in;
+    StagePort        out;
+#ifdef BOUNCER_THREADS
+    pthread_t        thread;
+    uint8_t          started;
+#endif
+} PipelineStage;
+
+/*
+ * A sieved + traditional wb simulator split over threads by stage.
+ * The thread reading the trace looks every request up in the tiers
+ * and hands the ones it cannot resolve to the miss filter thread,
+ * each stage passes on in trace order what it cannot resolve to the
+ * miss table and then the ghost cache thread, and the tier stage
+ * places the resolved requests in trace order. Lookups run ahead of
+ * the requests in flight only for blocks that are in no tier and not
+ * in flight themselves, which miss whatever those requests do, so the
+ * results are the same as simulator_access.
+ */
+typedef struct Pipeline {
+    Simulator       *sim;
+    PipelineSlot    *slots;         // By sequence number
+    StageQueue       queues[PIPELINE_NUM_STAGES];
+    PipelineStage    stages[PIPELINE_NUM_STAGES];
+    _Atomic int      done;          // Nothing is in flight any more
+    /* tier stage */
+    StagePort        out;           // To the miss filter
+    uint64_t         next_seq;
+    uint64_t         retired_seq;   // Oldest in flight
+    uint16_t         conflict[PIPELINE_CONFLICT_SLOTS]; // In flight by key hash
+} Pipeline;
+
+int pipeline_run (ConfigInfo *config_info);
+
+#endif
@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "debug.h"
+#include "common.h"
+#include "config_parser.h"
+#include "trace_stream.h"
+#include "simulator.h"
+#include "shard.h"
+
+/*
+ * The low half of the key hash picks the shard, spatial sampling
+ * already uses the high half and the lowest bits.
+ */
+static inline uint32_t shard_of (const Request *req, uint32_t num_shards)
+{
+    return (uint32_t) (((hash_u64 (request_key (req)) & UINT32_MAX)
+                * num_shards) >> 32);
+}
+
+static inline uint64_t shard_size (uint64_t size, uint32_t num_shards)
+{
+    return (size + num_shards - 1) / num_shards;
+}
+
+/* Write name.suffix to buffer, which is FILE_LINE_SIZE. */
+static int shard_file_name (char *buffer, const char *name, const char *suffix)
+{
+    int len = snprintf (buffer, FILE_LINE_SIZE, "%s.%s", name, suffix);
+
+    return ((len > 0) && (len < FILE_LINE_SIZE)) ? 0 : -1;
+}
+
+#ifdef BOUNCER_THREADS
+static void *shard_worker_run (void *arg)
+{
+    int ret, done;
+    Shard *shard = (Shard *) arg;
+    ShardRun *run = shard->run;
+    BatchRing *ring = &(shard->ring);
+    RequestBatch *batch;
+    uint64_t head = 0;
+
+    while (!atomic_load_explicit(&run->failed, memory_order_relaxed)) {
+        // every batch is queued before done is set
+        done = atomic_load_explicit (&run->done, memory_order_acquire);
+        if (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+            if (done) {
+                break;
+            }
+            sched_yield ();
+            continue;
+        }
+
+        batch = &(ring->batches[head & (TRACE_STREAM_RING_SIZE - 1)]);
+        ret = simulator_access_batch (shard->sim, batch->reqs, batch->num_reqs);
+        check (ret==0, "shard %"PRIu32" failed to simulate a batch.",
+                shard->index);
+        head += 1;
+        atomic_store_explicit (&ring->head, head, memory_order_release);
+    }
+
+    return NULL;
+
+error:
+
+    atomic_store (&run->failed, 1);
+
+    return NULL;
+}
+#endif
+
+/* Hand the pending batch of shard to its simulator. */
+static int shard_publish (ShardRun *run, Shard *shard)
+{
+    int ret;
+    BatchRing *ring = &(shard->ring);
+    uint64_t tail = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+
+    if (run->inline_sims) {
+        ret = simulator_access_batch (shard->sim, shard->pending->reqs,
+                shard->pending->num_reqs);
+        check (ret==0, "shard %"PRIu32" failed to simulate a batch.",
+                shard->index);
+        atomic_store_explicit (&ring->head, tail + 1, memory_order_relaxed);
+    }
+    atomic_store_explicit (&ring->tail, tail + 1, memory_order_release);
+    shard->pending = NULL;
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/* Queue req on its shard, waiting for a free batch if the ring is full. */
+static inline int shard_dispatch (ShardRun *run, const Request *req)
+{
+    Shard *shard = &(run->shards[shard_of (req, run->num_shards)]);
+    BatchRing *ring = &(shard->ring);
+    uint64_t tail;
+
+    if (shard->pending == NULL) {
+        tail = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+        while (tail - atomic_load_explicit(&ring->head, memory_order_acquire)
+                == TRACE_STREAM_RING_SIZE) {
+            check (!atomic_load_explicit(&run->failed, memory_order_relaxed),
+                    "a shard failed.");
+            sched_yield ();
+        }
+        shard->pending = &(ring->batches[tail & (TRACE_STREAM_RING_SIZE - 1)]);
+        shard->pending->num_reqs = 0;
+    }
+
+    shard->pending->reqs[shard->pending->num_reqs] = *req;
+    shard->pending->num_reqs += 1;
+    if (shard->pending->num_reqs == TRACE_STREAM_BATCH_SIZE) {
+        return shard_publish (run, shard);
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/* Stop the shard threads and free everything but the simulators. */
+static void shard_run_destroy (ShardRun *run)
+{
+    uint32_t i;
+
+    if (run->shards == NULL) {
+        free (run);
+        return;
+    }
+
+    atomic_store (&run->done, 1);
+#ifdef BOUNCER_THREADS
+    for (i = 0; i < run->num_shards; i++) {
+        if (run->shards[i].started) {
+            pthread_join (run->shards[i].thread, NULL);
+            run->shards[i].started = 0;
+        }
+    }
+#endif
+
+    for (i = 0; i < run->num_shards; i++) {
+        if (run->shards[i].ring.batches != NULL) {
+            free (run->shards[i].ring.batches);
+        }
+    }
+    free (run->shards);
+    free (run);
+}
+
+/*
+ * Parse the trace once and route every request to the shard of its
+ * block. Returns with all batches simulated and the threads joined,
+ * which a failure joins as well before the stream goes away.
+ */
+static int shard_run_trace (ShardRun *run, ConfigInfo *config_info)
+{
+    int ret;
+    uint32_t i;
+    uint64_t tot_reqs = 0, next_progress = SIM_PROGRESS_STEP;
+    int progress = 10;
+    struct timeval start, end;
+    TraceStream *trace_stream = NULL;
+    RequestBatch *batch;
+
+    trace_stream = (TraceStream *) calloc (1, sizeof(TraceStream));
+    check (trace_stream!=NULL, "failed to allocate trace_stream.");
+    ret = trace_stream_open (config_info->trace_file,
+            config_info->num_parser_threads, trace_stream);
+    check (ret==0, "failed to open trace file:%s\n", config_info->trace_file);
+    for (i = 0; i < run->num_shards; i++) {
+        run->shards[i].sim->volume_dict = trace_stream->reader->volumes;
+    }
+
+    gettimeofday (&start, NULL);
+
+#ifdef BOUNCER_THREADS
+    for (i = 0; i < run->num_shards; i++) {
+        ret = pthread_create (&run->shards[i].thread, NULL, shard_worker_run,
+                &run->shards[i]);
+        check (ret==0, "failed to start shard %"PRIu32".", i);
+        run->shards[i].started = 1;
+    }
+#endif
+
+    while ((ret = trace_stream_next(trace_stream, &batch)) == 1) {
+        for (i = 0; i < batch->num_reqs; i++) {
+            ret = shard_dispatch (run, &(batch->reqs[i]));
+            check (ret==0, "failed to dispatch request.");
+        }
+
+        tot_reqs += batch->num_reqs;
+        while (tot_reqs >= next_progress) {
+            printf("%d%% is done.\n", progress);
+            progress += 10;
+            next_progress += SIM_PROGRESS_STEP;
+        }
+    }
+    check (ret==0, "failed to read trace file:%s\n", config_info->trace_file);
+
+    for (i = 0; i < run->num_shards; i++) {
+        if (run->shards[i].pending != NULL) {
+            ret = shard_publish (run, &(run->shards[i]));
+            check (ret==0, "failed to dispatch request.");
+        }
+    }
+
+    atomic_store (&run->done, 1);
+#ifdef BOUNCER_THREADS
+    for (i = 0; i < run->num_shards; i++) {
+        pthread_join (run->shards[i].thread, NULL);
+        run->shards[i].started = 0;
+    }
+#endif
+    check (!atomic_load(&run->failed), "a shard failed.");
+
+    gettimeofday (&end, NULL);
+    for (i = 0; i < run->num_shards; i++) {
+        run->shards[i].sim->start = start;
+        run->shards[i].sim->end = end;
+        run->shards[i].sim->volume_dict = NULL;    // goes with the stream
+    }
+
+    trace_stream_destroy (trace_stream);
+
+    return 0;
+
+error:
+
+    atomic_store (&run->failed, 1);
+    atomic_store (&run->done, 1);
+    // the shards may still be simulating, with volume_dict in the stream
+#ifdef BOUNCER_THREADS
+    for (i = 0; i < run->num_shards; i++) {
+        if (run->shards[i].started) {
+            pthread_join (run->shards[i].thread, NULL);
+            run->shards[i].started = 0;
+        }
+    }
+#endif
+    for (i = 0; i < run->num_shards; i++) {
+        run->shards[i].sim->volume_dict = NULL;
+    }
+    if (trace_stream != NULL) {
+        trace_stream_destroy (trace_stream);
+    }
+
+    return -1;
+}
+
+/*
+ * Simulate config_info unsharded over the same trace, into result and
+ * debug files of its own, for reference.
+ */
+static Simulator *shard_reference (ConfigInfo *config_info)
+{
+    int ret;
+    ConfigInfo config = *config_info;
+    Simulator *sim = NULL;
+
+    ret = shard_file_name (config.result_file, config_info->result_file,
+            "unsharded");
+    check (ret==0, "result file name is too long.");
+    if (config_info->debug_file[0] != '\0') {
+        ret = shard_file_name (config.debug_file, config_info->debug_file,
+                "unsharded");
+        check (ret==0, "debug file name is too long.");
+    }
+
+    sim = (Simulator *) calloc (1, sizeof(Simulator));
+    check (sim!=NULL, "failed to allocate simulator.");
+    ret = simulator_init (&config, sim);
+    check (ret==0, "failed to initialize simulator for %s.", config.result_file);
+
+    ret = simulator_run (config.trace_file, config.num_parser_threads, &sim, 1,
+            0);
+    check (ret==0, "failed to run simulation.");
+    simulator_report (sim);
+
+    return sim;
+
+error:
+
+    if (sim != NULL) {
+        simulator_destroy (sim);
+    }
+
+    return NULL;
+}
+
+/*
+ * Simulate config_info split over num_shards threads and write the
+ * merged statistics to its result file. Each shard gets debug file
+ * of its own. With validate set the configuration is simulated again
+ * unsharded and the deviation of the merged hit ratios is reported.
+ * Sharding is not exact: besides the split sizes, the block_num % size
+ * slots of a direct mapped miss filter no longer pool the misses of a
+ * block number on volumes that went to other shards.
+ */
+int shard_run (ConfigInfo *config_info, uint32_t num_shards, uint8_t validate)
+{
+    int ret;
+    uint32_t i;
+    char suffix[32];
+    ConfigInfo config;
+    ShardRun *run = NULL;
+    Simulator *merged = NULL, *reference = NULL;
+
+    check (config_info->test_type!=SIM_MRC,
+            "the miss ratio curve cannot be sharded.");
+    check ((num_shards>=1) && (num_shards<=SHARD_MAX_SHARDS),
+            "invalid number of shards: %"PRIu32"", num_shards);
+
+    run = (ShardRun *) calloc (1, sizeof(ShardRun));
+    check (run!=NULL, "failed to allocate shard run.");
+    run->num_shards = num_shards;
+#ifndef BOUNCER_THREADS
+    log_info ("built without pthreads, simulating the shards inline.");
+    run->inline_sims = 1;
+#endif
+    atomic_init (&run->done, 0);
+    atomic_init (&run->failed, 0);
+
+    run->shards = (Shard *) calloc (num_shards, sizeof(Shard));
+    check (run->shards!=NULL, "failed to allocate shards.");
+
+    for (i = 0; i < num_shards; i++) {
+        config = *config_info;
+        config.traditional_wb_size = shard_size (config.traditional_wb_size,
+                num_shards);
+        config.sieved_wb_size = shard_size (config.sieved_wb_size, num_shards);
+        config.sieved_ghost_cache_size = shard_size (
+                config.sieved_ghost_cache_size, num_shards);
+        config.miss_filter_size = shard_size (config.miss_filter_size,
+                num_shards);
+        config.miss_table_lookup_size = shard_size (
+                config.miss_table_lookup_size, num_shards);
+        config.ssd_size = shard_size (config.ssd_size, num_shards);
+        // the first shard reports for all of them
+        if (i > 0) {
+            config.result_file[0] = '\0';
+        }
+        if (config_info->debug_file[0] != '\0') {
+            snprintf (suffix, sizeof(suffix), "shard%"PRIu32"", i);
+            ret = shard_file_name (config.debug_file, config_info->debug_file,
+                    suffix);
+            check (ret==0, "debug file name is too long.");
+        }
+
+        run->shards[i].run = run;
+        run->shards[i].index = i;
+        atomic_init (&run->shards[i].ring.head, 0);
+        atomic_init (&run->shards[i].ring.tail, 0);
+        run->shards[i].ring.batches = (RequestBatch *) calloc (
+                TRACE_STREAM_RING_SIZE, sizeof(RequestBatch));
+        check (run->shards[i].ring.batches!=NULL,
+                "failed to allocate shard ring.");
+
+        run->shards[i].sim = (Simulator *) calloc (1, sizeof(Simulator));
+        check (run->shards[i].sim!=NULL, "failed to allocate simulator.");
+        ret = simulator_init (&config, run->shards[i].sim);
+        check (ret==0, "failed to initialize shard %"PRIu32" of %s.", i,
+                config_info->result_file);
+    }
+
+    ret = shard_run_trace (run, config_info);
+    check (ret==0, "failed to run sharded simulation.");
+
+    merged = run->shards[0].sim;
+    for (i = 1; i < num_shards; i++) {
+        simulator_merge (merged, run->shards[i].sim);
+        simulator_destroy (run->shards[i].sim);
+        run->shards[i].sim = NULL;
+    }
+
+    if (validate) {
+        reference = shard_reference (config_info);
+        check (reference!=NULL, "failed to run unsharded reference.");
+    }
+
+    simulator_report (merged);
+    if (reference != NULL) {
+        simulator_report_deviation (merged, reference);
+        simulator_destroy (reference);
+    }
+
+    simulator_destroy (merged);
+    run->shards[0].sim = NULL;
+    shard_run_destroy (run);
+
+    return 0;
+
+error:
+
+    if (run != NULL) {
+        if (run->shards != NULL) {
+            for (i = 0; i < num_shards; i++) {
+                if (run->shards[i].sim != NULL) {
+                    simulator_destroy (run->shards[i].sim);
+                }
+            }
+        }
+        shard_run_destroy (run);
+    }
+
+    return -1;
+}
@@ -0,0 +1,52 @@
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include <stdatomic.h>
+#ifdef BOUNCER_THREADS
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "config_parser.h"
+#include "trace_stream.h"
+#include "simulator.h"
+
+#define SHARD_MAX_SHARDS            64
+
+struct ShardRun;
+
+/*
+ * One slice of the key space with its own simulator. The dispatcher
+ * fills pending and queues it on ring, the shard's thread simulates
+ * the batches in the order they were queued.
+ */
+typedef struct Shard {
+    struct ShardRun *run;
+    uint32_t         index;
+    Simulator       *sim;
+    BatchRing        ring;
+    RequestBatch    *pending;       // Slot of ring being filled, or NULL
+#ifdef BOUNCER_THREADS
+    pthread_t        thread;
+    uint8_t          started;
+#endif
+} Shard;
+
+/*
+ * A configuration split by block key hash over num_shards simulators,
+ * each with a 1/num_shards slice of every cache, filter and table.
+ * A block always goes to the same shard and every shard sees its
+ * blocks in trace order, so the shards only differ from the unsharded
+ * simulator in how capacity is divided between blocks.
+ */
+typedef struct ShardRun {
+    uint32_t          num_shards;
+    Shard            *shards;
+    uint8_t           inline_sims;  // No threads, simulate batches as queued
+    _Atomic int       done;         // Every batch has been queued
+    _Atomic int       failed;
+} ShardRun;
+
+int shard_run (ConfigInfo *config_info, uint32_t num_shards, uint8_t validate);
+
+#endif
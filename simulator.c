@@ -0,0 +1,1512 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "debug.h"
+#include "common.h"
+#include "config_parser.h"
+#include "lru_cache.h"
+#include "miss_filter.h"
+#include "miss_table.h"
+#include "ghost_cache.h"
+#include "tier_index.h"
+#include "table_mem.h"
+#include "mrc.h"
+#include "trace_stream.h"
+#include "simulator.h"
+
+static int sieve_store_base_access (Simulator *sim, Request *request)
+{
+    int ret;
+    Request req = *request, replaced_req;
+    MissFilter *miss_filter = sim->miss_filter;
+    MissTable  *miss_table  = sim->miss_table;
+    LRUCache   *ssd_cache   = sim->ssd_cache;
+
+    ret = lru_cache_lookup(ssd_cache, &req);
+    if (ret == 0) {
+        /*miss in ssd_cache, check miss_filter*/
+        ret = miss_filter_lookup(miss_filter, &req);
+        if (ret == 1) {
+            /*hits in miss_filter, check miss_table*/
+            ret = miss_table_access(miss_table, &req);
+            /*hits in miss_table, insert it to ssd_cache*/
+            if (ret == 1) {
+                lru_cache_insert(ssd_cache, req.block_num,
+                        req.volume_id, &replaced_req);
+            } // hits in miss_table
+        } // hits in miss_filter
+    } // miss in ssd_cache
+
+    return 0;
+}
+
+static void sieve_store_base_report (Simulator *sim)
+{
+    LRUCache *ssd_cache = sim->ssd_cache;
+    FILE     *out_fp    = sim->out_fp;
+    uint64_t tot_reqs = sim->tot_reqs;
+    struct timeval start = sim->start, end = sim->end;
+
+    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", ssd_cache->read_lookups);
+    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", ssd_cache->write_lookups);
+    fprintf(out_fp, "total number of requests: %"PRIu64"\n", tot_reqs);
+    long duration = (end.tv_sec - start.tv_sec) * 1000000
+               + (end.tv_usec - start.tv_usec);
+    fprintf(out_fp, "time consumed = %.4f (min)\n",
+               (double) duration / (1000000.0 * 60.0));
+
+    fprintf(out_fp, "\n\n");
+    fprintf(out_fp, "read hits       :  %"PRIu64"\n", ssd_cache->read_hits);
+    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", ssd_cache->read_lookups);
+    fprintf(out_fp, "read hits ratio :  %.4f\n",
+            (double) ssd_cache->read_hits / (double) ssd_cache->read_lookups);
+    fprintf(out_fp, "write hits      :  %"PRIu64"\n", ssd_cache->write_hits);
+    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", ssd_cache->write_lookups);
+    fprintf(out_fp, "write hits ratio:  %.4f\n",
+            (double) ssd_cache->write_hits / (double) ssd_cache->write_lookups);
+    fprintf(out_fp, "tot_hits_ratio  :  %.4f\n",
+            (double) (ssd_cache->write_hits + ssd_cache->read_hits)
+                    / (double) (ssd_cache->write_lookups
+                            + ssd_cache->read_lookups));
+
+    fprintf(out_fp, "ssd cache writes :  %"PRIu64"\n", ssd_cache->num_writes);
+    fprintf(out_fp, "ssd cache replacements: %"PRIu64"\n", ssd_cache->num_replaces);
+}
+
+/*
+ * Write back a block replaced in a write buffer to the ssd cache,
+ * refreshing it if the ssd cache already holds it.
+ */
+static void ssd_write_back (LRUCache *ssd_cache, Request *replaced_req)
+{
+    Request req;
+    LRUCacheHandle handle = lru_cache_peek_handle (ssd_cache, replaced_req);
+
+    if (handle != LRU_CACHE_NIL) {
+        lru_cache_update_handle (ssd_cache, handle);
+    } else {
+        lru_cache_insert (ssd_cache, replaced_req->block_num,
+                replaced_req->volume_id, &req);
+    }
+}
+
+static int traditional_wb_access (Simulator *sim, Request *request)
+{
+    int ret;
+    Request req = *request, replaced_req;
+    LRUCacheHandle handle;
+    LRUCache   *write_buffer = sim->tr_wb;
+    MissFilter *miss_filter  = sim->miss_filter;
+    MissTable  *miss_table   = sim->miss_table;
+    LRUCache   *ssd_cache    = sim->ssd_cache;
+
+    if (req.req_type == 0) {
+        // read request
+        sim->tot_reads += 1;
+        ret = lru_cache_read_lookup(write_buffer, &req);
+        if (ret == 1) {
+            return 0;
+        } else {
+            ret = lru_cache_lookup(ssd_cache, &req);
+        }
+        if (ret == 0) {
+            ret = miss_filter_lookup(miss_filter, &req);
+            if (ret == 1) {
+                /*hits in miss_filter, check miss_table*/
+                ret = miss_table_access(miss_table, &req);
+                /*hits in miss_table, insert it to ssd_cache*/
+                if (ret == 1) {
+                    lru_cache_insert(ssd_cache, req.block_num,
+                            req.volume_id, &replaced_req);
+                } // hits in miss_table
+            } // hits in miss_filter
+        }
+    } else {
+        // write request
+        sim->tot_writes += 1;
+        ret = lru_cache_lookup(write_buffer, &req);
+        if (ret == 0) {
+            handle = lru_cache_peek_handle(ssd_cache, &req);
+            if (handle == LRU_CACHE_NIL) {
+                // miss in ssd_cache
+                ret = miss_filter_lookup(miss_filter, &req);
+                if (ret == 1) {
+                    /*hits in miss_filter, check miss_table*/
+                    ret = miss_table_access(miss_table, &req);
+                    /*hits in miss_table, insert it to ssd_cache*/
+                    if (ret == 1) {
+
+                        ret = lru_cache_insert(write_buffer,
+                                req.block_num, req.volume_id, &replaced_req);
+                        if (ret == 1) {
+                            ssd_write_back (ssd_cache, &replaced_req);
+                        } // write buffer has a replaced entry
+                    } // hits in miss_table
+                } // hits in miss_filter
+            } else {
+                // hits in ssd_cache
+                ret = lru_cache_move (ssd_cache, handle, write_buffer,
+                        &replaced_req);
+                if (ret == 1) {
+                    ssd_write_back (ssd_cache, &replaced_req);
+                } // write buffer has a replaced entry
+            } // hits in ssd cache
+        } // miss in write buffer
+    } // write request
+
+    return 0;
+}
+
+static void traditional_wb_report (Simulator *sim)
+{
+    LRUCache *write_buffer = sim->tr_wb;
+    LRUCache *ssd_cache    = sim->ssd_cache;
+    FILE     *out_fp       = sim->out_fp;
+    uint64_t tot_reqs = sim->tot_reqs;
+    uint64_t tot_reads = sim->tot_reads;
+    uint64_t tot_writes = sim->tot_writes;
+    struct timeval start = sim->start, end = sim->end;
+
+    fprintf(out_fp, "total number of requests: %"PRIu64"\n", tot_reqs);
+    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", tot_reads);
+    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", tot_writes);
+    long duration = (end.tv_sec - start.tv_sec) * 1000000
+                + (end.tv_usec - start.tv_usec);
+    fprintf(out_fp, "time consumed = %.4f (min)\n",
+                (double) duration / (1000000.0 * 60.0));
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "write buffer: \n");
+
+    fprintf(out_fp, "wb size         :  %"PRIu64"\n", write_buffer->cache_size);
+    fprintf(out_fp, "read hits       :  %"PRIu64"\n", write_buffer->read_hits);
+    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", write_buffer->read_lookups);
+    fprintf(out_fp, "read hits ratio :  %.4f\n",
+          (double) write_buffer->read_hits/(double) write_buffer->read_lookups);
+    fprintf(out_fp, "write hits      :  %"PRIu64"\n", write_buffer->write_hits);
+    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", write_buffer->write_lookups);
+    fprintf(out_fp, "write hits ratio:  %.4f\n",
+          (double) write_buffer->write_hits/(double) write_buffer->write_lookups);
+    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", write_buffer->num_writes);
+    fprintf(out_fp, "num updates     :  %"PRIu64"\n", write_buffer->num_updates);
+    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", write_buffer->num_replaces);
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "ssd cache: \n");
+
+    fprintf(out_fp, "ssd cache size  :  %"PRIu64"\n", ssd_cache->cache_size);
+    fprintf(out_fp, "read hits       :  %"PRIu64"\n", ssd_cache->read_hits);
+    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", ssd_cache->read_lookups);
+    fprintf(out_fp, "read hits ratio :  %.4f\n",
+          (double) ssd_cache->read_hits/(double) ssd_cache->read_lookups);
+    fprintf(out_fp, "write hits      :  %"PRIu64"\n", ssd_cache->write_hits);
+    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", ssd_cache->write_lookups);
+    fprintf(out_fp, "write hits ratio:  %.4f\n",
+          (double) ssd_cache->write_hits/(double) ssd_cache->write_lookups);
+    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", ssd_cache->num_writes);
+    fprintf(out_fp, "num removes     :  %"PRIu64"\n", ssd_cache->num_removes);
+    fprintf(out_fp, "num updates     :  %"PRIu64"\n", ssd_cache->num_updates);
+    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", ssd_cache->num_replaces);
+}
+
+static int sieved_wb_access (Simulator *sim, Request *request)
+{
+    int ret;
+    Request req = *request, replaced_req;
+    LRUCacheHandle handle;
+    LRUCache   *write_buffer   = sim->s_wb;
+    MissFilter *miss_filter    = sim->miss_filter;
+    MissTable  *miss_table     = sim->miss_table;
+    GhostCache *wb_ghost_cache = sim->wb_ghost_cache;
+    LRUCache   *ssd_cache      = sim->ssd_cache;
+
+    if (req.req_type == 0) {
+        // read request
+        sim->tot_reads += 1;
+        ret = lru_cache_read_lookup(write_buffer, &req);
+        if (ret == 0) {
+            ret = lru_cache_lookup(ssd_cache, &req);
+        }
+        if (ret == 0) {
+            ret = miss_filter_lookup(miss_filter, &req);
+            if (ret == 1) {
+                /*hits in miss_filter, check miss_table*/
+                ret = miss_table_access(miss_table, &req);
+                /*hits in miss_table, insert it to ssd_cache*/
+                if (ret == 1) {
+                    lru_cache_insert(ssd_cache, req.block_num,
+                            req.volume_id, &replaced_req);
+                } // hits in miss_table
+            } // hits in miss_filter
+        }
+    } else {
+        // write request
+        sim->tot_writes += 1;
+        ret = lru_cache_lookup(write_buffer, &req);
+        if (ret == 0) {
+            handle = lru_cache_peek_handle(ssd_cache, &req);
+            if (handle == LRU_CACHE_NIL) {
+                // miss in ssd_cache
+                ret = miss_filter_lookup(miss_filter, &req);
+                if (ret == 1) {
+                    /*hits in miss_filter, check miss_table*/
+                    ret = miss_table_access(miss_table, &req);
+                    /*hits in miss_table, insert it to ssd_cache*/
+                    if (ret == 1) {
+                        ret = ghost_cache_access (wb_ghost_cache, &req);
+                        if (ret == 0) {
+                            // allocate to ssd
+                            lru_cache_insert(ssd_cache, req.block_num,
+                                    req.volume_id, &replaced_req);
+                        } else {
+                            // allocate to wb
+                            ret = lru_cache_insert(write_buffer,
+                                    req.block_num, req.volume_id, &replaced_req);
+                            if (ret == 1) {
+                                ssd_write_back (ssd_cache, &replaced_req);
+                            } // write buffer has a replaced entry
+                        } // allocate to wb
+                    } // hits in miss_table
+                } // hits in miss_filter
+            } else {
+                // hits in ssd_cache
+                ret = ghost_cache_access (wb_ghost_cache, &req);
+                if (ret == 1) {
+                    ret = lru_cache_move (ssd_cache, handle, write_buffer,
+                            &replaced_req);
+                    if (ret == 1) {
+                        ssd_write_back (ssd_cache, &replaced_req);
+                    } // write buffer has a replaced entry
+                } else {
+                    // cannot make into the write buffer
+                    // write to ssd instead.
+                    lru_cache_access_handle (ssd_cache, handle, &req);
+                }
+            }
+        }
+    } // write request
+
+    return 0;
+}
+
+static void sieved_wb_report (Simulator *sim)
+{
+    LRUCache   *write_buffer   = sim->s_wb;
+    MissFilter *miss_filter    = sim->miss_filter;
+    MissTable  *miss_table     = sim->miss_table;
+    GhostCache *wb_ghost_cache = sim->wb_ghost_cache;
+    LRUCache   *ssd_cache      = sim->ssd_cache;
+    FILE       *out_fp         = sim->out_fp;
+    uint64_t tot_reqs = sim->tot_reqs;
+    uint64_t tot_reads = sim->tot_reads;
+    uint64_t tot_writes = sim->tot_writes;
+    struct timeval start = sim->start, end = sim->end;
+
+    fprintf(out_fp, "total number of requests: %"PRIu64"\n", tot_reqs);
+    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", tot_reads);
+    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", tot_writes);
+    long duration = (end.tv_sec - start.tv_sec) * 1000000
+                + (end.tv_usec - start.tv_usec);
+    fprintf(out_fp, "time consumed = %.4f (min)\n",
+                (double) duration / (1000000.0 * 60.0));
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "sieved write buffer: \n");
+    fprintf(out_fp, "sieved_wb_size  :  %"PRIu64"\n", write_buffer->cache_size);
+    fprintf(out_fp, "read hits       :  %"PRIu64"\n", write_buffer->read_hits);
+    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", write_buffer->read_lookups);
+    fprintf(out_fp, "read hits ratio :  %.4f\n",
+          (double) write_buffer->read_hits/(double) write_buffer->read_lookups);
+    fprintf(out_fp, "write hits      :  %"PRIu64"\n", write_buffer->write_hits);
+    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", write_buffer->write_lookups);
+    fprintf(out_fp, "write hits ratio:  %.4f\n",
+          (double) write_buffer->write_hits/(double) write_buffer->write_lookups);
+    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", write_buffer->num_writes);
+    fprintf(out_fp, "num updates     :  %"PRIu64"\n", write_buffer->num_updates);
+    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", write_buffer->num_replaces);
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "ssd cache: \n");
+
+    fprintf(out_fp, "ssd cache size: %"PRIu64":\n", ssd_cache->cache_size);
+    fprintf(out_fp, "ssd cache miss filter threshold: %"PRIu32"\n",
+            miss_filter->threshold);
+    fprintf(out_fp, "ssd cache miss table threshold: %"PRIu32"\n",
+            miss_table->threshold);
+    fprintf(out_fp, "num sub windows: %"PRIu8"\n", miss_filter->num_sub_windows);
+    fprintf(out_fp, "read hits       :  %"PRIu64"\n", ssd_cache->read_hits);
+    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", ssd_cache->read_lookups);
+    fprintf(out_fp, "read hits ratio :  %.4f\n",
+          (double) ssd_cache->read_hits/(double) ssd_cache->read_lookups);
+    fprintf(out_fp, "write hits      :  %"PRIu64"\n", ssd_cache->write_hits);
+    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", ssd_cache->write_lookups);
+    fprintf(out_fp, "write hits ratio:  %.4f\n",
+          (double) ssd_cache->write_hits/(double) ssd_cache->write_lookups);
+    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", ssd_cache->num_writes);
+    fprintf(out_fp, "num removes     :  %"PRIu64"\n", ssd_cache->num_removes);
+    fprintf(out_fp, "num updates     :  %"PRIu64"\n", ssd_cache->num_updates);
+    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", ssd_cache->num_replaces);
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "ghost cache: \n");
+
+    fprintf (out_fp, "ghost cache size: %"PRIu64"\n", wb_ghost_cache->cache_size);
+    fprintf (out_fp, "ghost cache threshold: %"PRIu32"\n", wb_ghost_cache->threshold);
+    fprintf (out_fp, "ghost cache num_sub_windows: %"PRIu8"\n",
+            wb_ghost_cache->num_sub_windows);
+    fprintf (out_fp, "num_inserts    :  %"PRIu32"\n", wb_ghost_cache->num_inserts);
+    fprintf (out_fp, "num_replaces    : %"PRIu32"\n", wb_ghost_cache->num_replaces);
+    if (wb_ghost_cache->slots != NULL) {
+        fprintf (out_fp, "compact slots   : %"PRIu64", %"PRIu8" bits per counter\n",
+                (wb_ghost_cache->bucket_mask + 1) * GHOST_CACHE_BUCKET_SLOTS
+                        * sim->num_shards,
+                wb_ghost_cache->counter_bits);
+    }
+}
+
+/*
+ * Put the detached record at the head of the first of tiers. Each block
+ * replaced on the way moves to the head of the next tier, and the one
+ * replaced in the last tier is dropped.
+ */
+static void tier_place (TierIndex *index, uint32_t record, const uint8_t *tiers)
+{
+    while ((record != TIER_INDEX_NIL) && (*tiers != TIER_NONE)) {
+        record = tier_index_insert (index, record, *tiers);
+        tiers += 1;
+    }
+
+    if (record != TIER_INDEX_NIL) {
+        tier_index_drop (index, record);
+    }
+}
+
+/* Log a write allocated to the sieved write buffer, by raw volume. */
+static void debug_write_allocation (Simulator *sim, const Request *req)
+{
+    fprintf(sim->debug_fp, "%"PRIu64" %"PRIu64" %"PRIu32" %"PRIu32"\n",
+        req->timestamp, req->block_num,
+        volume_dict_server_num (sim->volume_dict, req->volume_id),
+        volume_dict_volume_num (sim->volume_dict, req->volume_id));
+}
+
+/*
+ * A block is in at most one of s_wb, tr_wb and ssd_cache, so a single
+ * probe of the tier index answers every lookup of the request, and
+ * promotions and evictions move blocks between tiers without probing
+ * again. Only reads and writes that miss every tier and writes that
+ * hit tr_wb or ssd_cache are left for the later stages.
+ */
+void simulator_stage_tiers (Simulator *sim, StagedRequest *staged)
+{
+    LRUCache   *s_wb      = sim->s_wb;
+    LRUCache   *tr_wb     = sim->tr_wb;
+    LRUCache   *ssd_cache = sim->ssd_cache;
+    TierIndex  *index     = sim->tier_index;
+    uint32_t    record    = tier_index_find (index, request_key (&(staged->req)));
+    uint8_t     tier      = (record != TIER_INDEX_NIL)
+                          ? index->record[record].tier : TIER_NONE;
+
+    staged->record = record;
+    staged->tier = tier;
+    staged->act = SIM_ACT_NONE;
+
+    if (staged->req.req_type == 0) {
+        // read request
+        sim->tot_reads += 1;
+        lru_cache_count (s_wb, 0, tier == TIER_S_WB);
+        if (tier == TIER_S_WB) {
+            return;
+        }
+        lru_cache_count (tr_wb, 0, tier == TIER_TR_WB);
+        if (tier == TIER_TR_WB) {
+            return;
+        }
+        lru_cache_count (ssd_cache, 0, tier == TIER_SSD);
+        if (tier == TIER_SSD) {
+            tier_index_touch (index, record);
+            return;
+        }
+        staged->act = SIM_ACT_FILTER;
+    } else {
+        // write request
+        sim->tot_writes += 1;
+        lru_cache_count (s_wb, 1, tier == TIER_S_WB);
+        if (tier == TIER_S_WB) {
+            tier_index_touch (index, record);
+        } else if ((tier == TIER_TR_WB) || (tier == TIER_SSD)) {
+            staged->act = SIM_ACT_GHOST_HIT;
+        } else {
+            // miss in ssd_cache
+            staged->act = SIM_ACT_FILTER;
+        }
+    }
+}
+
+void simulator_stage_filter (Simulator *sim, StagedRequest *staged)
+{
+    if (staged->act != SIM_ACT_FILTER) {
+        return;
+    }
+
+    if (miss_filter_lookup (sim->miss_filter, &(staged->req)) == 1) {
+        /*hits in miss_filter, check miss_table*/
+        staged->act = SIM_ACT_TABLE;
+    } else {
+        staged->act = SIM_ACT_NONE;
+    }
+}
+
+void simulator_stage_table (Simulator *sim, StagedRequest *staged)
+{
+    if (staged->act != SIM_ACT_TABLE) {
+        return;
+    }
+
+    if (miss_table_access (sim->miss_table, &(staged->req)) == 0) {
+        staged->act = SIM_ACT_NONE;
+    } else if (staged->req.req_type == 0) {
+        /*hits in miss_table, insert it to ssd_cache*/
+        staged->act = SIM_ACT_TO_SSD;
+    } else {
+        staged->act = SIM_ACT_GHOST_NEW;
+    }
+}
+
+void simulator_stage_ghost (Simulator *sim, StagedRequest *staged)
+{
+    int ret;
+
+    if (staged->act == SIM_ACT_GHOST_NEW) {
+        ret = ghost_cache_access (sim->wb_ghost_cache, &(staged->req));
+        if (ret == 0) {
+            // allocate to tr_wb
+            staged->act = SIM_ACT_TO_TR_WB;
+        } else {
+            // allocate to wb
+            debug_write_allocation (sim, &(staged->req));
+            staged->act = SIM_ACT_TO_S_WB;
+        }
+    } else if (staged->act == SIM_ACT_GHOST_HIT) {
+        ret = ghost_cache_access (sim->wb_ghost_cache, &(staged->req));
+        if (ret == 1) {
+            debug_write_allocation (sim, &(staged->req));
+            staged->act = SIM_ACT_PROMOTE;
+        } else {
+            // cannot make into the write buffer
+            // write to ssd instead.
+            staged->act = SIM_ACT_KEEP;
+        }
+    }
+}
+
+/* Carry out the placement the earlier stages settled on. */
+void simulator_stage_place (Simulator *sim, StagedRequest *staged)
+{
+    static const uint8_t to_ssd[]       = { TIER_SSD, TIER_NONE };
+    static const uint8_t to_tr_wb[]     = { TIER_TR_WB, TIER_SSD, TIER_NONE };
+    static const uint8_t to_s_wb[]      = { TIER_S_WB, TIER_TR_WB, TIER_SSD,
+                                            TIER_NONE };
+    static const uint8_t ssd_to_s_wb[]  = { TIER_S_WB, TIER_SSD, TIER_NONE };
+    TierIndex *index = sim->tier_index;
+
+    switch (staged->act) {
+    case SIM_ACT_TO_SSD:
+        tier_place (index, tier_index_add (index, request_key (&(staged->req))),
+                to_ssd);
+        break;
+    case SIM_ACT_TO_TR_WB:
+        tier_place (index, tier_index_add (index, request_key (&(staged->req))),
+                to_tr_wb);
+        break;
+    case SIM_ACT_TO_S_WB:
+        tier_place (index, tier_index_add (index, request_key (&(staged->req))),
+                to_s_wb);
+        break;
+    case SIM_ACT_PROMOTE:
+        tier_index_detach (index, staged->record);
+        tier_place (index, staged->record,
+                (staged->tier == TIER_TR_WB) ? to_s_wb : ssd_to_s_wb);
+        break;
+    case SIM_ACT_KEEP:
+        lru_cache_count ((staged->tier == TIER_TR_WB)
+                ? sim->tr_wb : sim->ssd_cache, 1, 1);
+        tier_index_touch (index, staged->record);
+        break;
+    default:
+        break;
+    }
+}
+
+static int sieved_plus_traditional_wb_access (Simulator *sim, Request *request)
+{
+    StagedRequest staged;
+
+    staged.req = *request;
+    simulator_stage_tiers (sim, &staged);
+    if (staged.act != SIM_ACT_NONE) {
+        simulator_stage_filter (sim, &staged);
+        simulator_stage_table (sim, &staged);
+        simulator_stage_ghost (sim, &staged);
+        simulator_stage_place (sim, &staged);
+    }
+
+    return 0;
+}
+
+static void sieved_plus_traditional_wb_report (Simulator *sim)
+{
+    LRUCache   *s_wb           = sim->s_wb;
+    LRUCache   *tr_wb          = sim->tr_wb;
+    MissFilter *miss_filter    = sim->miss_filter;
+    MissTable  *miss_table     = sim->miss_table;
+    GhostCache *wb_ghost_cache = sim->wb_ghost_cache;
+    LRUCache   *ssd_cache      = sim->ssd_cache;
+    FILE       *out_fp         = sim->out_fp;
+    uint64_t tot_reqs = sim->tot_reqs;
+    uint64_t tot_reads = sim->tot_reads;
+    uint64_t tot_writes = sim->tot_writes;
+    struct timeval start = sim->start, end = sim->end;
+
+    fprintf(out_fp, "total number of requests: %"PRIu64"\n", tot_reqs);
+    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", tot_reads);
+    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", tot_writes);
+    long duration = (end.tv_sec - start.tv_sec) * 1000000
+                + (end.tv_usec - start.tv_usec);
+    fprintf(out_fp, "time consumed = %.4f (min)\n",
+                (double) duration / (1000000.0 * 60.0));
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "sieved write buffer: \n");
+    fprintf(out_fp, "sieved_wb_size  :  %"PRIu64"\n", s_wb->cache_size);
+    fprintf(out_fp, "read hits       :  %"PRIu64"\n", s_wb->read_hits);
+    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", s_wb->read_lookups);
+    fprintf(out_fp, "read hits ratio :  %.4f\n",
+          (double) s_wb->read_hits/(double) s_wb->read_lookups);
+    fprintf(out_fp, "write hits      :  %"PRIu64"\n", s_wb->write_hits);
+    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", s_wb->write_lookups);
+    fprintf(out_fp, "write hits ratio:  %.4f\n",
+          (double) s_wb->write_hits/(double) s_wb->write_lookups);
+    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", s_wb->num_writes);
+    fprintf(out_fp, "num updates     :  %"PRIu64"\n", s_wb->num_updates);
+    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", s_wb->num_replaces);
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "traditional write buffer: \n");
+    fprintf(out_fp, "sieved_wb_size  :  %"PRIu64"\n", tr_wb->cache_size);
+    fprintf(out_fp, "read hits       :  %"PRIu64"\n", tr_wb->read_hits);
+    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", tr_wb->read_lookups);
+    fprintf(out_fp, "read hits ratio :  %.4f\n",
+            (double) tr_wb->read_hits / (double) tr_wb->read_lookups);
+    fprintf(out_fp, "write hits      :  %"PRIu64"\n", tr_wb->write_hits);
+    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", tr_wb->write_lookups);
+    fprintf(out_fp, "write hits ratio:  %.4f\n",
+            (double) tr_wb->write_hits / (double) tr_wb->write_lookups);
+    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", tr_wb->num_writes);
+    fprintf(out_fp, "num removes     :  %"PRIu64"\n", tr_wb->num_removes);
+    fprintf(out_fp, "num updates     :  %"PRIu64"\n", tr_wb->num_updates);
+    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", tr_wb->num_replaces);
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "ssd cache: \n");
+
+    fprintf(out_fp, "ssd cache size: %"PRIu64":\n", ssd_cache->cache_size);
+    fprintf(out_fp, "ssd cache miss filter threshold: %"PRIu32"\n",
+            miss_filter->threshold);
+    fprintf(out_fp, "ssd cache miss table threshold: %"PRIu32"\n",
+            miss_table->threshold);
+    fprintf(out_fp, "num sub windows: %"PRIu8"\n", miss_filter->num_sub_windows);
+    fprintf(out_fp, "read hits       :  %"PRIu64"\n", ssd_cache->read_hits);
+    fprintf(out_fp, "read lookups    :  %"PRIu64"\n", ssd_cache->read_lookups);
+    fprintf(out_fp, "read hits ratio :  %.4f\n",
+          (double) ssd_cache->read_hits/(double) ssd_cache->read_lookups);
+    fprintf(out_fp, "write hits      :  %"PRIu64"\n", ssd_cache->write_hits);
+    fprintf(out_fp, "write lookups   :  %"PRIu64"\n", ssd_cache->write_lookups);
+    fprintf(out_fp, "write hits ratio:  %.4f\n",
+          (double) ssd_cache->write_hits/(double) ssd_cache->write_lookups);
+    fprintf(out_fp, "num inserts     :  %"PRIu64"\n", ssd_cache->num_writes);
+    fprintf(out_fp, "num removes     :  %"PRIu64"\n", ssd_cache->num_removes);
+    fprintf(out_fp, "num updates     :  %"PRIu64"\n", ssd_cache->num_updates);
+    fprintf(out_fp, "num replaces    :  %"PRIu64"\n", ssd_cache->num_replaces);
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "ghost cache: \n");
+
+    fprintf (out_fp, "ghost cache size: %"PRIu64"\n", wb_ghost_cache->cache_size);
+    fprintf (out_fp, "ghost cache threshold: %"PRIu32"\n", wb_ghost_cache->threshold);
+    fprintf (out_fp, "ghost cache num_sub_windows: %"PRIu8"\n",
+            wb_ghost_cache->num_sub_windows);
+    fprintf (out_fp, "num_inserts    :  %"PRIu32"\n", wb_ghost_cache->num_inserts);
+    fprintf (out_fp, "num_replaces    : %"PRIu32"\n", wb_ghost_cache->num_replaces);
+    if (wb_ghost_cache->slots != NULL) {
+        fprintf (out_fp, "compact slots   : %"PRIu64", %"PRIu8" bits per counter\n",
+                (wb_ghost_cache->bucket_mask + 1) * GHOST_CACHE_BUCKET_SLOTS
+                        * sim->num_shards,
+                wb_ghost_cache->counter_bits);
+    }
+}
+
+static int mrc_sim_access (Simulator *sim, Request *req)
+{
+    if (req->req_type == 0) {
+        sim->tot_reads += 1;
+    } else {
+        sim->tot_writes += 1;
+    }
+    mrc_access (sim->mrc, req);
+
+    return 0;
+}
+
+/*
+ * One line per point, cache sizes evenly spaced up to max_size:
+ *   size_in_blocks size_in_gib read_hit_ratio write_hit_ratio hit_ratio
+ */
+static void mrc_sim_report (Simulator *sim)
+{
+    MissRatioCurve *mrc = sim->mrc;
+    FILE     *out_fp = sim->out_fp;
+    uint32_t  num_points = sim->config_info.mrc_points;
+    uint64_t  tot_reads = sim->tot_reads;
+    uint64_t  tot_writes = sim->tot_writes;
+    uint64_t  read_hits = 0, write_hits = 0, size, full_size, d = 1;
+    uint32_t  i;
+    struct timeval start = sim->start, end = sim->end;
+
+    fprintf(out_fp, "total number of requests: %"PRIu64"\n", sim->tot_reqs);
+    fprintf(out_fp, "total number of reads:    %"PRIu64"\n", tot_reads);
+    fprintf(out_fp, "total number of writes:   %"PRIu64"\n", tot_writes);
+    long duration = (end.tv_sec - start.tv_sec) * 1000000
+                + (end.tv_usec - start.tv_usec);
+    fprintf(out_fp, "time consumed = %.4f (min)\n",
+                (double) duration / (1000000.0 * 60.0));
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "lru miss ratio curve: \n");
+    fprintf(out_fp, "max cache size  :  %"PRIu64"\n", mrc->max_size);
+    fprintf(out_fp, "read misses     :  %"PRIu64"\n", mrc->read_misses);
+    fprintf(out_fp, "write misses    :  %"PRIu64"\n", mrc->write_misses);
+    fprintf(out_fp, "compactions     :  %"PRIu64"\n", mrc->num_compactions);
+    fprintf(out_fp, "# size_blocks size_gib read_hit_ratio "
+            "write_hit_ratio hit_ratio\n");
+
+    for (i = 1; i <= num_points; i++) {
+        size = mrc->max_size * i / num_points;
+        for (; d <= size; d++) {
+            read_hits += mrc->read_hist[d];
+            write_hits += mrc->write_hist[d];
+        }
+        // a sampled curve stands for a cache 1 / sample_rate as large
+        full_size = (uint64_t) ((double) size / sim->config_info.sample_rate);
+        fprintf(out_fp, "%"PRIu64" %.4f %.4f %.4f %.4f\n", full_size,
+                (double) (full_size << 12) / (double) (1ULL << 30),
+                (double) read_hits / (double) tot_reads,
+                (double) write_hits / (double) tot_writes,
+                (double) (read_hits + write_hits)
+                        / (double) (tot_reads + tot_writes));
+    }
+}
+
+static inline uint64_t sample_scale (uint64_t size, double rate)
+{
+    uint64_t scaled = (uint64_t) ((double) size * rate + 0.5);
+
+    return (scaled > 0) ? scaled : 1;
+}
+
+/*
+ * The hits and lookups behind the reported ssd cache hit ratios, for
+ * the miss ratio curve the hits at its largest size.
+ */
+static void sample_counters (Simulator *sim, uint64_t hits[2],
+        uint64_t lookups[2])
+{
+    if (sim->mrc != NULL) {
+        hits[0] = sim->tot_reads - sim->mrc->read_misses;
+        hits[1] = sim->tot_writes - sim->mrc->write_misses;
+        lookups[0] = sim->tot_reads;
+        lookups[1] = sim->tot_writes;
+    } else {
+        hits[0] = sim->ssd_cache->read_hits;
+        hits[1] = sim->ssd_cache->write_hits;
+        lookups[0] = sim->ssd_cache->read_lookups;
+        lookups[1] = sim->ssd_cache->write_lookups;
+    }
+}
+
+/*
+ * The hash groups are independent spatial samples of their own, so
+ * the spread of their hit ratios gives the standard error of the
+ * combined one. It only measures that spread: what the scaled down
+ * cache, filter and table do differently from the full sized ones
+ * biases every group alike and is not part of it. A direct mapped
+ * miss filter adds to that bias, its block_num % size slots are
+ * shared by other blocks in the sample than in a full run.
+ */
+static void sample_report_ratio (Simulator *sim, int type, const char *name)
+{
+    uint64_t hits = 0, lookups = 0;
+    double ratio, diff, var = 0.0;
+    uint32_t g;
+
+    for (g = 0; g < SIM_SAMPLE_GROUPS; g++) {
+        hits += sim->sample_hits[g][type];
+        lookups += sim->sample_lookups[g][type];
+    }
+    if (lookups == 0) {
+        fprintf(sim->out_fp, "%s:  no samples\n", name);
+        return;
+    }
+
+    ratio = (double) hits / (double) lookups;
+    for (g = 0; g < SIM_SAMPLE_GROUPS; g++) {
+        diff = (double) sim->sample_hits[g][type]
+                - ratio * (double) sim->sample_lookups[g][type];
+        var += diff * diff;
+    }
+    var = var * SIM_SAMPLE_GROUPS / (SIM_SAMPLE_GROUPS - 1)
+            / ((double) lookups * (double) lookups);
+
+    fprintf(sim->out_fp, "%s:  %.4f +- %.4f\n", name, ratio, sqrt(var));
+}
+
+static void sample_report (Simulator *sim)
+{
+    FILE *out_fp = sim->out_fp;
+    double rate = sim->config_info.sample_rate;
+
+    fprintf(out_fp, "\n");
+    fprintf(out_fp, "spatial sampling: \n");
+    fprintf(out_fp, "sample rate     :  %.6f\n", rate);
+    fprintf(out_fp, "sampled blocks  :  %"PRIu64" of about %.0f\n",
+            sim->tot_reqs, (double) sim->tot_reqs / rate);
+    fprintf(out_fp, "cache, filter and table sizes above are scaled by "
+            "the sample rate.\nhit ratios carry one standard error across "
+            "the hash groups only,\nnot the bias of the scaled down sizes "
+            "or of the direct mapped miss\nfilter slots, which sampled "
+            "blocks share differently than a full run\n");
+    sample_report_ratio (sim, 0, "read hits ratio ");
+    sample_report_ratio (sim, 1, "write hits ratio");
+}
+
+static void report_cache_memory (const char *name, LRUCache *cache)
+{
+    uint64_t bytes = lru_cache_bytes (cache);
+
+    printf("%s: %"PRIu64" blocks, %.1f MiB, %.1f bytes per block\n", name,
+            cache->cache_size, (double) bytes / (double) (1 << 20),
+            (double) bytes / (double) cache->cache_size);
+}
+
+int simulator_init (ConfigInfo *config_info, Simulator *sim)
+{
+    int ret;
+    LRUCache *tiers[TIER_COUNT];
+    uint8_t test_type = config_info->test_type;
+
+    sim->config_info = *config_info;
+    config_info = &(sim->config_info);
+    sim->num_shards = 1;
+    check (test_type<=SIM_MRC,
+            "unknown test type: %"PRIu8"", test_type);
+
+    check ((config_info->sample_rate>0.0) && (config_info->sample_rate<=1.0),
+            "invalid sample rate: %f", config_info->sample_rate);
+    if (config_info->sample_rate < 1.0) {
+        sim->sample_threshold = (uint64_t) (config_info->sample_rate
+                                            * 18446744073709551616.0);
+        if (sim->sample_threshold == 0) {
+            sim->sample_threshold = 1;
+        }
+        config_info->traditional_wb_size = sample_scale (
+                config_info->traditional_wb_size, config_info->sample_rate);
+        config_info->sieved_wb_size = sample_scale (
+                config_info->sieved_wb_size, config_info->sample_rate);
+        config_info->sieved_ghost_cache_size = sample_scale (
+                config_info->sieved_ghost_cache_size, config_info->sample_rate);
+        config_info->miss_filter_size = sample_scale (
+                config_info->miss_filter_size, config_info->sample_rate);
+        config_info->miss_table_lookup_size = sample_scale (
+                config_info->miss_table_lookup_size, config_info->sample_rate);
+        config_info->ssd_size = sample_scale (
+                config_info->ssd_size, config_info->sample_rate);
+    }
+
+    // shards that are only merged into another have no result file
+    if (config_info->result_file[0] != '\0') {
+        sim->out_fp = fopen (config_info->result_file, "w");
+        check (sim->out_fp!=NULL, "failed to open result file: %s.",
+                config_info->result_file);
+    }
+
+    if (test_type == SIM_SIEVED_PLUS_TRADITIONAL_WB) {
+        sim->debug_fp = fopen (config_info->debug_file, "w");
+        check (sim->debug_fp!=NULL, "failed to open debug file: %s.",
+                config_info->debug_file);
+    }
+
+    if ((test_type == SIM_SIEVED_WB)
+            || (test_type == SIM_SIEVED_PLUS_TRADITIONAL_WB)) {
+        sim->s_wb = (LRUCache *) calloc (1, sizeof(LRUCache));
+        check (sim->s_wb!=NULL, "failed to allocate s_wb.");
+        ret = (test_type == SIM_SIEVED_PLUS_TRADITIONAL_WB)
+            ? lru_cache_init_unindexed (config_info->sieved_wb_size, sim->s_wb)
+            : lru_cache_init (config_info->sieved_wb_size, sim->s_wb);
+        check (ret!=-1, "failed to initialize s_wb.");
+    }
+
+    if ((test_type == SIM_TRADITIONAL_WB)
+            || (test_type == SIM_SIEVED_PLUS_TRADITIONAL_WB)) {
+        sim->tr_wb = (LRUCache *) calloc (1, sizeof(LRUCache));
+        check (sim->tr_wb!=NULL, "failed to allocate tr_wb.");
+        ret = (test_type == SIM_SIEVED_PLUS_TRADITIONAL_WB)
+            ? lru_cache_init_unindexed (config_info->traditional_wb_size,
+                    sim->tr_wb)
+            : lru_cache_init (config_info->traditional_wb_size, sim->tr_wb);
+        check (ret!=-1, "failed to initialize tr_wb.");
+    }
+
+    if (test_type == SIM_MRC) {
+        check (config_info->mrc_points>=1,
+                "the miss ratio curve needs at least one point.");
+        sim->mrc = (MissRatioCurve *) calloc (1, sizeof(MissRatioCurve));
+        check (sim->mrc!=NULL, "failed to allocate mrc.");
+        ret = mrc_init (config_info->ssd_size, sim->mrc);
+        check (ret!=-1, "failed to initialize mrc.");
+
+        return 0;
+    }
+
+    sim->miss_filter = (MissFilter *) calloc (1, sizeof(MissFilter));
+    check (sim->miss_filter!=NULL, "failed to allocate miss_filter.");
+    ret = miss_filter_init (config_info->miss_filter_size,
+            config_info->miss_filter_threshold, config_info->num_sub_windows,
+            config_info->miss_filter_hashes, sim->miss_filter);
+    check (ret!=-1, "failed to initialize miss_filter.");
+
+    sim->miss_table = (MissTable *) calloc (1, sizeof(MissTable));
+    check (sim->miss_table!=NULL, "failed to allocate miss_table.");
+    ret = miss_table_init (config_info->miss_table_lookup_size,
+            config_info->miss_table_threshold, config_info->num_sub_windows,
+            sim->miss_table);
+    check (ret!=-1, "failed to initialize miss_table.");
+
+    if ((test_type == SIM_SIEVED_WB)
+            || (test_type == SIM_SIEVED_PLUS_TRADITIONAL_WB)) {
+        sim->wb_ghost_cache = (GhostCache *) calloc (1, sizeof(GhostCache));
+        check (sim->wb_ghost_cache!=NULL, "failed to allocate wb_ghost_cache.");
+        ret = ghost_cache_init (config_info->sieved_ghost_cache_size,
+                config_info->sieved_wb_threshold,
+                config_info->num_sub_windows, config_info->ghost_cache_compact,
+                sim->wb_ghost_cache);
+        check (ret!=-1, "failed to initialize wb_ghost_cache.");
+    }
+
+    sim->ssd_cache = (LRUCache *) calloc (1, sizeof(LRUCache));
+    check (sim->ssd_cache!=NULL, "failed to allocate ssd_cache.");
+    if (test_type == SIM_SIEVED_PLUS_TRADITIONAL_WB) {
+        ret = lru_cache_init_unindexed (config_info->ssd_size, sim->ssd_cache);
+        check (ret!=-1, "failed to initialize ssd_cache.");
+
+        tiers[TIER_S_WB]  = sim->s_wb;
+        tiers[TIER_TR_WB] = sim->tr_wb;
+        tiers[TIER_SSD]   = sim->ssd_cache;
+        sim->tier_index = (TierIndex *) calloc (1, sizeof(TierIndex));
+        check (sim->tier_index!=NULL, "failed to allocate tier_index.");
+        ret = tier_index_init (tiers, sim->tier_index);
+        check (ret!=-1, "failed to initialize tier_index.");
+    } else {
+        ret = lru_cache_init (config_info->ssd_size, sim->ssd_cache);
+        check (ret!=-1, "failed to initialize ssd_cache.");
+    }
+
+    if (sim->s_wb != NULL) {
+        report_cache_memory ("sieved write buffer", sim->s_wb);
+    }
+    if (sim->tr_wb != NULL) {
+        report_cache_memory ("traditional write buffer", sim->tr_wb);
+    }
+    report_cache_memory ("ssd cache", sim->ssd_cache);
+    if (sim->tier_index != NULL) {
+        printf("tier index: %"PRIu32" records, %.1f MiB\n",
+                sim->tier_index->num_records,
+                (double) tier_index_bytes (sim->tier_index)
+                        / (double) (1 << 20));
+    }
+    if (sim->wb_ghost_cache != NULL) {
+        printf("ghost cache: %"PRIu64" blocks, %.1f MiB, %.1f bytes per block\n",
+                sim->wb_ghost_cache->cache_size,
+                (double) ghost_cache_bytes (sim->wb_ghost_cache)
+                        / (double) (1 << 20),
+                (double) ghost_cache_bytes (sim->wb_ghost_cache)
+                        / (double) sim->wb_ghost_cache->cache_size);
+    }
+    printf("miss filter: %"PRIu64" slots, %d bits per slot, %.1f MiB\n",
+            sim->miss_filter->size,
+            (sim->miss_filter->slots != NULL)
+                    ? (sim->miss_filter->slot_bytes << 3)
+                    : (int) (sizeof(MissFilterEntry) << 3),
+            (double) miss_filter_bytes (sim->miss_filter)
+                    / (double) (1 << 20));
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+static inline int simulator_dispatch (Simulator *sim, Request *req)
+{
+    sim->tot_reqs += 1;
+
+    switch (sim->config_info.test_type) {
+    case SIM_SIEVE_STORE_BASE:
+        return sieve_store_base_access (sim, req);
+    case SIM_TRADITIONAL_WB:
+        return traditional_wb_access (sim, req);
+    case SIM_SIEVED_WB:
+        return sieved_wb_access (sim, req);
+    case SIM_MRC:
+        return mrc_sim_access (sim, req);
+    default:
+        return sieved_plus_traditional_wb_access (sim, req);
+    }
+}
+
+/* Simulate one block access, or skip it if it is not sampled. */
+int simulator_access (Simulator *sim, Request *req)
+{
+    int ret;
+    uint64_t hash, group, hits[2], lookups[2], new_hits[2], new_lookups[2];
+
+    if (sim->sample_threshold == 0) {
+        return simulator_dispatch (sim, req);
+    }
+
+    hash = hash_u64 (request_key (req));
+    if (hash >= sim->sample_threshold) {
+        return 0;
+    }
+    group = hash % SIM_SAMPLE_GROUPS;
+
+    sample_counters (sim, hits, lookups);
+    ret = simulator_dispatch (sim, req);
+    sample_counters (sim, new_hits, new_lookups);
+
+    sim->sample_hits[group][0] += new_hits[0] - hits[0];
+    sim->sample_hits[group][1] += new_hits[1] - hits[1];
+    sim->sample_lookups[group][0] += new_lookups[0] - lookups[0];
+    sim->sample_lookups[group][1] += new_lookups[1] - lookups[1];
+
+    return ret;
+}
+
+/*
+ * Prefetch what the structures of sim will look up for the next
+ * requests. Only cpu caches are touched, so results do not change.
+ */
+static void simulator_prefetch_batch (Simulator *sim, const Request *reqs,
+        uint32_t num_reqs)
+{
+    if (sim->tier_index != NULL) {
+        tier_index_prefetch_batch (sim->tier_index, reqs, num_reqs);
+    } else {
+        if (sim->s_wb != NULL) {
+            lru_cache_prefetch_batch (sim->s_wb, reqs, num_reqs);
+        }
+        if (sim->tr_wb != NULL) {
+            lru_cache_prefetch_batch (sim->tr_wb, reqs, num_reqs);
+        }
+        if (sim->ssd_cache != NULL) {
+            lru_cache_prefetch_batch (sim->ssd_cache, reqs, num_reqs);
+        }
+    }
+    if (sim->miss_filter != NULL) {
+        miss_filter_prefetch_batch (sim->miss_filter, reqs, num_reqs);
+    }
+    if (sim->miss_table != NULL) {
+        miss_table_prefetch_batch (sim->miss_table, reqs, num_reqs);
+    }
+    if (sim->wb_ghost_cache != NULL) {
+        ghost_cache_prefetch_batch (sim->wb_ghost_cache, reqs, num_reqs);
+    }
+}
+
+/*
+ * simulator_access over reqs in trace order, SIM_PREFETCH_GROUP at a
+ * time, with the next group prefetched before the current one runs.
+ */
+int simulator_access_batch (Simulator *sim, Request *reqs, uint32_t num_reqs)
+{
+    int ret;
+    uint32_t i, end, next_end;
+
+    end = (num_reqs < SIM_PREFETCH_GROUP) ? num_reqs : SIM_PREFETCH_GROUP;
+    simulator_prefetch_batch (sim, reqs, end);
+
+    for (i = 0; i < num_reqs; ) {
+        next_end = (num_reqs - end < SIM_PREFETCH_GROUP)
+                 ? num_reqs : (end + SIM_PREFETCH_GROUP);
+        simulator_prefetch_batch (sim, &(reqs[end]), next_end - end);
+
+        for (; i < end; i++) {
+            ret = simulator_access (sim, &(reqs[i]));
+            check (ret==0, "failed to simulate request.");
+        }
+        end = next_end;
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Advance the simulators by one request of reqs each in turn, all of
+ * them through a request before the next. Every step prefetches what
+ * the step SIM_INTERLEAVE_AHEAD later looks up, which is in another
+ * simulator's tables whenever there are more of them than that, so
+ * the cache misses of different configurations overlap on one core.
+ * Each simulator still sees reqs in trace order.
+ */
+int simulator_access_interleaved (Simulator **sims, uint32_t num_sims,
+        Request *reqs, uint32_t num_reqs)
+{
+    int ret;
+    uint32_t i, j, k, ahead_req = 0, ahead_sim = 0;
+
+    for (k = 0; (k < SIM_INTERLEAVE_AHEAD) && (ahead_req < num_reqs); k++) {
+        simulator_prefetch_batch (sims[ahead_sim], &(reqs[ahead_req]), 1);
+        if (++ahead_sim == num_sims) {
+            ahead_sim = 0;
+            ahead_req += 1;
+        }
+    }
+
+    for (i = 0; i < num_reqs; i++) {
+        for (j = 0; j < num_sims; j++) {
+            if (ahead_req < num_reqs) {
+                simulator_prefetch_batch (sims[ahead_sim],
+                        &(reqs[ahead_req]), 1);
+                if (++ahead_sim == num_sims) {
+                    ahead_sim = 0;
+                    ahead_req += 1;
+                }
+            }
+
+            ret = simulator_access (sims[j], &(reqs[i]));
+            check (ret==0, "failed to simulate request.");
+        }
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/* Feed reqs to every simulator, a batch or a request at a time. */
+static int simulator_access_all (Simulator **sims, uint32_t num_sims,
+        Request *reqs, uint32_t num_reqs, uint8_t interleave)
+{
+    int ret;
+    uint32_t j;
+
+    if (interleave && (num_sims > 1)) {
+        return simulator_access_interleaved (sims, num_sims, reqs, num_reqs);
+    }
+
+    for (j = 0; j < num_sims; j++) {
+        ret = simulator_access_batch (sims[j], reqs, num_reqs);
+        check (ret==0, "failed to simulate request batch.");
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+static void report_table (Simulator *sim, const char *name, void *table)
+{
+    TableMemUsage usage;
+
+    if ((table == NULL) || (table_mem_usage (table, &usage) != 0)) {
+        return;
+    }
+
+    printf("%s: %s %.1f MiB, %.1f MiB resident, %.0f%% in huge pages\n",
+            sim->config_info.result_file, name,
+            (double) usage.bytes / (double) (1 << 20),
+            (double) usage.rss_bytes / (double) (1 << 20),
+            (usage.rss_bytes > 0)
+                    ? 100.0 * (double) usage.huge_bytes
+                            / (double) usage.rss_bytes
+                    : 0.0);
+}
+
+/*
+ * Print how much of each mapped table the run touched and how much of
+ * that sits in huge pages. Tables small enough for calloc are left out.
+ */
+static void report_table_memory (Simulator *sim)
+{
+    if (sim->s_wb != NULL) {
+        report_table (sim, "sieved write buffer lookup table",
+                sim->s_wb->lookup_table);
+    }
+    if (sim->tr_wb != NULL) {
+        report_table (sim, "traditional write buffer lookup table",
+                sim->tr_wb->lookup_table);
+    }
+    if (sim->ssd_cache != NULL) {
+        report_table (sim, "ssd cache entries", sim->ssd_cache->cache_entry);
+        report_table (sim, "ssd cache lookup table",
+                sim->ssd_cache->lookup_table);
+    }
+    if (sim->tier_index != NULL) {
+        report_table (sim, "tier index records", sim->tier_index->record);
+        report_table (sim, "tier index lookup table",
+                sim->tier_index->lookup_table);
+    }
+    if (sim->miss_filter != NULL) {
+        report_table (sim, "miss filter",
+                (sim->miss_filter->slots != NULL)
+                        ? sim->miss_filter->slots
+                        : (void *) sim->miss_filter->entry);
+    }
+    if (sim->miss_table != NULL) {
+        report_table (sim, "miss table lookup table",
+                sim->miss_table->lookup_table);
+    }
+    if (sim->wb_ghost_cache != NULL) {
+        report_table (sim, "ghost cache entries",
+                sim->wb_ghost_cache->cache_entry);
+        report_table (sim, "ghost cache lookup table",
+                sim->wb_ghost_cache->lookup_table);
+        report_table (sim, "ghost cache slots", sim->wb_ghost_cache->slots);
+    }
+}
+
+/* Write the statistics of sim to its result file. */
+void simulator_report (Simulator *sim)
+{
+    switch (sim->config_info.test_type) {
+    case SIM_SIEVE_STORE_BASE:
+        sieve_store_base_report (sim);
+        break;
+    case SIM_TRADITIONAL_WB:
+        traditional_wb_report (sim);
+        break;
+    case SIM_SIEVED_WB:
+        sieved_wb_report (sim);
+        break;
+    case SIM_MRC:
+        mrc_sim_report (sim);
+        break;
+    default:
+        sieved_plus_traditional_wb_report (sim);
+        break;
+    }
+
+    if (sim->miss_filter != NULL) {
+        fprintf(sim->out_fp, "\n");
+        fprintf(sim->out_fp, "miss filter: \n");
+        fprintf(sim->out_fp, "miss filter size:   %"PRIu64"\n",
+                sim->miss_filter->size * sim->num_shards);
+        fprintf(sim->out_fp, "miss filter hashes: %"PRIu8"\n",
+                sim->miss_filter->num_hashes);
+        fprintf(sim->out_fp, "estimated false positive rate: %.6f\n",
+                (sim->num_shards > 1) ? sim->miss_filter_fp_rate
+                        : miss_filter_false_positive_rate (sim->miss_filter));
+    }
+
+    if (sim->sample_threshold != 0) {
+        sample_report (sim);
+    }
+
+    fflush (sim->out_fp);
+    report_table_memory (sim);
+}
+
+static void merge_cache_counters (LRUCache *cache, const LRUCache *shard)
+{
+    cache->cache_size    += shard->cache_size;
+    cache->entry_count   += shard->entry_count;
+    cache->read_lookups  += shard->read_lookups;
+    cache->write_lookups += shard->write_lookups;
+    cache->read_hits     += shard->read_hits;
+    cache->write_hits    += shard->write_hits;
+    cache->num_writes    += shard->num_writes;
+    cache->num_updates   += shard->num_updates;
+    cache->num_removes   += shard->num_removes;
+    cache->num_replaces  += shard->num_replaces;
+}
+
+/*
+ * Add the counters and sizes of shard, which simulated another slice
+ * of the key space of the same configuration, into sim so that
+ * simulator_report covers both. sim is only fit for reporting after.
+ */
+void simulator_merge (Simulator *sim, Simulator *shard)
+{
+    uint32_t g;
+
+    sim->tot_reqs   += shard->tot_reqs;
+    sim->tot_reads  += shard->tot_reads;
+    sim->tot_writes += shard->tot_writes;
+    for (g = 0; g < SIM_SAMPLE_GROUPS; g++) {
+        sim->sample_hits[g][0]    += shard->sample_hits[g][0];
+        sim->sample_hits[g][1]    += shard->sample_hits[g][1];
+        sim->sample_lookups[g][0] += shard->sample_lookups[g][0];
+        sim->sample_lookups[g][1] += shard->sample_lookups[g][1];
+    }
+
+    if (sim->s_wb != NULL) {
+        merge_cache_counters (sim->s_wb, shard->s_wb);
+    }
+    if (sim->tr_wb != NULL) {
+        merge_cache_counters (sim->tr_wb, shard->tr_wb);
+    }
+    if (sim->ssd_cache != NULL) {
+        merge_cache_counters (sim->ssd_cache, shard->ssd_cache);
+    }
+    if (sim->wb_ghost_cache != NULL) {
+        sim->wb_ghost_cache->cache_size   += shard->wb_ghost_cache->cache_size;
+        sim->wb_ghost_cache->num_inserts  += shard->wb_ghost_cache->num_inserts;
+        sim->wb_ghost_cache->num_replaces += shard->wb_ghost_cache->num_replaces;
+    }
+    if (sim->miss_filter != NULL) {
+        if (sim->num_shards == 1) {
+            sim->miss_filter_fp_rate = miss_filter_false_positive_rate (
+                    sim->miss_filter);
+        }
+        sim->miss_filter_fp_rate = (sim->miss_filter_fp_rate * sim->num_shards
+                + miss_filter_false_positive_rate (shard->miss_filter))
+                / (sim->num_shards + 1);
+    }
+
+    sim->num_shards += 1;
+}
+
+/*
+ * Append to the result file of sim, merged from shards, how far its
+ * ssd cache hit ratios are from those of reference, the same
+ * configuration simulated unsharded over the same trace.
+ */
+void simulator_report_deviation (Simulator *sim, Simulator *reference)
+{
+    static const char *names[2] = { "read hits ratio ", "write hits ratio" };
+    uint64_t hits[2], lookups[2], ref_hits[2], ref_lookups[2];
+    double ratio, ref_ratio, duration, ref_duration;
+    int type;
+
+    sample_counters (sim, hits, lookups);
+    sample_counters (reference, ref_hits, ref_lookups);
+    duration = (sim->end.tv_sec - sim->start.tv_sec)
+        + (sim->end.tv_usec - sim->start.tv_usec) / 1000000.0;
+    ref_duration = (reference->end.tv_sec - reference->start.tv_sec)
+        + (reference->end.tv_usec - reference->start.tv_usec) / 1000000.0;
+
+    fprintf(sim->out_fp, "\n");
+    fprintf(sim->out_fp, "shard validation: \n");
+    fprintf(sim->out_fp, "shards          :  %"PRIu32"\n", sim->num_shards);
+    fprintf(sim->out_fp, "cache, filter and table sizes are split over the "
+            "shards, and a direct\nmapped miss filter slot only pools the "
+            "misses of a block number\nacross the volumes of one shard; "
+            "the deviation includes both\n");
+    fprintf(sim->out_fp, "# ratio sharded unsharded deviation\n");
+    for (type = 0; type < 2; type++) {
+        if ((lookups[type] == 0) || (ref_lookups[type] == 0)) {
+            fprintf(sim->out_fp, "%s:  no lookups\n", names[type]);
+            continue;
+        }
+        ratio = (double) hits[type] / (double) lookups[type];
+        ref_ratio = (double) ref_hits[type] / (double) ref_lookups[type];
+        fprintf(sim->out_fp, "%s:  %.4f %.4f %+.4f\n", names[type], ratio,
+                ref_ratio, ratio - ref_ratio);
+        printf("%s: %s sharded %.4f unsharded %.4f deviation %+.4f\n",
+                sim->config_info.result_file, names[type], ratio, ref_ratio,
+                ratio - ref_ratio);
+    }
+    fprintf(sim->out_fp, "speedup = %.2f\n",
+            (duration > 0.0) ? ref_duration / duration : 0.0);
+    fflush (sim->out_fp);
+}
+
+void simulator_destroy (Simulator *sim)
+{
+    if (sim->out_fp != NULL) {
+        fclose (sim->out_fp);
+    }
+
+    if (sim->debug_fp != NULL) {
+        fclose (sim->debug_fp);
+    }
+
+    if (sim->s_wb != NULL) {
+        lru_cache_destroy (sim->s_wb);
+    }
+
+    if (sim->tr_wb != NULL) {
+        lru_cache_destroy (sim->tr_wb);
+    }
+
+    if (sim->miss_filter != NULL) {
+        miss_filter_destroy (sim->miss_filter);
+    }
+
+    if (sim->miss_table != NULL) {
+        miss_table_destroy (sim->miss_table);
+    }
+
+    if (sim->wb_ghost_cache != NULL) {
+        ghost_cache_destroy (sim->wb_ghost_cache);
+    }
+
+    if (sim->ssd_cache != NULL) {
+        lru_cache_destroy (sim->ssd_cache);
+    }
+
+    if (sim->tier_index != NULL) {
+        tier_index_destroy (sim->tier_index);
+    }
+
+    if (sim->mrc != NULL) {
+        mrc_destroy (sim->mrc);
+    }
+
+    free (sim);
+}
+
+/*
+ * Parse the trace once and feed every request to each simulator in
+ * turn, a batch at a time or, with interleave set, a request at a
+ * time. The simulators do not share state, so the results are the
+ * same as running them one at a time.
+ */
+int simulator_run (char *trace_file, uint32_t num_parser_threads,
+        Simulator **sims, uint32_t num_sims, uint8_t interleave)
+{
+    int ret;
+    uint32_t j;
+    uint64_t tot_reqs = 0, next_progress = SIM_PROGRESS_STEP;
+    int progress = 10;
+    struct timeval start, end;
+    TraceStream *trace_stream = NULL;
+    RequestBatch *batch;
+
+    gettimeofday (&start, NULL);
+
+    trace_stream = (TraceStream *) calloc (1, sizeof(TraceStream));
+    check (trace_stream!=NULL, "failed to allocate trace_stream.");
+    ret = trace_stream_open (trace_file, num_parser_threads, trace_stream);
+    check (ret==0, "failed to open trace file:%s\n", trace_file);
+    for (j = 0; j < num_sims; j++) {
+        sims[j]->volume_dict = trace_stream->reader->volumes;
+    }
+
+    while ((ret = trace_stream_next(trace_stream, &batch)) == 1) {
+        ret = simulator_access_all (sims, num_sims, batch->reqs,
+                batch->num_reqs, interleave);
+        check (ret==0, "failed to simulate request batch.");
+
+        tot_reqs += batch->num_reqs;
+        while (tot_reqs >= next_progress) {
+            printf("%d%% is done.\n", progress);
+            progress += 10;
+            next_progress += SIM_PROGRESS_STEP;
+        }
+    } // loop through each batch from the trace file
+    check (ret==0, "failed to read trace file:%s\n", trace_file);
+
+    gettimeofday (&end, NULL);
+
+    for (j = 0; j < num_sims; j++) {
+        sims[j]->start = start;
+        sims[j]->end = end;
+        sims[j]->volume_dict = NULL;    // goes with the stream
+    }
+
+    trace_stream_destroy (trace_stream);
+
+    return 0;
+
+error:
+
+    if (trace_stream != NULL) {
+        trace_stream_destroy (trace_stream);
+    }
+
+    return -1;
+}
+
+/*
+ * Simulate a trace already loaded in memory on sims, fed as by
+ * simulator_run. The records are only read, so any number of
+ * simulators may replay the same trace from different threads.
+ * progress, if not NULL, is advanced by the number of records
+ * replayed.
+ */
+int simulator_replay (Simulator **sims, uint32_t num_sims, TraceData *trace,
+        uint8_t interleave, _Atomic uint64_t *progress)
+{
+    int ret;
+    uint64_t i, last_progress = 0;
+    uint32_t j, num_reqs = 0;
+    TraceRecord *record;
+    Request req;
+    Request reqs[SIM_REPLAY_BATCH_SIZE];
+
+    for (j = 0; j < num_sims; j++) {
+        sims[j]->volume_dict = trace->volumes;
+    }
+    for (i = 0; i < trace->num_records; i++) {
+        record = &(trace->records[i]);
+        req.volume_id = record->volume_id;
+        req.req_type = record->req_type;
+        req.sub_window_ind = (record->timestamp - trace->starting_time_stamp)
+                            / SUB_WINDOW_SIZE;
+        req.timestamp = record->timestamp;
+
+        for (j = 0; j < record->num_blocks; j++) {
+            req.block_num = record->start_block + j;
+            reqs[num_reqs++] = req;
+            if (num_reqs == SIM_REPLAY_BATCH_SIZE) {
+                ret = simulator_access_all (sims, num_sims, reqs, num_reqs,
+                        interleave);
+                check (ret==0, "failed to simulate request batch.");
+                num_reqs = 0;
+            }
+        }
+
+        if ((progress != NULL)
+                && (i + 1 - last_progress == SIM_REPLAY_PROGRESS_STEP)) {
+            atomic_fetch_add_explicit (progress, SIM_REPLAY_PROGRESS_STEP,
+                    memory_order_relaxed);
+            last_progress = i + 1;
+        }
+    }
+
+    ret = simulator_access_all (sims, num_sims, reqs, num_reqs, interleave);
+    check (ret==0, "failed to simulate request batch.");
+
+    if (progress != NULL) {
+        atomic_fetch_add_explicit (progress, i - last_progress,
+                memory_order_relaxed);
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
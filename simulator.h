@@ -0,0 +1,120 @@
+#ifndef SIMULATOR_H_
+#define SIMULATOR_H_
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "config_parser.h"
+#include "lru_cache.h"
+#include "miss_filter.h"
+#include "miss_table.h"
+#include "ghost_cache.h"
+#include "tier_index.h"
+#include "mrc.h"
+#include "trace.h"
+#include "volume_dict.h"
+
+/* config_info->test_type */
+#define SIM_SIEVE_STORE_BASE            0
+#define SIM_TRADITIONAL_WB              1
+#define SIM_SIEVED_WB                   2
+#define SIM_SIEVED_PLUS_TRADITIONAL_WB  3
+#define SIM_MRC                         4   // LRU miss ratio curve
+
+#define SIM_PROGRESS_STEP               292000000
+#define SIM_REPLAY_PROGRESS_STEP        65536   // Records between progress updates
+#define SIM_SAMPLE_GROUPS               16      // Sub-samples for the error estimate
+#define SIM_PREFETCH_GROUP              16      // Requests prefetched ahead
+#define SIM_REPLAY_BATCH_SIZE           1024    // Requests replayed at a time
+#define SIM_INTERLEAVE_AHEAD            4       // Interleaved steps prefetched ahead
+
+/* StagedRequest act, what is left to do for the request */
+#define SIM_ACT_NONE                    0
+#define SIM_ACT_FILTER                  1   // Missed every tier
+#define SIM_ACT_TABLE                   2   // Passed the miss filter
+#define SIM_ACT_GHOST_NEW               3   // Write passed the miss table
+#define SIM_ACT_GHOST_HIT               4   // Write hit tr_wb or ssd_cache
+#define SIM_ACT_TO_SSD                  5   // Place the block in ssd_cache
+#define SIM_ACT_TO_TR_WB                6   // Place the block in tr_wb
+#define SIM_ACT_TO_S_WB                 7   // Place the block in s_wb
+#define SIM_ACT_PROMOTE                 8   // Move the hit block to s_wb
+#define SIM_ACT_KEEP                    9   // Leave the hit block in its tier
+
+/*
+ * A sieved + traditional wb request on its way through the stages of
+ * the simulation: the tiers, the miss filter, the miss table, the
+ * ghost cache and the tiers again to place the block. Each stage only
+ * touches its own structure, so as long as every stage sees the
+ * requests in trace order the stages may run on different threads.
+ */
+typedef struct StagedRequest {
+    Request   req;
+    uint32_t  record;           // Tier index record of the block
+    uint8_t   tier;             // Tier the block was found in
+    uint8_t   act;              // SIM_ACT_*
+} StagedRequest;
+
+/*
+ * One simulated cache configuration. Each instance owns its
+ * structures, so any number of them can be driven off the same
+ * request stream.
+ */
+typedef struct Simulator {
+    ConfigInfo      config_info;
+    FILE           *out_fp;
+    FILE           *debug_fp;       // sieved + traditional wb only
+    const VolumeDict *volume_dict;  // Of the trace being simulated
+    LRUCache       *s_wb;           // sieved write buffer
+    LRUCache       *tr_wb;          // traditional write buffer
+    MissFilter     *miss_filter;
+    MissTable      *miss_table;
+    GhostCache     *wb_ghost_cache;
+    LRUCache       *ssd_cache;
+    TierIndex      *tier_index;     // sieved + traditional wb only
+    MissRatioCurve *mrc;            // miss ratio curve only
+    uint64_t        tot_reqs;
+    uint64_t        tot_reads;
+    uint64_t        tot_writes;
+    /*
+     * Spatial sampling: only blocks whose key hashes below
+     * sample_threshold are simulated, 0 simulates every block. The
+     * ssd cache hits and lookups of each hash group feed the error
+     * estimate, [0] for reads and [1] for writes.
+     */
+    uint64_t        sample_threshold;
+    uint64_t        sample_hits[SIM_SAMPLE_GROUPS][2];
+    uint64_t        sample_lookups[SIM_SAMPLE_GROUPS][2];
+    /*
+     * Shards whose counters and sizes were merged into this one by
+     * simulator_merge, itself included. Tables are not merged, the
+     * miss filter false positive rate is averaged over the shards.
+     */
+    uint32_t        num_shards;
+    double          miss_filter_fp_rate;
+    struct timeval  start;
+    struct timeval  end;
+} Simulator;
+
+int  simulator_init    (ConfigInfo *config_info, Simulator *sim);
+int  simulator_access  (Simulator *sim, Request *req);
+int  simulator_access_batch (Simulator *sim, Request *reqs, uint32_t num_reqs);
+int  simulator_access_interleaved (Simulator **sims, uint32_t num_sims,
+                                   Request *reqs, uint32_t num_reqs);
+void simulator_report  (Simulator *sim);
+void simulator_merge   (Simulator *sim, Simulator *shard);
+void simulator_report_deviation (Simulator *sim, Simulator *reference);
+void simulator_destroy (Simulator *sim);
+int  simulator_run     (char *trace_file, uint32_t num_parser_threads,
+                        Simulator **sims, uint32_t num_sims,
+                        uint8_t interleave);
+int  simulator_replay  (Simulator **sims, uint32_t num_sims, TraceData *trace,
+                        uint8_t interleave, _Atomic uint64_t *progress);
+void simulator_stage_tiers  (Simulator *sim, StagedRequest *staged);
+void simulator_stage_filter (Simulator *sim, StagedRequest *staged);
+void simulator_stage_table  (Simulator *sim, StagedRequest *staged);
+void simulator_stage_ghost  (Simulator *sim, StagedRequest *staged);
+void simulator_stage_place  (Simulator *sim, StagedRequest *staged);
+
+#endif
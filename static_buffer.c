@@ -1,8 +1,58 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "debug.h"
 #include "static_buffer.h"
 
+#define STATIC_BUFFER_GOLDEN    0x9E3779B97F4A7C15ULL
+
+/* Position of a key with hash under pilot, in [0, num_keys). */
+static inline uint64_t static_buffer_position (uint64_t hash, uint32_t pilot,
+        uint64_t num_keys)
+{
+    return hash_u64 (hash ^ ((uint64_t) pilot * STATIC_BUFFER_GOLDEN))
+            % num_keys;
+}
+
+/*
+ * The high half of hash picks the Bloom block, the bits of a
+ * multiplicative rehash pick STATIC_BUFFER_BLOOM_HASHES bits of it.
+ */
+static inline const uint64_t *static_buffer_bloom_block (const StaticBuffer *sb,
+        uint64_t hash)
+{
+    return &(sb->bloom[(((hash >> 32) * sb->bloom_blocks) >> 32) << 3]);
+}
+
+static inline void static_buffer_bloom_add (StaticBuffer *sb, uint64_t hash)
+{
+    uint64_t *block = (uint64_t *) static_buffer_bloom_block (sb, hash);
+    uint64_t bits = hash * STATIC_BUFFER_GOLDEN;
+    uint32_t i, bit;
+
+    for (i = 0; i < STATIC_BUFFER_BLOOM_HASHES; i++) {
+        bit = (bits >> (64 - 9 * (i + 1))) & 511;
+        block[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+static inline int static_buffer_bloom_test (const StaticBuffer *sb,
+        uint64_t hash)
+{
+    const uint64_t *block = static_buffer_bloom_block (sb, hash);
+    uint64_t bits = hash * STATIC_BUFFER_GOLDEN;
+    uint32_t i, bit;
+
+    for (i = 0; i < STATIC_BUFFER_BLOOM_HASHES; i++) {
+        bit = (bits >> (64 - 9 * (i + 1))) & 511;
+        if ((block[bit >> 6] & (1ULL << (bit & 63))) == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 
 int static_buffer_init (StaticBuffer *sb, uint64_t size)
 {
@@ -24,23 +74,40 @@ error:
     return -1;
 }
 
-int static_buffer_lookup   (StaticBuffer *sb, ReplayReq *req)
+/*
+ * Whether the block is in the buffer. Nothing is written, so any
+ * number of threads can ask at once.
+ */
+int static_buffer_contains (const StaticBuffer *sb, uint64_t block_num,
+        uint32_t volume_id)
 {
-    int exists = 0;
-    uint64_t table_ind = req->block_num % sb->size;
-    StaticBufferEntry *entry = sb->lookup_table[table_ind];
+    BlockKey key = block_key (block_num, volume_id);
+    uint64_t hash = hash_u64 (key);
+    const StaticBufferEntry *entry;
 
+    if (sb->keys != NULL) {
+        if (!static_buffer_bloom_test (sb, hash)) {
+            return 0;
+        }
+        return (sb->keys[static_buffer_position (hash,
+                    sb->pilots[hash % sb->num_buckets], sb->num_keys)] == key);
+    }
+
+    entry = sb->lookup_table[hash % sb->size];
     while (entry != NULL) {
-        if ((entry->block_num == req->block_num) &&
-            (entry->server_num == req->server_num) &&
-            (entry->volume_num == req->volume_num)) {
-            exists = 1;
-            break;
-        } else {
-            entry = entry->lookup_next;
+        if (entry->key == key) {
+            return 1;
         }
+        entry = entry->lookup_next;
     }
 
+    return 0;
+}
+
+int static_buffer_lookup   (StaticBuffer *sb, ReplayReq *req)
+{
+    int exists = static_buffer_contains (sb, req->block_num, req->volume_id);
+
     if (exists) {
         if (req->req_type == 0) {
             sb->read_hits += 1;
@@ -53,16 +120,17 @@ int static_buffer_lookup   (StaticBuffer *sb, ReplayReq *req)
 }
 
 int static_buffer_insert (StaticBuffer *sb, uint64_t block_num,
-        uint8_t server_num, uint8_t volume_num)
+        uint32_t volume_id)
 {
-    uint64_t table_ind = block_num % sb->size;
+    BlockKey key = block_key (block_num, volume_id);
+    uint64_t table_ind = hash_u64 (key) % sb->size;
     StaticBufferEntry *entry = NULL;
 
+    check(sb->keys == NULL, "cannot insert into a frozen static buffer.");
+
     // insert into sb
     entry = &(sb->entry[sb->entry_count]);
-    entry->block_num = block_num;
-    entry->server_num = server_num;
-    entry->volume_num = volume_num;
+    entry->key = key;
 
     // insert into the front of the lookup table
     entry->lookup_next = sb->lookup_table[table_ind];
@@ -78,6 +146,313 @@ int static_buffer_insert (StaticBuffer *sb, uint64_t block_num,
      return -1;
 }
 
+static int compare_u64 (const void *a, const void *b)
+{
+    uint64_t x = *((const uint64_t *) a);
+    uint64_t y = *((const uint64_t *) b);
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Place the buckets, largest first, each at the first pilot that
+ * sends all of its keys to free positions. Distinct keys have
+ * distinct hashes, so some pilot always works for a bucket of one.
+ */
+static int static_buffer_place (StaticBuffer *sb, uint64_t *hashes,
+        uint64_t *bucket_start, uint64_t *bucket_order, uint8_t *taken,
+        uint64_t *positions)
+{
+    uint64_t i, j, b, size, pos;
+    uint32_t pilot;
+
+    for (i = 0; i < sb->num_buckets; i++) {
+        b = bucket_order[i];
+        size = bucket_start[b + 1] - bucket_start[b];
+        if (size == 0) {
+            break;
+        }
+
+        for (pilot = 0; pilot < STATIC_BUFFER_MAX_PILOT; pilot++) {
+            for (j = 0; j < size; j++) {
+                pos = static_buffer_position (hashes[bucket_start[b] + j],
+                        pilot, sb->num_keys);
+                if (taken[pos]) {
+                    break;
+                }
+                taken[pos] = 1;
+                positions[j] = pos;
+            }
+            if (j == size) {
+                break;
+            }
+            while (j > 0) {
+                j -= 1;
+                taken[positions[j]] = 0;
+            }
+        }
+        check (pilot<STATIC_BUFFER_MAX_PILOT,
+                "no pilot places static buffer bucket %"PRIu64".", b);
+
+        sb->pilots[b] = pilot;
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Build the frozen lookup from the inserted entries and drop the
+ * chains; the buffer takes no more inserts afterwards. Duplicate
+ * inserts of a block collapse into one key.
+ */
+int static_buffer_freeze (StaticBuffer *sb)
+{
+    uint64_t  i, b, n = 0, max_size = 0, hash;
+    uint64_t *sorted = NULL, *hashes = NULL, *positions = NULL;
+    uint64_t *bucket_start = NULL, *bucket_order = NULL, *size_start = NULL;
+    uint8_t  *taken = NULL;
+
+    check (sb->keys==NULL, "the static buffer is already frozen.");
+
+    sorted = (uint64_t *) malloc ((sb->entry_count + 1) * sizeof(uint64_t));
+    check (sorted!=NULL, "failed to allocate static buffer keys.");
+    for (i = 0; i < sb->entry_count; i++) {
+        sorted[i] = sb->entry[i].key;
+    }
+    qsort (sorted, sb->entry_count, sizeof(uint64_t), compare_u64);
+    for (i = 0; i < sb->entry_count; i++) {
+        if ((n == 0) || (sorted[i] != sorted[n - 1])) {
+            sorted[n++] = sorted[i];
+        }
+    }
+
+    sb->num_keys     = (n > 0) ? n : 1;
+    sb->num_buckets  = (n + STATIC_BUFFER_BUCKET_KEYS - 1)
+                     / STATIC_BUFFER_BUCKET_KEYS;
+    sb->num_buckets  = (sb->num_buckets > 0) ? sb->num_buckets : 1;
+    sb->bloom_blocks = (n * STATIC_BUFFER_BLOOM_BITS + 511) >> 9;
+    sb->bloom_blocks = (sb->bloom_blocks > 0) ? sb->bloom_blocks : 1;
+
+    /* counting sort of the hashes by bucket */
+    hashes = (uint64_t *) malloc (sb->num_keys * sizeof(uint64_t));
+    bucket_start = (uint64_t *) calloc (sb->num_buckets + 1, sizeof(uint64_t));
+    bucket_order = (uint64_t *) malloc (sb->num_buckets * sizeof(uint64_t));
+    check ((hashes!=NULL) && (bucket_start!=NULL) && (bucket_order!=NULL),
+            "failed to allocate static buffer buckets.");
+    for (i = 0; i < n; i++) {
+        bucket_start[hash_u64 (sorted[i]) % sb->num_buckets + 1] += 1;
+    }
+    for (b = 0; b < sb->num_buckets; b++) {
+        if (bucket_start[b + 1] > max_size) {
+            max_size = bucket_start[b + 1];
+        }
+        bucket_start[b + 1] += bucket_start[b];
+    }
+    for (i = 0; i < n; i++) {
+        b = hash_u64 (sorted[i]) % sb->num_buckets;
+        hashes[bucket_start[b]++] = hash_u64 (sorted[i]);
+    }
+    for (b = sb->num_buckets; b > 0; b--) {
+        bucket_start[b] = bucket_start[b - 1];
+    }
+    bucket_start[0] = 0;
+
+    /* and of the buckets by decreasing size */
+    size_start = (uint64_t *) calloc (max_size + 2, sizeof(uint64_t));
+    check (size_start!=NULL, "failed to allocate static buffer buckets.");
+    for (b = 0; b < sb->num_buckets; b++) {
+        size_start[max_size - (bucket_start[b + 1] - bucket_start[b]) + 1] += 1;
+    }
+    for (i = 0; i <= max_size; i++) {
+        size_start[i + 1] += size_start[i];
+    }
+    for (b = 0; b < sb->num_buckets; b++) {
+        i = max_size - (bucket_start[b + 1] - bucket_start[b]);
+        bucket_order[size_start[i]++] = b;
+    }
+
+    sb->keys   = (uint64_t *) calloc (sb->num_keys, sizeof(uint64_t));
+    sb->pilots = (uint32_t *) calloc (sb->num_buckets, sizeof(uint32_t));
+    sb->bloom  = (uint64_t *) calloc (sb->bloom_blocks << 3, sizeof(uint64_t));
+    taken      = (uint8_t *) calloc (sb->num_keys, sizeof(uint8_t));
+    positions  = (uint64_t *) malloc ((max_size + 1) * sizeof(uint64_t));
+    check ((sb->keys!=NULL) && (sb->pilots!=NULL) && (sb->bloom!=NULL)
+            && (taken!=NULL) && (positions!=NULL),
+            "failed to allocate the frozen static buffer.");
+
+    check (static_buffer_place (sb, hashes, bucket_start, bucket_order,
+                taken, positions) == 0, "failed to place static buffer keys.");
+
+    for (i = 0; i < n; i++) {
+        hash = hash_u64 (sorted[i]);
+        static_buffer_bloom_add (sb, hash);
+        sb->keys[static_buffer_position (hash,
+                sb->pilots[hash % sb->num_buckets], sb->num_keys)] = sorted[i];
+    }
+
+    free (sorted);
+    free (hashes);
+    free (bucket_start);
+    free (bucket_order);
+    free (size_start);
+    free (taken);
+    free (positions);
+
+    free (sb->entry);
+    sb->entry = NULL;
+    free (sb->lookup_table);
+    sb->lookup_table = NULL;
+
+    return 0;
+
+error:
+
+    if (sorted != NULL) {
+        free (sorted);
+    }
+    if (hashes != NULL) {
+        free (hashes);
+    }
+    if (bucket_start != NULL) {
+        free (bucket_start);
+    }
+    if (bucket_order != NULL) {
+        free (bucket_order);
+    }
+    if (size_start != NULL) {
+        free (size_start);
+    }
+    if (taken != NULL) {
+        free (taken);
+    }
+    if (positions != NULL) {
+        free (positions);
+    }
+
+    return -1;
+}
+
+uint64_t static_buffer_bytes (StaticBuffer *sb)
+{
+    if (sb->keys != NULL) {
+        return sb->num_keys * sizeof(uint64_t)
+             + sb->num_buckets * sizeof(uint32_t)
+             + (sb->bloom_blocks << 6);
+    }
+
+    return sb->size
+         * (sizeof(StaticBufferEntry) + sizeof(StaticBufferEntry *));
+}
+
+static void *static_buffer_replay_run (void *arg)
+{
+    StaticBufferReplay *replay = (StaticBufferReplay *) arg;
+    const TraceRecord *record;
+    uint64_t i, block_num, hits[2][2] = {{0, 0}, {0, 0}};
+    uint32_t j, type;
+
+    for (i = replay->first_record; i < replay->end_record; i++) {
+        record = &(replay->trace->records[i]);
+        type = (record->req_type != 0);
+        for (j = 0; j < record->num_blocks; j++) {
+            block_num = record->start_block + j;
+            if ((replay->front != NULL) && static_buffer_contains (
+                        replay->front, block_num, record->volume_id)) {
+                hits[0][type] += 1;
+                continue;
+            }
+            hits[1][type] += static_buffer_contains (replay->sb, block_num,
+                    record->volume_id);
+        }
+    }
+
+    memcpy (replay->hits, hits, sizeof(hits));
+
+    return NULL;
+}
+
+/*
+ * Look up every block of the trace, as static_buffer_lookup would,
+ * on num_threads threads each taking an equal run of records. Blocks
+ * found in front, if given, are counted there and not looked up in
+ * sb. The buffers are only read until the per thread hits are added
+ * to them at the end.
+ */
+int static_buffer_replay (StaticBuffer *front, StaticBuffer *sb,
+        TraceData *trace, uint32_t num_threads)
+{
+    uint32_t i;
+    StaticBufferReplay *replays = NULL;
+
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+#ifndef BOUNCER_THREADS
+    num_threads = 1;
+#endif
+
+    replays = (StaticBufferReplay *) calloc (num_threads,
+            sizeof(StaticBufferReplay));
+    check (replays!=NULL, "failed to allocate static buffer replays.");
+
+    for (i = 0; i < num_threads; i++) {
+        replays[i].front = front;
+        replays[i].sb = sb;
+        replays[i].trace = trace;
+        replays[i].first_record = trace->num_records * i / num_threads;
+        replays[i].end_record = trace->num_records * (i + 1) / num_threads;
+    }
+
+#ifdef BOUNCER_THREADS
+    for (i = 1; i < num_threads; i++) {
+        check (pthread_create (&(replays[i].thread), NULL,
+                    static_buffer_replay_run, &(replays[i])) == 0,
+                "failed to start replay thread %"PRIu32".", i);
+        replays[i].started = 1;
+    }
+#endif
+    static_buffer_replay_run (&(replays[0]));
+#ifdef BOUNCER_THREADS
+    for (i = 1; i < num_threads; i++) {
+        pthread_join (replays[i].thread, NULL);
+        replays[i].started = 0;
+    }
+#endif
+
+    for (i = 0; i < num_threads; i++) {
+        if (front != NULL) {
+            front->read_hits  += replays[i].hits[0][0];
+            front->write_hits += replays[i].hits[0][1];
+        }
+        sb->read_hits  += replays[i].hits[1][0];
+        sb->write_hits += replays[i].hits[1][1];
+    }
+    free (replays);
+
+    return 0;
+
+error:
+
+#ifdef BOUNCER_THREADS
+    if (replays != NULL) {
+        for (i = 1; i < num_threads; i++) {
+            if (replays[i].started) {
+                pthread_join (replays[i].thread, NULL);
+            }
+        }
+    }
+#endif
+    if (replays != NULL) {
+        free (replays);
+    }
+
+    return -1;
+}
+
 void static_buffer_destroy (StaticBuffer *sb)
 {
     if (sb->entry != NULL) {
@@ -88,6 +463,18 @@ void static_buffer_destroy (StaticBuffer *sb)
         free (sb->lookup_table);
     }
 
+    if (sb->keys != NULL) {
+        free (sb->keys);
+    }
+
+    if (sb->pilots != NULL) {
+        free (sb->pilots);
+    }
+
+    if (sb->bloom != NULL) {
+        free (sb->bloom);
+    }
+
     if (sb != NULL) {
         free (sb);
     }
@@ -2,15 +2,31 @@
 #define StaticBuffer_H_
 
 #include <inttypes.h>
+#ifdef BOUNCER_THREADS
+#include <pthread.h>
+#endif
+
 #include "common.h"
+#include "trace.h"
+
+#define STATIC_BUFFER_BUCKET_KEYS   4       // Average keys per pilot
+#define STATIC_BUFFER_MAX_PILOT     (1U << 26)
+#define STATIC_BUFFER_BLOOM_BITS    12      // Bloom filter bits per key
+#define STATIC_BUFFER_BLOOM_HASHES  6       // Bits set per key in a block
 
 typedef struct StaticBufferEntry {
-    uint64_t block_num;
-    uint8_t  server_num;
-    uint8_t  volume_num;
+    BlockKey key;
     struct StaticBufferEntry *lookup_next;
-} StaticBufferEntry __attribute__((aligned (64)));
+} StaticBufferEntry;
 
+/*
+ * Entries are chained off lookup_table while the buffer is built.
+ * static_buffer_freeze then replaces them with a minimal perfect hash
+ * over the distinct block keys: a key hashes to a bucket, and the
+ * bucket's pilot picks the one position in keys the key can be at.
+ * A blocked Bloom filter, one 512 bit block per key, rejects most
+ * blocks that are not in the buffer before the pilot is read.
+ */
 typedef struct StaticBuffer {
     uint64_t               size;
     uint64_t               entry_count;
@@ -18,12 +34,43 @@ typedef struct StaticBuffer {
     uint64_t               write_hits;
     StaticBufferEntry   *entry;
     StaticBufferEntry  **lookup_table;
+    /* frozen */
+    BlockKey              *keys;            // By position
+    uint32_t              *pilots;          // One per bucket
+    uint64_t              *bloom;           // 8 words per block
+    uint64_t               num_keys;
+    uint64_t               num_buckets;
+    uint64_t               bloom_blocks;
 } StaticBuffer;
 
+/*
+ * One thread of a parallel replay: the records in [first_record,
+ * end_record) of the trace, with hits counted locally and merged
+ * into the buffers once every thread is done.
+ */
+typedef struct StaticBufferReplay {
+    const StaticBuffer    *front;
+    const StaticBuffer    *sb;
+    const TraceData       *trace;
+    uint64_t               first_record;
+    uint64_t               end_record;
+    uint64_t               hits[2][2];      // [front, sb][read, write]
+#ifdef BOUNCER_THREADS
+    pthread_t              thread;
+    uint8_t                started;
+#endif
+} StaticBufferReplay;
+
 int  static_buffer_init     (StaticBuffer *sb, uint64_t size);
+int  static_buffer_contains (const StaticBuffer *sb, uint64_t block_num,
+                                uint32_t volume_id);
 int  static_buffer_lookup   (StaticBuffer *sb, ReplayReq *req);
 int  static_buffer_insert   (StaticBuffer *sb, uint64_t block_num,
-                                uint8_t server_num, uint8_t volume_num);
+                                uint32_t volume_id);
+int  static_buffer_freeze   (StaticBuffer *sb);
+uint64_t static_buffer_bytes (StaticBuffer *sb);
+int  static_buffer_replay   (StaticBuffer *front, StaticBuffer *sb,
+                                TraceData *trace, uint32_t num_threads);
 void static_buffer_destroy  (StaticBuffer *sb);
 
 #endif
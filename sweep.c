@@ -0,0 +1,345 @@
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "debug.h"
+#include "common.h"
+#include "config_parser.h"
+#include "trace.h"
+#include "simulator.h"
+#include "sweep.h"
+
+#ifdef BOUNCER_THREADS
+/* Pin the calling worker to the index-th CPU it is allowed to run on. */
+static void sweep_pin_worker (uint32_t index)
+{
+    cpu_set_t allowed, target;
+    int cpu, num_cpus, nth;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        log_warn ("failed to get cpu affinity, worker %"PRIu32" not pinned.",
+                index);
+        return;
+    }
+
+    num_cpus = CPU_COUNT (&allowed);
+    nth = index % num_cpus;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && (nth-- == 0)) {
+            break;
+        }
+    }
+
+    CPU_ZERO (&target);
+    CPU_SET (cpu, &target);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(target), &target) != 0) {
+        log_warn ("failed to pin worker %"PRIu32" to cpu %d.", index, cpu);
+    }
+}
+
+static void *sweep_worker_run (void *arg)
+{
+    int ret;
+    uint32_t i;
+    SweepWorker *worker = (SweepWorker *) arg;
+    Sweep *sweep = worker->sweep;
+    Simulator *sim = NULL;
+
+    if (sweep->pin_cpus) {
+        sweep_pin_worker (worker->index);
+    }
+
+    while (!atomic_load(&sweep->failed)) {
+        i = atomic_fetch_add (&sweep->next_config, 1);
+        if (i >= sweep->num_configs) {
+            break;
+        }
+
+        sim = (Simulator *) calloc (1, sizeof(Simulator));
+        check (sim!=NULL, "failed to allocate simulator.");
+        ret = simulator_init (&(sweep->configs[i]), sim);
+        check (ret==0, "failed to initialize simulator for %s.",
+                sweep->configs[i].result_file);
+
+        gettimeofday (&sim->start, NULL);
+        ret = simulator_replay (&sim, 1, sweep->trace, 0,
+                &sweep->records_done);
+        check (ret==0, "failed to simulate %s.", sweep->configs[i].result_file);
+        gettimeofday (&sim->end, NULL);
+
+        simulator_report (sim);
+        simulator_destroy (sim);
+        sim = NULL;
+        atomic_fetch_add (&sweep->num_finished, 1);
+    }
+
+    atomic_fetch_sub (&sweep->num_running, 1);
+
+    return NULL;
+
+error:
+
+    if (sim != NULL) {
+        simulator_destroy (sim);
+    }
+    atomic_store (&sweep->failed, 1);
+    atomic_fetch_sub (&sweep->num_running, 1);
+
+    return NULL;
+}
+
+/* Print the progress of all workers together every 10%. */
+static void sweep_wait (Sweep *sweep)
+{
+    int progress = 10;
+    uint64_t total, done;
+    struct timespec interval;
+
+    interval.tv_sec = 0;
+    interval.tv_nsec = SWEEP_PROGRESS_INTERVAL_MS * 1000000L;
+    total = sweep->trace->num_records * sweep->num_configs;
+
+    while (atomic_load(&sweep->num_running) > 0) {
+        nanosleep (&interval, NULL);
+        done = atomic_load_explicit (&sweep->records_done,
+                memory_order_relaxed);
+        while ((progress <= 100) && (done * 100 >= total * progress)) {
+            printf ("%d%% is done, %"PRIu32" of %"PRIu32" configurations "
+                    "finished.\n", progress, atomic_load(&sweep->num_finished),
+                    sweep->num_configs);
+            fflush (stdout);
+            progress += 10;
+        }
+    }
+}
+#endif
+
+/*
+ * Load the trace once and simulate the configurations on num_workers
+ * threads, one configuration per worker at a time. Only num_workers
+ * sets of cache structures are allocated at any point.
+ */
+int sweep_run_parallel (ConfigInfo *configs, uint32_t num_configs,
+        uint32_t num_workers, uint8_t pin_cpus)
+{
+#ifdef BOUNCER_THREADS
+    int ret;
+    uint32_t i;
+    Sweep *sweep = NULL;
+
+    sweep = (Sweep *) calloc (1, sizeof(Sweep));
+    check (sweep!=NULL, "failed to allocate sweep.");
+    sweep->configs = configs;
+    sweep->num_configs = num_configs;
+    sweep->num_workers = (num_workers < num_configs) ? num_workers : num_configs;
+    sweep->pin_cpus = pin_cpus;
+    atomic_init (&sweep->next_config, 0);
+    atomic_init (&sweep->num_finished, 0);
+    atomic_init (&sweep->num_running, 0);
+    atomic_init (&sweep->records_done, 0);
+    atomic_init (&sweep->failed, 0);
+
+    sweep->trace = (TraceData *) calloc (1, sizeof(TraceData));
+    check (sweep->trace!=NULL, "failed to allocate trace data.");
+    ret = trace_data_load (configs[0].trace_file, sweep->trace);
+    check (ret==0, "failed to load trace file: %s", configs[0].trace_file);
+
+    sweep->workers = (SweepWorker *) calloc (sweep->num_workers,
+            sizeof(SweepWorker));
+    check (sweep->workers!=NULL, "failed to allocate sweep workers.");
+
+    for (i = 0; i < sweep->num_workers; i++) {
+        sweep->workers[i].sweep = sweep;
+        sweep->workers[i].index = i;
+        atomic_fetch_add (&sweep->num_running, 1);
+        ret = pthread_create (&sweep->workers[i].thread, NULL,
+                sweep_worker_run, &sweep->workers[i]);
+        if (ret != 0) {
+            atomic_fetch_sub (&sweep->num_running, 1);
+        }
+        check (ret==0, "failed to start sweep worker %"PRIu32".", i);
+        sweep->workers[i].started = 1;
+    }
+
+    sweep_wait (sweep);
+
+    for (i = 0; i < sweep->num_workers; i++) {
+        pthread_join (sweep->workers[i].thread, NULL);
+        sweep->workers[i].started = 0;
+    }
+    check (!atomic_load(&sweep->failed), "sweep worker failed.");
+
+    free (sweep->workers);
+    trace_data_destroy (sweep->trace);
+    free (sweep);
+
+    return 0;
+
+error:
+
+    if (sweep != NULL) {
+        if (sweep->workers != NULL) {
+            // let the started workers finish their current configuration
+            atomic_store (&sweep->failed, 1);
+            for (i = 0; i < sweep->num_workers; i++) {
+                if (sweep->workers[i].started) {
+                    pthread_join (sweep->workers[i].thread, NULL);
+                }
+            }
+            free (sweep->workers);
+        }
+        if (sweep->trace != NULL) {
+            trace_data_destroy (sweep->trace);
+        }
+        free (sweep);
+    }
+
+    return -1;
+#else
+    (void) configs;
+    (void) num_configs;
+    (void) num_workers;
+    (void) pin_cpus;
+    log_info ("built without pthreads, cannot run a parallel sweep.");
+    return -1;
+#endif
+}
+
+/*
+ * Replay trace on fresh simulators of configs with method and time
+ * it. fingerprint sums counters that any method must agree on.
+ */
+static int sweep_bench_pass (ConfigInfo *configs, uint32_t num_configs,
+        TraceData *trace, int method, double *seconds, uint64_t *fingerprint)
+{
+    int ret = 0;
+    uint32_t i;
+    ConfigInfo config;
+    Simulator **sims = NULL;
+    struct timeval start, end;
+
+    sims = (Simulator **) calloc (num_configs, sizeof(Simulator *));
+    check (sims!=NULL, "failed to allocate simulators.");
+
+    for (i = 0; i < num_configs; i++) {
+        // nothing is reported, the debug log still has to go somewhere
+        config = configs[i];
+        config.result_file[0] = '\0';
+        snprintf (config.debug_file, FILE_LINE_SIZE, "/dev/null");
+
+        sims[i] = (Simulator *) calloc (1, sizeof(Simulator));
+        check (sims[i]!=NULL, "failed to allocate simulator.");
+        ret = simulator_init (&config, sims[i]);
+        check (ret==0, "failed to initialize simulator for %s.",
+                configs[i].result_file);
+    }
+
+    gettimeofday (&start, NULL);
+    if (method == SWEEP_BENCH_SEQUENTIAL) {
+        for (i = 0; (i < num_configs) && (ret == 0); i++) {
+            ret = simulator_replay (&(sims[i]), 1, trace, 0, NULL);
+        }
+    } else {
+        ret = simulator_replay (sims, num_configs, trace,
+                method == SWEEP_BENCH_INTERLEAVED, NULL);
+    }
+    gettimeofday (&end, NULL);
+    check (ret==0, "failed to replay trace.");
+
+    *seconds = (end.tv_sec - start.tv_sec)
+             + (end.tv_usec - start.tv_usec) / 1000000.0;
+    *fingerprint = 0;
+    for (i = 0; i < num_configs; i++) {
+        *fingerprint += sims[i]->tot_reqs;
+        if (sims[i]->ssd_cache != NULL) {
+            *fingerprint += sims[i]->ssd_cache->read_hits
+                          + sims[i]->ssd_cache->write_hits;
+        }
+        simulator_destroy (sims[i]);
+    }
+    free (sims);
+
+    return 0;
+
+error:
+
+    if (sims != NULL) {
+        for (i = 0; i < num_configs; i++) {
+            if (sims[i] != NULL) {
+                simulator_destroy (sims[i]);
+            }
+        }
+        free (sims);
+    }
+
+    return -1;
+}
+
+/*
+ * Time the configurations replaying the trace one after another, a
+ * batch at a time and interleaved a request at a time, all on the
+ * calling thread, and print the best of iterations of each. The trace
+ * is loaded into memory first and no result files are written.
+ */
+int sweep_bench (ConfigInfo *configs, uint32_t num_configs,
+        uint32_t iterations)
+{
+    static const char *names[SWEEP_BENCH_METHODS] = {
+        "sequential", "batched", "interleaved" };
+    int ret, method;
+    uint32_t i;
+    uint64_t num_blocks = 0, fingerprint[SWEEP_BENCH_METHODS];
+    double seconds, best[SWEEP_BENCH_METHODS] = { 0 };
+    TraceData *trace = NULL;
+
+    trace = (TraceData *) calloc (1, sizeof(TraceData));
+    check (trace!=NULL, "failed to allocate trace data.");
+    ret = trace_data_load (configs[0].trace_file, trace);
+    check (ret==0, "failed to load trace file: %s", configs[0].trace_file);
+    for (i = 0; i < trace->num_records; i++) {
+        num_blocks += trace->records[i].num_blocks;
+    }
+
+    for (i = 0; i < iterations; i++) {
+        for (method = 0; method < SWEEP_BENCH_METHODS; method++) {
+            ret = sweep_bench_pass (configs, num_configs, trace, method,
+                    &seconds, &(fingerprint[method]));
+            check (ret==0, "%s pass failed.", names[method]);
+            if ((best[method] == 0) || (seconds < best[method])) {
+                best[method] = seconds;
+            }
+        }
+    }
+
+    printf ("trace: %s, %"PRIu64" blocks, %"PRIu32" configurations, "
+            "interleaved %d ahead, best of %"PRIu32"\n",
+            configs[0].trace_file, num_blocks, num_configs,
+            SIM_INTERLEAVE_AHEAD, iterations);
+    for (method = 0; method < SWEEP_BENCH_METHODS; method++) {
+        printf ("%-12s %.3f s, %.2f Mrequests/s per core, %.2fx\n",
+                names[method], best[method],
+                num_blocks * num_configs / best[method] / 1e6,
+                best[SWEEP_BENCH_SEQUENTIAL] / best[method]);
+        if (fingerprint[method] != fingerprint[SWEEP_BENCH_SEQUENTIAL]) {
+            printf ("warning: %s results differ from sequential\n",
+                    names[method]);
+        }
+    }
+
+    trace_data_destroy (trace);
+
+    return 0;
+
+error:
+
+    if (trace != NULL) {
+        trace_data_destroy (trace);
+    }
+
+    return -1;
+}
@@ -0,0 +1,55 @@
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+#include <stdatomic.h>
+#ifdef BOUNCER_THREADS
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "config_parser.h"
+#include "trace.h"
+
+#define SWEEP_PROGRESS_INTERVAL_MS  200
+
+/* sweep_bench methods */
+#define SWEEP_BENCH_SEQUENTIAL      0   // One configuration after another
+#define SWEEP_BENCH_BATCHED         1   // All of them a batch at a time
+#define SWEEP_BENCH_INTERLEAVED     2   // All of them a request at a time
+#define SWEEP_BENCH_METHODS         3
+
+struct Sweep;
+
+typedef struct SweepWorker {
+    struct Sweep *sweep;
+    uint32_t      index;
+#ifdef BOUNCER_THREADS
+    pthread_t     thread;
+    uint8_t       started;
+#endif
+} SweepWorker;
+
+/*
+ * Configurations are handed out to a bounded number of workers, each
+ * replaying the shared, read-only trace with its own structures.
+ */
+typedef struct Sweep {
+    ConfigInfo        *configs;
+    uint32_t           num_configs;
+    TraceData         *trace;
+    uint32_t           num_workers;
+    uint8_t            pin_cpus;
+    SweepWorker       *workers;
+    _Atomic uint32_t   next_config;     // Next configuration to hand out
+    _Atomic uint32_t   num_finished;    // Configurations reported
+    _Atomic uint32_t   num_running;     // Workers not yet exited
+    _Atomic uint64_t   records_done;    // Summed over all configurations
+    _Atomic int        failed;
+} Sweep;
+
+int sweep_run_parallel (ConfigInfo *configs, uint32_t num_configs,
+                        uint32_t num_workers, uint8_t pin_cpus);
+int sweep_bench        (ConfigInfo *configs, uint32_t num_configs,
+                        uint32_t iterations);
+
+#endif
@@ -0,0 +1,241 @@
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef BOUNCER_THREADS
+#include <pthread.h>
+#endif
+
+#include "debug.h"
+#include "table_mem.h"
+
+/* A live mapped table. */
+typedef struct TableMemRegion {
+    void                  *addr;
+    uint64_t               bytes;
+    uint64_t               map_bytes;   // With the guard page
+    struct TableMemRegion *next;
+} TableMemRegion;
+
+static uint8_t          table_mem_mode = TABLE_MEM_DEFAULT_MODE;
+static uint8_t          table_mem_prefault = 0;
+static TableMemRegion  *table_mem_regions = NULL;
+#ifdef BOUNCER_THREADS
+static pthread_mutex_t  table_mem_lock = PTHREAD_MUTEX_INITIALIZER;
+#define TABLE_MEM_LOCK()    pthread_mutex_lock (&table_mem_lock)
+#define TABLE_MEM_UNLOCK()  pthread_mutex_unlock (&table_mem_lock)
+#else
+#define TABLE_MEM_LOCK()
+#define TABLE_MEM_UNLOCK()
+#endif
+
+/*
+ * Set how the tables allocated from now on are backed. With prefault
+ * every page is touched at allocation, trading startup time for no
+ * page faults during the simulation.
+ */
+void table_mem_configure (uint8_t mode, uint8_t prefault)
+{
+    table_mem_mode = mode;
+    table_mem_prefault = prefault;
+}
+
+/*
+ * Map len bytes aligned to TABLE_MEM_HUGE_PAGE_SIZE followed by a
+ * guard page, the whole length goes to map_bytes. Returns NULL if the
+ * mapping fails.
+ */
+static void *table_mem_map (uint64_t len, int hugetlb, uint64_t *map_bytes)
+{
+    uint64_t page = (uint64_t) sysconf (_SC_PAGESIZE);
+    uint64_t slack = hugetlb ? 0 : TABLE_MEM_HUGE_PAGE_SIZE;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    char *raw, *start;
+    uint64_t head;
+
+    /*
+     * Huge pages are reserved at mmap time, so the mapping fails up
+     * front rather than with SIGBUS on first touch when the pool is
+     * short.
+     */
+    flags |= hugetlb ? MAP_HUGETLB : MAP_NORESERVE;
+
+    raw = (char *) mmap (NULL, len + slack + TABLE_MEM_HUGE_PAGE_SIZE,
+            PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+
+    /* trim to an aligned start, keep one page past the end as guard */
+    start = (char *) (((uintptr_t) raw + TABLE_MEM_HUGE_PAGE_SIZE - 1)
+            & ~((uintptr_t) TABLE_MEM_HUGE_PAGE_SIZE - 1));
+    head = start - raw;
+    if (head > 0) {
+        munmap (raw, head);
+    }
+    if (hugetlb) {
+        // huge page mappings can only be split on huge page boundaries
+        mprotect (start + len, TABLE_MEM_HUGE_PAGE_SIZE, PROT_NONE);
+        *map_bytes = len + TABLE_MEM_HUGE_PAGE_SIZE;
+    } else {
+        munmap (start + len + page, slack + TABLE_MEM_HUGE_PAGE_SIZE
+                - head - page);
+        mprotect (start + len, page, PROT_NONE);
+        madvise (start, len, MADV_HUGEPAGE);
+        *map_bytes = len + page;
+    }
+
+    return start;
+}
+
+/* Zeroed table of bytes, free it with table_mem_free. */
+void *table_mem_alloc (uint64_t bytes)
+{
+    uint64_t len, i;
+    char *addr = NULL;
+    TableMemRegion *region = NULL;
+    static int hugetlb_warned = 0;
+
+    if ((table_mem_mode == TABLE_MEM_CALLOC) || (bytes < TABLE_MEM_MIN_BYTES)) {
+        return calloc (1, bytes);
+    }
+
+    region = (TableMemRegion *) calloc (1, sizeof(TableMemRegion));
+    check (region!=NULL, "failed to allocate table region.");
+
+    len = (bytes + TABLE_MEM_HUGE_PAGE_SIZE - 1)
+        & ~((uint64_t) TABLE_MEM_HUGE_PAGE_SIZE - 1);
+    if (table_mem_mode == TABLE_MEM_HUGETLB) {
+        addr = (char *) table_mem_map (len, 1, &(region->map_bytes));
+        if ((addr == NULL) && !hugetlb_warned) {
+            hugetlb_warned = 1;
+            log_warn ("no explicit huge pages available, "
+                    "using transparent huge pages.");
+        }
+    }
+    if (addr == NULL) {
+        addr = (char *) table_mem_map (len, 0, &(region->map_bytes));
+    }
+    check (addr!=NULL, "failed to map a table of %"PRIu64" bytes.", bytes);
+
+    if (table_mem_prefault) {
+        for (i = 0; i < len; i += 4096) {
+            addr[i] = 0;
+        }
+    }
+
+    region->addr = addr;
+    region->bytes = bytes;
+
+    TABLE_MEM_LOCK();
+    region->next = table_mem_regions;
+    table_mem_regions = region;
+    TABLE_MEM_UNLOCK();
+
+    return addr;
+
+error:
+
+    if (region != NULL) {
+        free (region);
+    }
+
+    return NULL;
+}
+
+/* Unlink and return the region mapped at addr, NULL for calloc tables. */
+static TableMemRegion *table_mem_take (void *addr)
+{
+    TableMemRegion **link, *region = NULL;
+
+    TABLE_MEM_LOCK();
+    for (link = &table_mem_regions; *link != NULL; link = &((*link)->next)) {
+        if ((*link)->addr == addr) {
+            region = *link;
+            *link = region->next;
+            break;
+        }
+    }
+    TABLE_MEM_UNLOCK();
+
+    return region;
+}
+
+void table_mem_free (void *addr)
+{
+    TableMemRegion *region;
+
+    if (addr == NULL) {
+        return;
+    }
+
+    region = table_mem_take (addr);
+    if (region == NULL) {
+        free (addr);
+        return;
+    }
+
+    munmap (region->addr, region->map_bytes);
+    free (region);
+}
+
+/*
+ * Fill usage from the /proc/self/smaps entry of the table at addr.
+ * Returns -1 if addr is not a table or smaps cannot be read.
+ */
+int table_mem_usage (void *addr, TableMemUsage *usage)
+{
+    FILE *fp = NULL;
+    char line[256];
+    unsigned long start, end, kb;
+    int found = 0;
+    TableMemRegion *region;
+
+    memset (usage, 0, sizeof(TableMemUsage));
+
+    TABLE_MEM_LOCK();
+    for (region = table_mem_regions; region != NULL; region = region->next) {
+        if (region->addr == addr) {
+            usage->bytes = region->bytes;
+            usage->mapped = 1;
+            break;
+        }
+    }
+    TABLE_MEM_UNLOCK();
+    if (!usage->mapped) {
+        return -1;
+    }
+
+    fp = fopen ("/proc/self/smaps", "r");
+    check (fp!=NULL, "failed to open /proc/self/smaps.");
+
+    while (fgets (line, sizeof(line), fp) != NULL) {
+        if (sscanf (line, "%lx-%lx ", &start, &end) == 2) {
+            if (found) {
+                break;
+            }
+            found = (start == (unsigned long) addr);
+        } else if (found) {
+            // hugetlb pages only show up in Private_Hugetlb
+            if (sscanf (line, "Rss: %lu kB", &kb) == 1) {
+                usage->rss_bytes += (uint64_t) kb << 10;
+            } else if (sscanf (line, "AnonHugePages: %lu kB", &kb) == 1) {
+                usage->huge_bytes += (uint64_t) kb << 10;
+            } else if (sscanf (line, "Private_Hugetlb: %lu kB", &kb) == 1) {
+                usage->rss_bytes += (uint64_t) kb << 10;
+                usage->huge_bytes += (uint64_t) kb << 10;
+            }
+        }
+    }
+    fclose (fp);
+    check (found, "no smaps entry for table %p.", addr);
+
+    return 0;
+
+error:
+
+    return -1;
+}
@@ -0,0 +1,36 @@
+#ifndef TABLE_MEM_H_
+#define TABLE_MEM_H_
+
+#include <inttypes.h>
+
+/* table_mem_configure mode */
+#define TABLE_MEM_CALLOC            0   // Plain calloc, zeroed up front
+#define TABLE_MEM_THP               1   // mmap, transparent huge pages
+#define TABLE_MEM_HUGETLB           2   // mmap, explicit huge pages
+
+#define TABLE_MEM_DEFAULT_MODE      TABLE_MEM_THP
+#define TABLE_MEM_MIN_BYTES         (1 << 20)   // Smaller tables use calloc
+#define TABLE_MEM_HUGE_PAGE_SIZE    (2 << 20)
+
+/*
+ * Backing for the large tables of the simulated structures. A table
+ * of at least TABLE_MEM_MIN_BYTES is its own anonymous MAP_NORESERVE
+ * mapping, aligned to and advised for huge pages, so it is only
+ * zeroed a page at a time as it is touched. A PROT_NONE guard page
+ * after each mapping keeps the kernel from merging neighbouring
+ * tables, so the RSS and huge page coverage of every table can be
+ * read back from /proc/self/smaps.
+ */
+typedef struct TableMemUsage {
+    uint64_t  bytes;            // Requested
+    uint64_t  rss_bytes;        // Resident
+    uint64_t  huge_bytes;       // Resident in huge pages
+    uint8_t   mapped;           // 0 - came from calloc, no usage known
+} TableMemUsage;
+
+void  table_mem_configure (uint8_t mode, uint8_t prefault);
+void *table_mem_alloc     (uint64_t bytes);
+void  table_mem_free      (void *addr);
+int   table_mem_usage     (void *addr, TableMemUsage *usage);
+
+#endif
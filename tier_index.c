@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "debug.h"
+#include "common.h"
+#include "lru_cache.h"
+#include "table_mem.h"
+#include "tier_index.h"
+
+/*
+ * tiers are caches made by lru_cache_init_unindexed, the index does
+ * not own them.
+ */
+int tier_index_init (LRUCache *tiers[TIER_COUNT], TierIndex *index)
+{
+    uint64_t num_records = 1;   // A new block waits while a victim moves
+    uint32_t i;
+
+    for (i = 0; i < TIER_COUNT; i++) {
+        check (tiers[i]->lookup_table==NULL,
+                "tier %"PRIu32" is already indexed.", i);
+        index->tier[i] = tiers[i];
+        num_records += tiers[i]->cache_size;
+
+        index->owner[i] = (uint32_t *) table_mem_alloc (
+                tiers[i]->cache_size * sizeof(uint32_t));
+        check (index->owner[i]!=NULL,
+                "failed to allocate tier_index->owner.");
+    }
+    check (num_records<TIER_INDEX_NIL, "the tiers are too large to index.");
+
+    index->num_records = num_records;
+    index->record = (TierRecord *) table_mem_alloc (num_records
+            * sizeof(TierRecord));
+    check (index->record!=NULL, "failed to allocate tier_index->record.");
+    for (i = 0; i < num_records; i++) {
+        index->record[i].entry = i + 1;
+        index->record[i].tier = TIER_NONE;
+    }
+    index->record[num_records - 1].entry = TIER_INDEX_NIL;
+    index->free_record = 0;
+
+    index->lookup_table_size = get_lookup_table_size (num_records);
+    index->lookup_table = (TierIndexSlot *) table_mem_alloc (
+            index->lookup_table_size * sizeof(TierIndexSlot));
+    check (index->lookup_table!=NULL,
+            "failed to allocate tier_index->lookup_table.");
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/* Bytes of memory taken by the records, owners and lookup table. */
+uint64_t tier_index_bytes (TierIndex *index)
+{
+    uint64_t bytes = index->num_records * sizeof(TierRecord)
+            + index->lookup_table_size * sizeof(TierIndexSlot);
+    uint32_t i;
+
+    for (i = 0; i < TIER_COUNT; i++) {
+        bytes += index->tier[i]->cache_size * sizeof(uint32_t);
+    }
+
+    return bytes;
+}
+
+/* returns the record of key, or TIER_INDEX_NIL if no tier holds it. */
+uint32_t tier_index_find (TierIndex *index, BlockKey key)
+{
+    uint32_t hash = (uint32_t) hash_u64 (key);
+    uint64_t mask = index->lookup_table_size - 1;
+    uint64_t i    = hash & mask;
+    uint64_t dist = 0;
+    TierIndexSlot *slot;
+
+    while (1) {
+        slot = &(index->lookup_table[i]);
+        if (slot->record == 0) {
+            return TIER_INDEX_NIL;
+        }
+        if ((slot->hash == hash)
+                && (index->record[slot->record - 1].key == key)) {
+            return slot->record - 1;
+        }
+        /* key would have taken this slot from a richer one */
+        if (((i - slot->hash) & mask) < dist) {
+            return TIER_INDEX_NIL;
+        }
+        i = (i + 1) & mask;
+        dist += 1;
+    }
+}
+
+/* Prefetch the home slots of requests that are about to be looked up. */
+void tier_index_prefetch_batch (const TierIndex *index, const Request *reqs,
+        uint32_t num_reqs)
+{
+    uint64_t mask = index->lookup_table_size - 1;
+    uint32_t i, hash;
+
+    for (i = 0; i < num_reqs; i++) {
+        hash = (uint32_t) hash_u64 (request_key (&(reqs[i])));
+        __builtin_prefetch (&(index->lookup_table[hash & mask]), 1);
+    }
+}
+
+/*
+ * Index key, which must not be indexed yet, under a new detached
+ * record and return the record.
+ */
+uint32_t tier_index_add (TierIndex *index, BlockKey key)
+{
+    uint64_t mask = index->lookup_table_size - 1;
+    uint64_t dist = 0, slot_dist, i;
+    uint32_t record = index->free_record;
+    TierIndexSlot curr, tmp;
+
+    index->free_record = index->record[record].entry;
+    index->record[record].key = key;
+    index->record[record].entry = LRU_CACHE_NIL;
+    index->record[record].tier = TIER_NONE;
+
+    curr.hash = (uint32_t) hash_u64 (key);
+    curr.record = record + 1;
+    i = curr.hash & mask;
+
+    while (index->lookup_table[i].record != 0) {
+        slot_dist = (i - index->lookup_table[i].hash) & mask;
+        if (slot_dist < dist) {
+            tmp = index->lookup_table[i];
+            index->lookup_table[i] = curr;
+            curr = tmp;
+            dist = slot_dist;
+        }
+        i = (i + 1) & mask;
+        dist += 1;
+    }
+    index->lookup_table[i] = curr;
+
+    return record;
+}
+
+/*
+ * Put the detached record at the LRU head of tier. Returns the record
+ * whose block that replaced, detached in turn, or TIER_INDEX_NIL.
+ */
+uint32_t tier_index_insert (TierIndex *index, uint32_t record, uint8_t tier)
+{
+    uint32_t *owner = index->owner[tier];
+    LRUCacheHandle ind;
+    uint32_t victim = TIER_INDEX_NIL;
+
+    if (lru_cache_insert_handle (index->tier[tier], index->record[record].key,
+                &ind) == 1) {
+        victim = owner[ind];
+        index->record[victim].entry = LRU_CACHE_NIL;
+        index->record[victim].tier = TIER_NONE;
+    }
+
+    owner[ind] = record;
+    index->record[record].entry = ind;
+    index->record[record].tier = tier;
+
+    return victim;
+}
+
+/* Take the block of record out of its tier, keeping it indexed. */
+void tier_index_detach (TierIndex *index, uint32_t record)
+{
+    TierRecord *rec = &(index->record[record]);
+    uint32_t *owner = index->owner[rec->tier];
+    LRUCacheHandle moved;
+
+    moved = lru_cache_remove_handle (index->tier[rec->tier], rec->entry);
+    if (moved != LRU_CACHE_NIL) {
+        owner[rec->entry] = owner[moved];
+        index->record[owner[moved]].entry = rec->entry;
+    }
+
+    rec->entry = LRU_CACHE_NIL;
+    rec->tier = TIER_NONE;
+}
+
+/* Unindex a detached record and free it. */
+void tier_index_drop (TierIndex *index, uint32_t record)
+{
+    uint64_t mask = index->lookup_table_size - 1;
+    uint64_t i    = hash_u64 (index->record[record].key) & mask;
+    uint64_t next;
+
+    /* a record has a single slot, no need to compare keys */
+    while (index->lookup_table[i].record != record + 1) {
+        i = (i + 1) & mask;
+    }
+
+    /* shift the rest of the probe run back by one */
+    next = (i + 1) & mask;
+    while ((index->lookup_table[next].record != 0)
+            && ((index->lookup_table[next].hash & mask) != next)) {
+        index->lookup_table[i] = index->lookup_table[next];
+        i = next;
+        next = (next + 1) & mask;
+    }
+    index->lookup_table[i].record = 0;
+
+    index->record[record].entry = index->free_record;
+    index->free_record = record;
+}
+
+void tier_index_destroy (TierIndex *index)
+{
+    uint32_t i;
+
+    for (i = 0; i < TIER_COUNT; i++) {
+        if (index->owner[i] != NULL) {
+            table_mem_free (index->owner[i]);
+        }
+    }
+
+    if (index->record != NULL) {
+        table_mem_free (index->record);
+    }
+
+    if (index->lookup_table != NULL) {
+        table_mem_free (index->lookup_table);
+    }
+
+    free (index);
+}
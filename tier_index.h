@@ -0,0 +1,72 @@
+#ifndef TIER_INDEX_H_
+#define TIER_INDEX_H_
+
+#include "common.h"
+#include "lru_cache.h"
+
+/* TierRecord tier */
+#define TIER_S_WB           0   // Sieved write buffer
+#define TIER_TR_WB          1   // Traditional write buffer
+#define TIER_SSD            2   // SSD cache
+#define TIER_COUNT          3
+#define TIER_NONE           UINT8_MAX   // Detached from every tier
+
+#define TIER_INDEX_NIL      UINT32_MAX  // No record
+
+/*
+ * The block of a record sits in one tier at a time; entry is its LRU
+ * entry there. Free records are linked through entry.
+ */
+typedef struct TierRecord {
+    BlockKey  key;
+    uint32_t  entry;
+    uint8_t   tier;
+} TierRecord;
+
+/*
+ * Robin Hood slot, hash is the low half of hash_u64(key). record is
+ * kept one up so that a zeroed table is empty.
+ */
+typedef struct TierIndexSlot {
+    uint32_t  hash;
+    uint32_t  record;           // Record + 1, 0 - empty slot
+} TierIndexSlot;
+
+/*
+ * One lookup table over the blocks of the sieved write buffer, the
+ * traditional write buffer and the SSD cache. The tiers keep their
+ * LRU order in caches without lookup tables of their own, and owner
+ * maps each of their entries back to its record, so a block is found
+ * with a single probe whichever tier it is in, and moving it to
+ * another tier relinks LRU entries without touching the table.
+ */
+typedef struct TierIndex {
+    LRUCache       *tier[TIER_COUNT];
+    uint32_t       *owner[TIER_COUNT];  // Record of each LRU entry
+    TierRecord     *record;
+    uint32_t        num_records;
+    uint32_t        free_record;        // Head of the free list
+    TierIndexSlot  *lookup_table;
+    uint64_t        lookup_table_size;  // Power of 2
+} TierIndex;
+
+int      tier_index_init    (LRUCache *tiers[TIER_COUNT], TierIndex *index);
+uint64_t tier_index_bytes   (TierIndex *index);
+uint32_t tier_index_find    (TierIndex *index, BlockKey key);
+void     tier_index_prefetch_batch (const TierIndex *index,
+        const Request *reqs, uint32_t num_reqs);
+uint32_t tier_index_add     (TierIndex *index, BlockKey key);
+uint32_t tier_index_insert  (TierIndex *index, uint32_t record, uint8_t tier);
+void     tier_index_detach  (TierIndex *index, uint32_t record);
+void     tier_index_drop    (TierIndex *index, uint32_t record);
+void     tier_index_destroy (TierIndex *index);
+
+/* Move the block of record to the LRU head of its tier. */
+static inline void tier_index_touch (TierIndex *index, uint32_t record)
+{
+    TierRecord *rec = &(index->record[record]);
+
+    lru_cache_touch (index->tier[rec->tier], rec->entry);
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "timer_wheel.h"
+
+int timer_wheel_init (uint8_t num_sub_windows, TimerWheel *wheel)
+{
+    uint32_t i;
+
+    check (num_sub_windows > 0, "timer wheel needs at least 1 sub window.");
+    wheel->num_buckets         = num_sub_windows;
+    wheel->curr_sub_window_ind = 0;
+    wheel->num_expired         = 0;
+    wheel->buckets = (TimerWheelNode *) malloc (num_sub_windows
+            * sizeof(TimerWheelNode));
+    check (wheel->buckets!=NULL, "failed to allocate wheel->buckets.");
+
+    for (i = 0; i < num_sub_windows; i++) {
+        wheel->buckets[i].prev = &(wheel->buckets[i]);
+        wheel->buckets[i].next = &(wheel->buckets[i]);
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Move the wheel to sub_window_ind and return the nodes that expired
+ * on the way, linked through next and already off the wheel. Entering
+ * sub window w expires bucket w % num_buckets, which holds the nodes
+ * last touched in w - num_buckets, so the cost is the number of
+ * expired nodes plus at most num_buckets buckets.
+ */
+TimerWheelNode *timer_wheel_advance (TimerWheel *wheel, uint32_t sub_window_ind)
+{
+    uint32_t steps, i;
+    TimerWheelNode *expired = NULL;
+    TimerWheelNode *head, *node, *next;
+
+    if ((int32_t) (sub_window_ind - wheel->curr_sub_window_ind) <= 0) {
+        return NULL;
+    }
+
+    steps = sub_window_ind - wheel->curr_sub_window_ind;
+    if (steps > wheel->num_buckets) {
+        steps = wheel->num_buckets;
+    }
+
+    for (i = 1; i <= steps; i++) {
+        head = &(wheel->buckets[(wheel->curr_sub_window_ind + i)
+                % wheel->num_buckets]);
+        node = head->next;
+        while (node != head) {
+            next = node->next;
+            node->prev = NULL;
+            node->next = expired;
+            expired = node;
+            wheel->num_expired += 1;
+            node = next;
+        }
+        head->prev = head;
+        head->next = head;
+    }
+
+    wheel->curr_sub_window_ind = sub_window_ind;
+
+    return expired;
+}
+
+void timer_wheel_destroy (TimerWheel *wheel)
+{
+    if (wheel->buckets != NULL) {
+        free (wheel->buckets);
+        wheel->buckets = NULL;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/*
+ * Expiration of windowed entries. Every entry embeds a TimerWheelNode
+ * and is filed under the sub window of its last access; an entry
+ * expires once num_sub_windows sub windows have passed without an
+ * access, and advancing the wheel hands back exactly those entries.
+ */
+typedef struct TimerWheelNode {
+    struct TimerWheelNode *prev;        // NULL - not on the wheel
+    struct TimerWheelNode *next;        // Also links the expired list
+} TimerWheelNode;
+
+typedef struct TimerWheel {
+    uint8_t          num_buckets;       // One per sub window
+    uint32_t         curr_sub_window_ind;
+    uint64_t         num_expired;
+    TimerWheelNode  *buckets;           // Circular list heads
+} TimerWheel;
+
+/* Entry holding the node, like the kernel's container_of. */
+#define TIMER_WHEEL_ENTRY(node, type, member) \
+    ((type *) ((char *) (node) - offsetof(type, member)))
+
+int  timer_wheel_init     (uint8_t num_sub_windows, TimerWheel *wheel);
+TimerWheelNode *timer_wheel_advance (TimerWheel *wheel,
+        uint32_t sub_window_ind);
+void timer_wheel_destroy  (TimerWheel *wheel);
+
+static inline void timer_wheel_remove (TimerWheelNode *node)
+{
+    if (node->prev != NULL) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = NULL;
+        node->next = NULL;
+    }
+}
+
+/* File node under the current sub window of the wheel. */
+static inline void timer_wheel_touch (TimerWheel *wheel, TimerWheelNode *node)
+{
+    TimerWheelNode *head = &(wheel->buckets[wheel->curr_sub_window_ind
+            % wheel->num_buckets]);
+
+    timer_wheel_remove (node);
+    node->prev = head;
+    node->next = head->next;
+    head->next->prev = node;
+    head->next = node;
+}
+
+#endif
@@ -0,0 +1,691 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "debug.h"
+#include "common.h"
+#include "trace.h"
+#include "volume_dict.h"
+
+#define BYTES_ONES      0x0101010101010101ULL
+#define BYTES_HIGHS     0x8080808080808080ULL
+#define BYTES_LOW_NIB   0x0F0F0F0F0F0F0F0FULL
+#define BYTES_HIGH_NIB  0xF0F0F0F0F0F0F0F0ULL
+
+/* Record of a version 1 binary trace, see TraceFileHeader. */
+typedef struct TraceRecordV1 {
+    uint64_t timestamp;
+    uint64_t start_block;
+    uint32_t num_blocks;
+    uint8_t  server_num;
+    uint8_t  volume_num;
+    uint8_t  req_type;
+    uint8_t  reserved;
+} TraceRecordV1;
+
+#define TRACE_BINARY_V1_HEADER_SIZE offsetof(TraceFileHeader, num_volumes)
+
+static const uint64_t pow10_table[9] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+/*
+ * Load up to 8 bytes at p, bytes at or past end read as zero. The
+ * parser works on 8 byte words and zero is neither a digit nor a
+ * blank, so it terminates whatever is being scanned.
+ */
+static inline uint64_t load_word (const char *p, const char *end)
+{
+    uint64_t word = 0;
+
+    if (end - p >= 8) {
+        memcpy (&word, p, 8);
+    } else if (end > p) {
+        memcpy (&word, p, end - p);
+    }
+
+    return word;
+}
+
+/* Set the high bit of every byte of x that is not zero. */
+static inline uint64_t nonzero_bytes (uint64_t x)
+{
+    return ((((x & ~BYTES_HIGHS) + ~BYTES_HIGHS) | x) & BYTES_HIGHS);
+}
+
+/* Set the high bit of every byte of word that is not an ASCII digit. */
+static inline uint64_t non_digit_bytes (uint64_t word)
+{
+    uint64_t high_nib, high_nib_plus_6;
+
+    // digits are the bytes whose high nibble is 3 before and after adding 6
+    high_nib = (word & BYTES_HIGH_NIB) ^ (0x30 * BYTES_ONES);
+    high_nib_plus_6 = (((word & ~BYTES_HIGHS) + (0x06 * BYTES_ONES))
+            & BYTES_HIGH_NIB) ^ (0x30 * BYTES_ONES);
+
+    return (nonzero_bytes(high_nib | high_nib_plus_6) | (word & BYTES_HIGHS));
+}
+
+/* Set the high bit of every byte of word that is a space, tab or CR. */
+static inline uint64_t blank_bytes (uint64_t word)
+{
+    return ((nonzero_bytes(word ^ (' ' * BYTES_ONES))
+            & nonzero_bytes(word ^ ('\t' * BYTES_ONES))
+            & nonzero_bytes(word ^ ('\r' * BYTES_ONES))) ^ BYTES_HIGHS);
+}
+
+/*
+ * Convert 8 ASCII digits, most significant digit in the lowest byte,
+ * with three multiplies instead of a loop.
+ */
+static inline uint64_t convert_8_digits (uint64_t word)
+{
+    word = (word & BYTES_LOW_NIB);
+    word = (word * 10) + (word >> 8);
+    word = (((word & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+            + (((word >> 16) & 0x000000FF000000FFULL)
+            * (1 + (10000ULL << 32)))) >> 32;
+
+    return word;
+}
+
+static inline const char *skip_blanks (const char *p, const char *end)
+{
+    uint64_t non_blank;
+
+    while (p < end) {
+        non_blank = blank_bytes(load_word(p, end)) ^ BYTES_HIGHS;
+        if (non_blank != 0) {
+            p += (__builtin_ctzll(non_blank) >> 3);
+            return (p < end) ? p : end;
+        }
+        p += 8;
+    }
+
+    return end;
+}
+
+static inline const char *skip_token (const char *p, const char *end)
+{
+    uint64_t blank;
+
+    while (p < end) {
+        blank = blank_bytes(load_word(p, end));
+        if (blank != 0) {
+            p += (__builtin_ctzll(blank) >> 3);
+            return (p < end) ? p : end;
+        }
+        p += 8;
+    }
+
+    return end;
+}
+
+/*
+ * Parse an unsigned decimal at p, up to 8 digits per step. Returns
+ * the first byte after the number, or NULL if p is not a digit.
+ */
+static inline const char *parse_uint (const char *p, const char *end,
+        uint64_t *value)
+{
+    const char *start = p;
+    uint64_t word, non_digit, result = 0;
+    uint32_t num_digits;
+
+    do {
+        word = load_word (p, end);
+        non_digit = non_digit_bytes (word);
+        num_digits = (non_digit != 0) ? (__builtin_ctzll(non_digit) >> 3) : 8;
+        if (num_digits == 0) {
+            break;
+        }
+        // right align the digits, the vacated low bytes act as leading zeros
+        word <<= ((8 - num_digits) << 3);
+        result = (result * pow10_table[num_digits]) + convert_8_digits(word);
+        p += num_digits;
+    } while (num_digits == 8);
+
+    *value = result;
+
+    return (p != start) ? p : NULL;
+}
+
+/*
+ * Return the first '\n' in [p, end), or end if there is none. The
+ * search compares 32 (AVX2) or 16 (SSE2) bytes at a time.
+ */
+const char *trace_find_line_end (const char *p, const char *end)
+{
+#ifdef __AVX2__
+    const __m256i newline_32 = _mm256_set1_epi8('\n');
+    uint32_t mask_32;
+
+    while (end - p >= 32) {
+        mask_32 = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *) p), newline_32));
+        if (mask_32 != 0) {
+            return (p + __builtin_ctz(mask_32));
+        }
+        p += 32;
+    }
+#endif
+#ifdef __SSE2__
+    const __m128i newline_16 = _mm_set1_epi8('\n');
+    uint32_t mask_16;
+
+    while (end - p >= 16) {
+        mask_16 = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *) p), newline_16));
+        if (mask_16 != 0) {
+            return (p + __builtin_ctz(mask_16));
+        }
+        p += 16;
+    }
+
+    while ((p < end) && (*p != '\n')) {
+        p++;
+    }
+
+    return p;
+#else
+    p = memchr (p, '\n', end - p);
+
+    return (p != NULL) ? p : end;
+#endif
+}
+
+/*
+ * Convert one whitespace separated trace line in [line, end)
+ *
+ *   timestamp server volume Read|Write start_addr req_size duration
+ *
+ * into a TraceRecord in block units. The request type is classified
+ * by its first byte only. The server and volume go to volume as one
+ * volume_dict_raw () word, record->volume_id is left for the caller
+ * to fill from its VolumeDict.
+ *
+ * Return values:
+ *      1  -  a record is returned
+ *      0  -  blank line
+ *     -1  -  on error
+ */
+int trace_parse_line (const char *line, const char *end, TraceRecord *record,
+        uint64_t *volume)
+{
+    const char *p;
+    uint64_t timestamp, server_num, volume_num, start_addr, req_size;
+    uint64_t duration;
+    uint8_t req_type;
+
+    p = skip_blanks (line, end);
+    if (p == end) {
+        return 0;
+    }
+
+    p = parse_uint (p, end, &timestamp);
+    check (p!=NULL, "bad timestamp field.");
+    p = parse_uint (skip_blanks(p, end), end, &server_num);
+    check (p!=NULL, "bad server field.");
+    p = parse_uint (skip_blanks(p, end), end, &volume_num);
+    check (p!=NULL, "bad volume field.");
+    check ((server_num <= UINT32_MAX) && (volume_num <= UINT32_MAX),
+            "server or volume number past 32 bits.");
+
+    p = skip_blanks (p, end);
+    check (p!=end, "missing request type field.");
+    req_type = (*p == 'W');
+    p = skip_token (p, end);
+
+    p = parse_uint (skip_blanks(p, end), end, &start_addr);
+    check (p!=NULL, "bad start address field.");
+    p = parse_uint (skip_blanks(p, end), end, &req_size);
+    check (p!=NULL, "bad request size field.");
+    p = parse_uint (skip_blanks(p, end), end, &duration);
+    check (p!=NULL, "bad duration field.");
+
+    *volume = volume_dict_raw ((uint32_t) server_num, (uint32_t) volume_num);
+
+    memset (record, 0, sizeof(TraceRecord));
+    record->timestamp   = timestamp;
+    record->start_block = (start_addr >> LOG_2_BLOCK_SIZE);
+    record->num_blocks  = (uint32_t) (req_size >> LOG_2_BLOCK_SIZE);
+    if (record->num_blocks == 0) {
+        record->num_blocks = 1;
+    }
+    // binary traces are written from parsed lines, so this covers them
+    check (block_key_range_fits (record->start_block, record->num_blocks),
+            "block numbers past %d bits do not fit a block key.",
+            BLOCK_KEY_BLOCK_BITS);
+    record->req_type    = req_type;
+
+    return 1;
+
+error:
+
+    return -1;
+}
+
+/* mmap the whole trace file, an empty file is left unmapped. */
+static int trace_reader_map (char *trace_file, TraceReader *reader)
+{
+    int fd = -1;
+    struct stat st;
+
+    fd = open (trace_file, O_RDONLY);
+    check (fd!=-1, "failed to open trace file: %s", trace_file);
+    check (fstat(fd, &st)==0, "failed to stat trace file: %s", trace_file);
+
+    reader->map_size = st.st_size;
+    if (reader->map_size > 0) {
+        reader->map_addr = mmap (NULL, reader->map_size, PROT_READ,
+                MAP_PRIVATE, fd, 0);
+        check (reader->map_addr!=MAP_FAILED, "failed to mmap trace file: %s",
+                trace_file);
+        madvise (reader->map_addr, reader->map_size, MADV_SEQUENTIAL);
+    }
+    close (fd);
+    fd = -1;
+
+    return 0;
+
+error:
+
+    if (fd != -1) {
+        close (fd);
+    }
+    reader->map_addr = NULL;
+
+    return -1;
+}
+
+/*
+ * Convert the records of a version 1 trace into reader->converted,
+ * giving their server and volume numbers ids in order of appearance.
+ */
+static int trace_reader_convert_v1 (TraceReader *reader,
+        const TraceRecordV1 *old, uint64_t num_records)
+{
+    uint64_t i;
+    TraceRecord *record;
+
+    if (num_records > 0) {
+        reader->converted = (TraceRecord *) calloc (num_records,
+                sizeof(TraceRecord));
+        check (reader->converted!=NULL, "failed to allocate %"PRIu64
+                " trace records.", num_records);
+    }
+
+    for (i = 0; i < num_records; i++) {
+        record = &(reader->converted[i]);
+        record->timestamp   = old[i].timestamp;
+        record->start_block = old[i].start_block;
+        record->num_blocks  = old[i].num_blocks;
+        record->req_type    = old[i].req_type;
+        record->volume_id   = volume_dict_id (reader->volumes,
+                volume_dict_raw (old[i].server_num, old[i].volume_num));
+        check (record->volume_id!=VOLUME_DICT_NIL,
+                "failed to map the volume of record %"PRIu64".", i);
+        check (block_key_range_fits (record->start_block, record->num_blocks),
+                "block numbers of record %"PRIu64" past %d bits do not "
+                "fit a block key.", i, BLOCK_KEY_BLOCK_BITS);
+    }
+
+    reader->records     = reader->converted;
+    reader->num_records = num_records;
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+static int trace_reader_check_binary (char *trace_file, TraceReader *reader)
+{
+    TraceFileHeader *header = NULL;
+    const TraceFileVolume *volumes;
+    uint64_t body_size, i;
+
+    check (reader->map_size>=TRACE_BINARY_V1_HEADER_SIZE,
+            "truncated binary trace file: %s", trace_file);
+
+    header = (TraceFileHeader *) reader->map_addr;
+    if (header->version == 1) {
+        check (header->record_size==sizeof(TraceRecordV1),
+                "unexpected binary trace record size: %"PRIu32"",
+                header->record_size);
+        check (header->num_records <= (reader->map_size
+                - TRACE_BINARY_V1_HEADER_SIZE) / sizeof(TraceRecordV1),
+                "truncated binary trace file: %s", trace_file);
+        return trace_reader_convert_v1 (reader, (const TraceRecordV1 *)
+                ((char *) header + TRACE_BINARY_V1_HEADER_SIZE),
+                header->num_records);
+    }
+
+    check (header->version==TRACE_BINARY_VERSION,
+            "unsupported binary trace version: %"PRIu32"", header->version);
+    check (reader->map_size>=sizeof(TraceFileHeader),
+            "truncated binary trace file: %s", trace_file);
+    check (header->record_size==sizeof(TraceRecord),
+            "unexpected binary trace record size: %"PRIu32"",
+            header->record_size);
+    body_size = reader->map_size - sizeof(TraceFileHeader);
+    check (header->num_records <= body_size / sizeof(TraceRecord),
+            "truncated binary trace file: %s", trace_file);
+    check (header->num_volumes <= (body_size - header->num_records
+            * sizeof(TraceRecord)) / sizeof(TraceFileVolume),
+            "truncated binary trace file: %s", trace_file);
+
+    reader->records     = (TraceRecord *) (header + 1);
+    reader->num_records = header->num_records;
+
+    volumes = (const TraceFileVolume *) (reader->records
+            + reader->num_records);
+    for (i = 0; i < header->num_volumes; i++) {
+        check (volume_dict_id (reader->volumes, volume_dict_raw (
+                        volumes[i].server_num, volumes[i].volume_num))==i,
+                "bad volume dictionary in binary trace file: %s", trace_file);
+    }
+
+    // the records are used as mapped, hold them to what a conversion checks
+    for (i = 0; i < reader->num_records; i++) {
+        check (reader->records[i].volume_id<header->num_volumes,
+                "unknown volume id %"PRIu32" in record %"PRIu64" of binary "
+                "trace file: %s", reader->records[i].volume_id, i, trace_file);
+        check (block_key_range_fits (reader->records[i].start_block,
+                    reader->records[i].num_blocks),
+                "block numbers of record %"PRIu64" past %d bits do not "
+                "fit a block key.", i, BLOCK_KEY_BLOCK_BITS);
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Binary traces are recognized by their magic number, anything
+ * else is read as a text trace. With map_text set, text traces are
+ * mmap'ed whole instead of being read () through the buffer.
+ */
+static int trace_reader_open_file (char *trace_file, TraceReader *reader,
+        int map_text)
+{
+    int ret;
+    char magic[sizeof(((TraceFileHeader *)0)->magic)];
+    ssize_t len;
+
+    reader->num_lines = 0;
+
+    reader->volumes = (VolumeDict *) calloc (1, sizeof(VolumeDict));
+    check (reader->volumes!=NULL, "failed to allocate volume dictionary.");
+    ret = volume_dict_init (reader->volumes);
+    check (ret==0, "failed to initialize volume dictionary.");
+
+    reader->fd = open (trace_file, O_RDONLY);
+    check (reader->fd!=-1, "failed to open trace file: %s", trace_file);
+
+    len = pread (reader->fd, magic, sizeof(magic), 0);
+    check (len!=-1, "failed to read trace file: %s", trace_file);
+    if ((len == sizeof(magic))
+            && (memcmp(magic, TRACE_BINARY_MAGIC, sizeof(magic)) == 0)) {
+        reader->format = TRACE_FORMAT_BINARY;
+    } else {
+        reader->format = TRACE_FORMAT_TEXT;
+    }
+
+    if ((reader->format == TRACE_FORMAT_BINARY) || map_text) {
+        close (reader->fd);
+        reader->fd = -1;
+        ret = trace_reader_map (trace_file, reader);
+        check (ret==0, "failed to map trace file: %s", trace_file);
+    }
+
+    if (reader->format == TRACE_FORMAT_BINARY) {
+        return trace_reader_check_binary (trace_file, reader);
+    }
+
+    if (map_text) {
+        // the whole file is one buffer that has already hit eof
+        reader->buffer = (char *) reader->map_addr;
+        reader->buffer_len = reader->map_size;
+        reader->buffer_pos = 0;
+        reader->eof = 1;
+        return 0;
+    }
+
+    reader->buffer = (char *) calloc (1, TRACE_READ_BUFFER_SIZE
+            + TRACE_READ_BUFFER_PAD);
+    check (reader->buffer!=NULL, "failed to allocate trace read buffer.");
+    reader->buffer_len = 0;
+    reader->buffer_pos = 0;
+    reader->eof = 0;
+
+    posix_fadvise (reader->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+int trace_reader_open (char *trace_file, TraceReader *reader)
+{
+    return trace_reader_open_file (trace_file, reader, 0);
+}
+
+/*
+ * Like trace_reader_open (), but a text trace is mmap'ed as well so
+ * that it can be parsed in place (buffer, buffer_len) by several
+ * threads.
+ */
+int trace_reader_open_mapped (char *trace_file, TraceReader *reader)
+{
+    return trace_reader_open_file (trace_file, reader, 1);
+}
+
+/*
+ * Move the unparsed tail of the buffer to the front and fill the
+ * rest with the next chunk of the file.
+ */
+static int trace_reader_fill (TraceReader *reader)
+{
+    size_t remain;
+    ssize_t len;
+
+    remain = reader->buffer_len - reader->buffer_pos;
+    check (remain<TRACE_READ_BUFFER_SIZE, "trace line %"PRIu64" is too long.",
+            reader->num_lines + 1);
+    memmove (reader->buffer, reader->buffer + reader->buffer_pos, remain);
+    reader->buffer_len = remain;
+    reader->buffer_pos = 0;
+
+    do {
+        len = read (reader->fd, reader->buffer + reader->buffer_len,
+                TRACE_READ_BUFFER_SIZE - reader->buffer_len);
+    } while ((len == -1) && (errno == EINTR));
+    check (len!=-1, "failed to read trace file.");
+
+    if (len == 0) {
+        reader->eof = 1;
+    }
+    reader->buffer_len += len;
+    memset (reader->buffer + reader->buffer_len, 0, TRACE_READ_BUFFER_PAD);
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/* Return values:
+ *      1  -  a record is returned
+ *      0  -  end of trace
+ *     -1  -  on error
+ */
+int trace_reader_next (TraceReader *reader, TraceRecord *record)
+{
+    int ret;
+    const char *line, *line_end, *buffer_end;
+    uint64_t volume;
+
+    if (reader->format == TRACE_FORMAT_BINARY) {
+        if (reader->num_lines == reader->num_records) {
+            return 0;
+        }
+        *record = reader->records[reader->num_lines];
+        reader->num_lines += 1;
+        return 1;
+    }
+
+    while (1) {
+        line = reader->buffer + reader->buffer_pos;
+        buffer_end = reader->buffer + reader->buffer_len;
+        line_end = trace_find_line_end (line, buffer_end);
+
+        if ((line_end == buffer_end) && !reader->eof) {
+            // partial line, read more of the file
+            ret = trace_reader_fill (reader);
+            check (ret==0, "failed to fill trace read buffer.");
+            continue;
+        }
+
+        if (line == buffer_end) {
+            return 0;
+        }
+
+        reader->buffer_pos = (line_end - reader->buffer)
+            + (line_end != buffer_end);
+
+        ret = trace_parse_line (line, line_end, record, &volume);
+        check (ret!=-1, "failed to parse trace line %"PRIu64":\n\t%.*s",
+                reader->num_lines + 1, (int) (line_end - line), line);
+        if (ret == 1) {
+            break;
+        }
+    }
+    record->volume_id = volume_dict_id (reader->volumes, volume);
+    check (record->volume_id!=VOLUME_DICT_NIL,
+            "failed to map the volume of trace line %"PRIu64".",
+            reader->num_lines + 1);
+    reader->num_lines += 1;
+
+    return 1;
+
+error:
+
+    return -1;
+}
+
+void trace_reader_destroy (TraceReader *reader)
+{
+    if (reader->fd > 0) {
+        close (reader->fd);
+    }
+
+    if ((reader->buffer != NULL) && (reader->buffer != reader->map_addr)) {
+        free (reader->buffer);
+    }
+
+    if (reader->map_addr != NULL) {
+        munmap (reader->map_addr, reader->map_size);
+    }
+
+    if (reader->converted != NULL) {
+        free (reader->converted);
+    }
+
+    if (reader->volumes != NULL) {
+        volume_dict_destroy (reader->volumes);
+    }
+
+    free (reader);
+}
+
+int trace_data_load (char *trace_file, TraceData *data)
+{
+    int ret;
+    uint64_t capacity = 0;
+    TraceRecord record, *records;
+
+    data->reader = (TraceReader *) calloc (1, sizeof(TraceReader));
+    check (data->reader!=NULL, "failed to allocate trace reader.");
+    ret = trace_reader_open (trace_file, data->reader);
+    check (ret==0, "failed to open trace file: %s", trace_file);
+
+    if (data->reader->format == TRACE_FORMAT_BINARY) {
+        data->records = data->reader->records;
+        data->num_records = data->reader->num_records;
+        data->owns_records = 0;
+        data->volumes = data->reader->volumes;
+        data->reader->volumes = NULL;
+        // replayed from many offsets at once, not one sequential scan
+        if (data->reader->map_addr != NULL) {
+            madvise (data->reader->map_addr, data->reader->map_size,
+                    MADV_WILLNEED);
+        }
+    } else {
+        data->owns_records = 1;
+        data->num_records = 0;
+        while ((ret = trace_reader_next(data->reader, &record)) == 1) {
+            if (data->num_records == capacity) {
+                capacity = (capacity == 0) ? (1 << 20) : (capacity << 1);
+                records = (TraceRecord *) realloc (data->records,
+                        capacity * sizeof(TraceRecord));
+                check (records!=NULL, "failed to allocate %"PRIu64
+                        " trace records.", capacity);
+                data->records = records;
+            }
+            data->records[data->num_records] = record;
+            data->num_records += 1;
+        }
+        check (ret==0, "failed to read trace file: %s", trace_file);
+
+        data->volumes = data->reader->volumes;
+        data->reader->volumes = NULL;
+        trace_reader_destroy (data->reader);
+        data->reader = NULL;
+    }
+
+    data->starting_time_stamp = (data->num_records > 0) ?
+        data->records[0].timestamp : 0;
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+void trace_data_destroy (TraceData *data)
+{
+    if (data->owns_records && (data->records != NULL)) {
+        free (data->records);
+    }
+
+    if (data->reader != NULL) {
+        trace_reader_destroy (data->reader);
+    }
+
+    if (data->volumes != NULL) {
+        volume_dict_destroy (data->volumes);
+    }
+
+    free (data);
+}
@@ -0,0 +1,89 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include "common.h"
+#include "volume_dict.h"
+
+#define TRACE_FORMAT_TEXT           0
+#define TRACE_FORMAT_BINARY         1
+
+#define TRACE_BINARY_MAGIC          "BNCRTRC\n"
+#define TRACE_BINARY_VERSION        2
+
+/*
+ * Text traces are read () into a buffer of this size, a partial line
+ * at the end of the buffer is carried over into the next read.
+ */
+#define TRACE_READ_BUFFER_SIZE      (4 << 20)
+/* zeroed slack after the data so the parser can load 8 bytes at a time */
+#define TRACE_READ_BUFFER_PAD       16
+
+/*
+ * Binary trace file layout: one TraceFileHeader followed by
+ * num_records fixed size TraceRecord entries in trace order, then
+ * the volume dictionary as num_volumes TraceFileVolume entries in id
+ * order. Version 1 files end their header before num_volumes, have
+ * no dictionary and carry 8 bit server and volume numbers in their
+ * records instead of a volume id; they are converted when opened.
+ */
+typedef struct TraceFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t num_records;
+    uint64_t num_volumes;
+} TraceFileHeader;
+
+typedef struct TraceFileVolume {
+    uint32_t server_num;
+    uint32_t volume_num;
+} TraceFileVolume;
+
+typedef struct TraceReader {
+    uint8_t       format;
+    uint64_t      num_lines;        // The number of records handed out so far
+    /* text format */
+    int           fd;
+    char         *buffer;
+    size_t        buffer_len;       // Valid bytes in buffer
+    size_t        buffer_pos;       // First byte not parsed yet
+    int           eof;
+    /* binary format */
+    void         *map_addr;
+    size_t        map_size;
+    TraceRecord  *records;
+    uint64_t      num_records;
+    TraceRecord  *converted;        // Records of a version 1 file, or NULL
+    /*
+     * Volume ids of the records handed out. Binary traces load it
+     * whole, text traces grow it as lines are read.
+     */
+    VolumeDict   *volumes;
+} TraceReader;
+
+/*
+ * A whole trace held as TraceRecords so that several simulations can
+ * replay it at once. Binary traces stay mapped through reader, text
+ * traces are parsed once into a records array of our own.
+ */
+typedef struct TraceData {
+    TraceReader  *reader;
+    TraceRecord  *records;
+    uint64_t      num_records;
+    uint64_t      starting_time_stamp;  // Timestamp of the first record
+    uint8_t       owns_records;
+    VolumeDict   *volumes;              // Taken over from reader
+} TraceData;
+
+int  trace_reader_open    (char *trace_file, TraceReader *reader);
+int  trace_reader_open_mapped (char *trace_file, TraceReader *reader);
+int  trace_reader_next    (TraceReader *reader, TraceRecord *record);
+void trace_reader_destroy (TraceReader *reader);
+int  trace_data_load      (char *trace_file, TraceData *data);
+void trace_data_destroy   (TraceData *data);
+const char *trace_find_line_end (const char *p, const char *end);
+int  trace_parse_line     (const char *line, const char *end,
+                           TraceRecord *record, uint64_t *volume);
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "debug.h"
+#include "common.h"
+#include "trace.h"
+#include "volume_dict.h"
+
+/*
+ * Convert a text trace into the fixed record binary trace format
+ * understood by trace_reader_open ().
+ */
+int main (int argc, char *argv[])
+{
+    int ret;
+    FILE *out_fp = NULL;
+    TraceReader *reader = NULL;
+    TraceRecord record;
+    TraceFileHeader header;
+    TraceFileVolume volume;
+    uint32_t i;
+
+    if (argc != 3) {
+        printf ("Usage: %s text_trace binary_trace\n", argv[0]);
+        return 1;
+    }
+
+    reader = (TraceReader *) calloc (1, sizeof(TraceReader));
+    check (reader!=NULL, "failed to allocate trace reader.");
+    ret = trace_reader_open (argv[1], reader);
+    check (ret==0, "failed to open trace file: %s", argv[1]);
+
+    out_fp = fopen (argv[2], "w");
+    check (out_fp!=NULL, "failed to create binary trace file: %s", argv[2]);
+
+    memset (&header, 0, sizeof(header));
+    memcpy (header.magic, TRACE_BINARY_MAGIC, sizeof(header.magic));
+    header.version     = TRACE_BINARY_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    check (fwrite(&header, sizeof(header), 1, out_fp)==1,
+            "failed to write binary trace header.");
+
+    while ((ret = trace_reader_next (reader, &record)) == 1) {
+        check (fwrite(&record, sizeof(record), 1, out_fp)==1,
+                "failed to write binary trace record.");
+    }
+    check (ret==0, "failed to read trace file: %s", argv[1]);
+
+    /* the dictionary follows the records, in volume id order */
+    for (i = 0; i < reader->volumes->num_volumes; i++) {
+        volume.server_num = volume_dict_server_num (reader->volumes, i);
+        volume.volume_num = volume_dict_volume_num (reader->volumes, i);
+        check (fwrite(&volume, sizeof(volume), 1, out_fp)==1,
+                "failed to write binary trace volume.");
+    }
+
+    /* the counts are only known once the whole trace is read */
+    header.num_records = reader->num_lines;
+    header.num_volumes = reader->volumes->num_volumes;
+    check (fseek(out_fp, 0, SEEK_SET)==0, "failed to rewind binary trace.");
+    check (fwrite(&header, sizeof(header), 1, out_fp)==1,
+            "failed to write binary trace header.");
+
+    ret = fclose (out_fp);
+    out_fp = NULL;
+    check (ret==0, "failed to close binary trace file: %s", argv[2]);
+
+    printf ("converted %"PRIu64" records of %"PRIu64" volumes.\n",
+            header.num_records, header.num_volumes);
+    trace_reader_destroy (reader);
+
+    return 0;
+
+error:
+
+    if (out_fp != NULL) {
+        fclose (out_fp);
+    }
+
+    if (reader != NULL) {
+        trace_reader_destroy (reader);
+    }
+
+    return -1;
+}
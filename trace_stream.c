@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <inttypes.h>
+
+#include "debug.h"
+#include "common.h"
+#include "trace.h"
+#include "trace_stream.h"
+#include "volume_dict.h"
+
+/*
+ * Position cursor at the first line (text) or record (binary) of
+ * chunk. A text chunk owns the lines that start inside its byte
+ * range, so it skips the tail of a line begun in the previous chunk.
+ */
+static void chunk_cursor_init (TraceStream *stream, ChunkCursor *cursor,
+        uint64_t chunk)
+{
+    TraceReader *reader = stream->reader;
+    const char *text, *text_end, *chunk_start;
+    uint64_t limit;
+
+    cursor->chunk = chunk;
+    cursor->record.num_blocks = 0;
+    cursor->next_block = 0;
+
+    if (reader->format == TRACE_FORMAT_BINARY) {
+        cursor->record_ind = chunk * TRACE_STREAM_BINARY_CHUNK;
+        limit = cursor->record_ind + TRACE_STREAM_BINARY_CHUNK;
+        cursor->record_limit = (limit < reader->num_records) ?
+            limit : reader->num_records;
+        return;
+    }
+
+    text = reader->buffer;
+    text_end = text + reader->buffer_len;
+    chunk_start = text + chunk * TRACE_STREAM_TEXT_CHUNK;
+    if (chunk > 0) {
+        chunk_start = trace_find_line_end (chunk_start - 1, text_end);
+        chunk_start += (chunk_start != text_end);
+    }
+    limit = (chunk + 1) * TRACE_STREAM_TEXT_CHUNK;
+    cursor->text_pos = chunk_start;
+    cursor->text_limit = (limit < reader->buffer_len) ?
+        text + limit : text_end;
+}
+
+/* Return values:
+ *      1  -  the next record of the chunk is in cursor->record
+ *      0  -  end of chunk
+ *     -1  -  on error
+ */
+static int chunk_cursor_next_record (TraceStream *stream, ChunkCursor *cursor)
+{
+    int ret;
+    TraceReader *reader = stream->reader;
+    const char *line, *line_end, *text_end;
+
+    if (reader->format == TRACE_FORMAT_BINARY) {
+        if (cursor->record_ind == cursor->record_limit) {
+            return 0;
+        }
+        cursor->record = reader->records[cursor->record_ind];
+        cursor->record_ind += 1;
+        return 1;
+    }
+
+    text_end = reader->buffer + reader->buffer_len;
+    while (cursor->text_pos < cursor->text_limit) {
+        line = cursor->text_pos;
+        line_end = trace_find_line_end (line, text_end);
+        cursor->text_pos = line_end + (line_end != text_end);
+
+        ret = trace_parse_line (line, line_end, &cursor->record,
+                &cursor->volume);
+        check (ret!=-1, "failed to parse trace line at byte %zu:\n\t%.*s",
+                (size_t) (line - reader->buffer), (int) (line_end - line),
+                line);
+        if (ret == 1) {
+            return 1;
+        }
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Index of volume in the volumes of batch, added if it is new, or
+ * VOLUME_DICT_NIL if the table is full. Lines mostly repeat the
+ * volume just added, so the search starts from the end.
+ */
+static inline uint32_t request_batch_volume (RequestBatch *batch,
+        uint64_t volume)
+{
+    uint32_t i;
+
+    for (i = batch->num_volumes; i > 0; i--) {
+        if (batch->volumes[i - 1] == volume) {
+            return (i - 1);
+        }
+    }
+
+    if (batch->num_volumes == TRACE_STREAM_BATCH_VOLUMES) {
+        return VOLUME_DICT_NIL;
+    }
+    batch->volumes[batch->num_volumes] = volume;
+    batch->num_volumes += 1;
+
+    return (batch->num_volumes - 1);
+}
+
+/*
+ * Expand the records at cursor into batch until it is full or the
+ * chunk ends. A record larger than the space left, or of a volume
+ * the batch has no room for, is continued in the next batch.
+ * Returns -1 and marks the batch if parsing failed.
+ */
+static int chunk_cursor_fill (TraceStream *stream, ChunkCursor *cursor,
+        RequestBatch *batch)
+{
+    int ret;
+    uint32_t i, num_reqs = 0, count, volume_id;
+    Request *req;
+
+    batch->last_in_chunk = 0;
+    batch->status = 0;
+    batch->num_volumes = 0;
+
+    while (num_reqs < TRACE_STREAM_BATCH_SIZE) {
+        if (cursor->next_block == cursor->record.num_blocks) {
+            ret = chunk_cursor_next_record (stream, cursor);
+            if (ret != 1) {
+                batch->last_in_chunk = 1;
+                batch->status = ret;
+                break;
+            }
+            cursor->next_block = 0;
+            cursor->sub_window_ind = (cursor->record.timestamp
+                    - stream->starting_time_stamp) / SUB_WINDOW_SIZE;
+        }
+
+        if (stream->reader->format == TRACE_FORMAT_BINARY) {
+            volume_id = cursor->record.volume_id;
+        } else {
+            volume_id = request_batch_volume (batch, cursor->volume);
+            if (volume_id == VOLUME_DICT_NIL) {
+                break;
+            }
+        }
+
+        count = cursor->record.num_blocks - cursor->next_block;
+        if (count > TRACE_STREAM_BATCH_SIZE - num_reqs) {
+            count = TRACE_STREAM_BATCH_SIZE - num_reqs;
+        }
+        for (i = 0; i < count; i++) {
+            req = &(batch->reqs[num_reqs + i]);
+            req->block_num = cursor->record.start_block + cursor->next_block + i;
+            req->volume_id = volume_id;
+            req->req_type = cursor->record.req_type;
+            req->sub_window_ind = cursor->sub_window_ind;
+            req->timestamp = cursor->record.timestamp;
+        }
+        num_reqs += count;
+        cursor->next_block += count;
+    }
+    batch->num_reqs = num_reqs;
+
+    return (batch->status == -1) ? -1 : 0;
+}
+
+static inline void trace_stream_wait (void)
+{
+    sched_yield ();
+}
+
+#ifdef BOUNCER_THREADS
+static void *trace_parser_run (void *arg)
+{
+    TraceParser *parser = (TraceParser *) arg;
+    TraceStream *stream = parser->stream;
+    BatchRing *ring = &(parser->ring);
+    RequestBatch *batch;
+    ChunkCursor cursor;
+    uint64_t chunk, tail;
+    int ret;
+
+    tail = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+    for (chunk = parser->index; chunk < stream->num_chunks;
+            chunk += stream->num_parsers) {
+        chunk_cursor_init (stream, &cursor, chunk);
+        do {
+            while (tail - atomic_load_explicit(&ring->head,
+                        memory_order_acquire) == TRACE_STREAM_RING_SIZE) {
+                if (atomic_load_explicit(&stream->stop, memory_order_relaxed)) {
+                    return NULL;
+                }
+                trace_stream_wait ();
+            }
+
+            batch = &(ring->batches[tail & (TRACE_STREAM_RING_SIZE - 1)]);
+            ret = chunk_cursor_fill (stream, &cursor, batch);
+            tail += 1;
+            atomic_store_explicit (&ring->tail, tail, memory_order_release);
+            if (ret == -1) {
+                return NULL;
+            }
+        } while (batch->last_in_chunk == 0);
+    }
+
+    return NULL;
+}
+#endif
+
+/*
+ * The starting timestamp is needed by every chunk to compute
+ * sub window indexes, so it is read before any parser starts.
+ */
+static int trace_stream_first_timestamp (TraceStream *stream)
+{
+    int ret;
+    TraceReader *reader = stream->reader;
+    ChunkCursor cursor;
+
+    stream->starting_time_stamp = 0;
+    if (reader->format == TRACE_FORMAT_BINARY) {
+        if (reader->num_records > 0) {
+            stream->starting_time_stamp = reader->records[0].timestamp;
+        }
+        return 0;
+    }
+
+    cursor.text_pos = reader->buffer;
+    cursor.text_limit = reader->buffer + reader->buffer_len;
+    ret = chunk_cursor_next_record (stream, &cursor);
+    check (ret!=-1, "failed to parse the first trace record.");
+    if (ret == 1) {
+        stream->starting_time_stamp = cursor.record.timestamp;
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+int trace_stream_open (char *trace_file, uint32_t num_parsers,
+        TraceStream *stream)
+{
+    int ret;
+    uint32_t i;
+    TraceReader *reader;
+
+#ifndef BOUNCER_THREADS
+    if (num_parsers > 0) {
+        log_info ("built without pthreads, parsing the trace inline.");
+        num_parsers = 0;
+    }
+#endif
+
+    stream->reader = (TraceReader *) calloc (1, sizeof(TraceReader));
+    check (stream->reader!=NULL, "failed to allocate trace reader.");
+    ret = trace_reader_open_mapped (trace_file, stream->reader);
+    check (ret==0, "failed to open trace file: %s", trace_file);
+    reader = stream->reader;
+
+    if (reader->format == TRACE_FORMAT_BINARY) {
+        stream->num_chunks = (reader->num_records
+                + TRACE_STREAM_BINARY_CHUNK - 1) / TRACE_STREAM_BINARY_CHUNK;
+    } else {
+        stream->num_chunks = (reader->buffer_len
+                + TRACE_STREAM_TEXT_CHUNK - 1) / TRACE_STREAM_TEXT_CHUNK;
+    }
+
+    ret = trace_stream_first_timestamp (stream);
+    check (ret==0, "failed to read the starting timestamp.");
+
+    atomic_init (&stream->stop, 0);
+    stream->next_chunk = 0;
+    stream->held_ring = NULL;
+    stream->num_parsers = num_parsers;
+
+    if (num_parsers == 0) {
+        stream->inline_batch = (RequestBatch *) calloc (1,
+                sizeof(RequestBatch));
+        check (stream->inline_batch!=NULL, "failed to allocate batch.");
+        stream->cursor.chunk = UINT64_MAX;
+        return 0;
+    }
+
+#ifdef BOUNCER_THREADS
+    stream->parsers = (TraceParser *) calloc (num_parsers,
+            sizeof(TraceParser));
+    check (stream->parsers!=NULL, "failed to allocate parsers.");
+
+    for (i = 0; i < num_parsers; i++) {
+        stream->parsers[i].stream = stream;
+        stream->parsers[i].index = i;
+        atomic_init (&stream->parsers[i].ring.head, 0);
+        atomic_init (&stream->parsers[i].ring.tail, 0);
+        stream->parsers[i].ring.batches = (RequestBatch *) calloc (
+                TRACE_STREAM_RING_SIZE, sizeof(RequestBatch));
+        check (stream->parsers[i].ring.batches!=NULL,
+                "failed to allocate parser ring.");
+    }
+
+    for (i = 0; i < num_parsers; i++) {
+        ret = pthread_create (&stream->parsers[i].thread, NULL,
+                trace_parser_run, &stream->parsers[i]);
+        check (ret==0, "failed to start parser thread %"PRIu32".", i);
+        stream->parsers[i].started = 1;
+    }
+#else
+    (void) i;
+#endif
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Turn the batch volume indexes of a text batch into volume ids,
+ * batches arrive in trace order so ids are handed out in that order.
+ */
+static int trace_stream_map_volumes (TraceStream *stream,
+        RequestBatch *batch)
+{
+    uint32_t ids[TRACE_STREAM_BATCH_VOLUMES];
+    uint32_t i, identity = 1;
+
+    if (stream->reader->format == TRACE_FORMAT_BINARY) {
+        return 0;
+    }
+
+    for (i = 0; i < batch->num_volumes; i++) {
+        ids[i] = volume_dict_id (stream->reader->volumes, batch->volumes[i]);
+        check (ids[i]!=VOLUME_DICT_NIL, "failed to map a trace volume.");
+        identity &= (ids[i] == i);
+    }
+
+    if (!identity) {
+        for (i = 0; i < batch->num_reqs; i++) {
+            batch->reqs[i].volume_id = ids[batch->reqs[i].volume_id];
+        }
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+static int trace_stream_next_inline (TraceStream *stream,
+        RequestBatch **batch)
+{
+    int ret;
+
+    while (stream->next_chunk < stream->num_chunks) {
+        if (stream->cursor.chunk != stream->next_chunk) {
+            chunk_cursor_init (stream, &stream->cursor, stream->next_chunk);
+        }
+
+        ret = chunk_cursor_fill (stream, &stream->cursor, stream->inline_batch);
+        check (ret==0, "failed to parse trace chunk %"PRIu64".",
+                stream->next_chunk);
+        if (stream->inline_batch->last_in_chunk) {
+            stream->next_chunk += 1;
+        }
+
+        if (stream->inline_batch->num_reqs > 0) {
+            ret = trace_stream_map_volumes (stream, stream->inline_batch);
+            check (ret==0, "failed to map the volumes of trace chunk %"PRIu64
+                    ".", stream->next_chunk);
+            *batch = stream->inline_batch;
+            return 1;
+        }
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * Hand out the next batch in trace order. The batch stays valid
+ * until the following call, which gives its slot back to the parser.
+ *
+ * Return values:
+ *      1  -  a batch is returned
+ *      0  -  end of trace
+ *     -1  -  on error
+ */
+int trace_stream_next (TraceStream *stream, RequestBatch **batch)
+{
+    BatchRing *ring;
+    RequestBatch *next;
+    uint64_t head;
+
+    if (stream->num_parsers == 0) {
+        return trace_stream_next_inline (stream, batch);
+    }
+
+    while (1) {
+        if (stream->held_ring != NULL) {
+            ring = stream->held_ring;
+            head = atomic_load_explicit (&ring->head, memory_order_relaxed);
+            if (ring->batches[head & (TRACE_STREAM_RING_SIZE - 1)].last_in_chunk) {
+                stream->next_chunk += 1;
+            }
+            atomic_store_explicit (&ring->head, head + 1, memory_order_release);
+            stream->held_ring = NULL;
+        }
+
+        if (stream->next_chunk == stream->num_chunks) {
+            return 0;
+        }
+
+        // chunks are dealt to the parsers round robin
+        ring = &(stream->parsers[stream->next_chunk % stream->num_parsers].ring);
+        head = atomic_load_explicit (&ring->head, memory_order_relaxed);
+        while (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+            trace_stream_wait ();
+        }
+
+        next = &(ring->batches[head & (TRACE_STREAM_RING_SIZE - 1)]);
+        check (next->status==0, "failed to parse trace chunk %"PRIu64".",
+                stream->next_chunk);
+        stream->held_ring = ring;
+
+        if (next->num_reqs > 0) {
+            check (trace_stream_map_volumes (stream, next)==0,
+                    "failed to map the volumes of trace chunk %"PRIu64".",
+                    stream->next_chunk);
+            *batch = next;
+            return 1;
+        }
+    }
+
+error:
+
+    return -1;
+}
+
+void trace_stream_destroy (TraceStream *stream)
+{
+    uint32_t i;
+
+#ifdef BOUNCER_THREADS
+    if (stream->parsers != NULL) {
+        atomic_store (&stream->stop, 1);
+        for (i = 0; i < stream->num_parsers; i++) {
+            if (stream->parsers[i].started) {
+                pthread_join (stream->parsers[i].thread, NULL);
+            }
+        }
+        for (i = 0; i < stream->num_parsers; i++) {
+            free (stream->parsers[i].ring.batches);
+        }
+        free (stream->parsers);
+    }
+#else
+    (void) i;
+#endif
+
+    if (stream->inline_batch != NULL) {
+        free (stream->inline_batch);
+    }
+
+    if (stream->reader != NULL) {
+        trace_reader_destroy (stream->reader);
+    }
+
+    free (stream);
+}
@@ -0,0 +1,98 @@
+#ifndef TRACE_STREAM_H_
+#define TRACE_STREAM_H_
+
+#include <stdatomic.h>
+#ifdef BOUNCER_THREADS
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "trace.h"
+
+#define TRACE_STREAM_BATCH_SIZE     4096        // Requests per batch
+#define TRACE_STREAM_BATCH_VOLUMES  64          // Text volumes per batch
+#define TRACE_STREAM_RING_SIZE      8           // Batches per ring, power of 2
+#define TRACE_STREAM_TEXT_CHUNK     (1 << 20)   // Text bytes per chunk
+#define TRACE_STREAM_BINARY_CHUNK   (1 << 16)   // Binary records per chunk
+#define TRACE_STREAM_DEFAULT_PARSERS 1
+
+/*
+ * A run of trace blocks, one Request per block, in trace order and
+ * with sub_window_ind already computed. A batch never spans two
+ * chunks; the last batch of a chunk has last_in_chunk set.
+ *
+ * Parsers cannot hand out volume ids, those follow the trace order,
+ * so a text parser sets the volume_id of each request to an index
+ * into the raw volumes of its batch, and trace_stream_next () maps
+ * them to ids before handing the batch out. A batch whose volumes
+ * table is full ends early.
+ */
+typedef struct RequestBatch {
+    uint32_t  num_reqs;
+    uint8_t   last_in_chunk;
+    int8_t    status;           // -1 if the chunk failed to parse
+    uint32_t  num_volumes;
+    uint64_t  volumes[TRACE_STREAM_BATCH_VOLUMES];  // volume_dict_raw ()
+    Request   reqs[TRACE_STREAM_BATCH_SIZE];
+} RequestBatch;
+
+/* Position of a parser inside its current chunk. */
+typedef struct ChunkCursor {
+    uint64_t     chunk;
+    const char  *text_pos;      // Text: next line to parse
+    const char  *text_limit;    // Text: lines starting here belong to the next chunk
+    uint64_t     record_ind;    // Binary: next record to hand out
+    uint64_t     record_limit;
+    TraceRecord  record;        // Record being expanded into blocks
+    uint64_t     volume;        // Text: raw volume of record
+    uint32_t     next_block;    // Blocks of record already expanded
+    uint32_t     sub_window_ind;
+} ChunkCursor;
+
+/*
+ * Lock-free single producer single consumer ring of batches. head
+ * is only advanced by the consumer, tail only by the producer, and
+ * the two live on separate cache lines.
+ */
+typedef struct BatchRing {
+    _Atomic uint64_t  head;
+    char              head_pad[56];
+    _Atomic uint64_t  tail;
+    char              tail_pad[56];
+    RequestBatch     *batches;
+} BatchRing;
+
+struct TraceStream;
+
+/* Parser thread i handles chunks i, i + num_parsers, ... */
+typedef struct TraceParser {
+    struct TraceStream *stream;
+    uint32_t            index;
+    BatchRing           ring;
+#ifdef BOUNCER_THREADS
+    pthread_t           thread;
+    uint8_t             started;
+#endif
+} TraceParser;
+
+typedef struct TraceStream {
+    TraceReader   *reader;              // Mapped text or binary trace, its
+                                        // volumes has every id handed out
+    uint64_t       starting_time_stamp; // Timestamp of the first record
+    uint64_t       num_chunks;
+    uint32_t       num_parsers;         // 0 - parse inline in trace_stream_next
+    TraceParser   *parsers;
+    _Atomic int    stop;                // Tells parser threads to quit early
+    /* consumer side */
+    uint64_t       next_chunk;          // Chunk the next batch belongs to
+    BatchRing     *held_ring;           // Ring of the batch handed out last
+    ChunkCursor    cursor;              // Inline parsing
+    RequestBatch  *inline_batch;
+} TraceStream;
+
+int  trace_stream_open    (char *trace_file, uint32_t num_parsers,
+                           TraceStream *stream);
+int  trace_stream_next    (TraceStream *stream, RequestBatch **batch);
+void trace_stream_destroy (TraceStream *stream);
+
+#endif
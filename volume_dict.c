@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "debug.h"
+#include "common.h"
+#include "volume_dict.h"
+
+int volume_dict_init (VolumeDict *dict)
+{
+    uint64_t i;
+
+    dict->num_volumes = 0;
+    dict->capacity = VOLUME_DICT_INITIAL_SIZE;
+    dict->raw = (uint64_t *) calloc (dict->capacity, sizeof(uint64_t));
+    check (dict->raw!=NULL, "failed to allocate volume_dict->raw.");
+
+    dict->lookup_table_size = 2 * VOLUME_DICT_INITIAL_SIZE;
+    dict->lookup_table = (uint32_t *) calloc (dict->lookup_table_size,
+            sizeof(uint32_t));
+    check (dict->lookup_table!=NULL,
+            "failed to allocate volume_dict->lookup_table.");
+    for (i = 0; i < dict->lookup_table_size; i++) {
+        dict->lookup_table[i] = VOLUME_DICT_NIL;
+    }
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/* Double the room for volumes and rehash the ids into a new table. */
+static int volume_dict_grow (VolumeDict *dict)
+{
+    uint64_t *raw;
+    uint32_t *lookup_table, id;
+    uint64_t size = dict->lookup_table_size << 1;
+    uint64_t i;
+
+    raw = (uint64_t *) realloc (dict->raw, 2 * dict->capacity
+            * sizeof(uint64_t));
+    check (raw!=NULL, "failed to grow volume_dict->raw.");
+    dict->raw = raw;
+    dict->capacity *= 2;
+
+    lookup_table = (uint32_t *) calloc (size, sizeof(uint32_t));
+    check (lookup_table!=NULL, "failed to grow volume_dict->lookup_table.");
+    for (i = 0; i < size; i++) {
+        lookup_table[i] = VOLUME_DICT_NIL;
+    }
+    for (id = 0; id < dict->num_volumes; id++) {
+        i = hash_u64 (raw[id]) & (size - 1);
+        while (lookup_table[i] != VOLUME_DICT_NIL) {
+            i = (i + 1) & (size - 1);
+        }
+        lookup_table[i] = id;
+    }
+
+    free (dict->lookup_table);
+    dict->lookup_table = lookup_table;
+    dict->lookup_table_size = size;
+
+    return 0;
+
+error:
+
+    return -1;
+}
+
+/*
+ * returns the id of raw, giving it the next id if it is new, or
+ * VOLUME_DICT_NIL if the ids are used up or the dictionary cannot grow.
+ */
+uint32_t volume_dict_id (VolumeDict *dict, uint64_t raw)
+{
+    uint64_t mask = dict->lookup_table_size - 1;
+    uint64_t i    = hash_u64 (raw) & mask;
+    uint32_t id;
+
+    while ((id = dict->lookup_table[i]) != VOLUME_DICT_NIL) {
+        if (dict->raw[id] == raw) {
+            return id;
+        }
+        i = (i + 1) & mask;
+    }
+
+    check (dict->num_volumes<VOLUME_DICT_MAX_VOLUMES,
+            "more than %"PRIu32" volumes in the trace.",
+            (uint32_t) VOLUME_DICT_MAX_VOLUMES);
+    if (dict->num_volumes == dict->capacity) {
+        check (volume_dict_grow (dict)==0, "failed to grow volume_dict.");
+        mask = dict->lookup_table_size - 1;
+        i = hash_u64 (raw) & mask;
+        while (dict->lookup_table[i] != VOLUME_DICT_NIL) {
+            i = (i + 1) & mask;
+        }
+    }
+
+    id = dict->num_volumes;
+    dict->raw[id] = raw;
+    dict->lookup_table[i] = id;
+    dict->num_volumes += 1;
+
+    return id;
+
+error:
+
+    return VOLUME_DICT_NIL;
+}
+
+void volume_dict_destroy (VolumeDict *dict)
+{
+    if (dict->raw != NULL) {
+        free (dict->raw);
+    }
+
+    if (dict->lookup_table != NULL) {
+        free (dict->lookup_table);
+    }
+
+    free (dict);
+}
@@ -0,0 +1,48 @@
+#ifndef VOLUME_DICT_H_
+#define VOLUME_DICT_H_
+
+#include "common.h"
+
+#define VOLUME_DICT_NIL             UINT32_MAX  // No volume
+#define VOLUME_DICT_MAX_VOLUMES     (1U << BLOCK_KEY_VOLUME_BITS)
+#define VOLUME_DICT_INITIAL_SIZE    64          // Volumes before the first grow
+
+/* The (server, volume) pair of a trace line as one word. */
+static inline uint64_t volume_dict_raw (uint32_t server_num,
+        uint32_t volume_num)
+{
+    return (((uint64_t) server_num << 32) | volume_num);
+}
+
+/*
+ * Maps the server and volume identifiers of a trace to dense volume
+ * ids, handed out in order of first appearance. Per volume data is
+ * kept in flat arrays indexed by id; raw is the only such array for
+ * now and gives the identifiers back. lookup_table is an open
+ * addressed table of ids, kept at most half full.
+ */
+typedef struct VolumeDict {
+    uint32_t   num_volumes;
+    uint32_t   capacity;            // Volumes raw has room for
+    uint64_t  *raw;                 // volume_dict_raw () of each id
+    uint32_t  *lookup_table;        // VOLUME_DICT_NIL - empty slot
+    uint64_t   lookup_table_size;   // Power of 2
+} VolumeDict;
+
+int      volume_dict_init    (VolumeDict *dict);
+uint32_t volume_dict_id      (VolumeDict *dict, uint64_t raw);
+void     volume_dict_destroy (VolumeDict *dict);
+
+static inline uint32_t volume_dict_server_num (const VolumeDict *dict,
+        uint32_t volume_id)
+{
+    return (uint32_t) (dict->raw[volume_id] >> 32);
+}
+
+static inline uint32_t volume_dict_volume_num (const VolumeDict *dict,
+        uint32_t volume_id)
+{
+    return (uint32_t) dict->raw[volume_id];
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef WINDOW_COUNTER_H_
+#define WINDOW_COUNTER_H_
+
+#include <string.h>
+#include <inttypes.h>
+
+/*
+ * Per sub window miss counters, shared by the miss filter, the miss
+ * table and the ghost cache: each block keeps num_sub_windows of
+ * them, indexed by sub window modulo num_sub_windows, either as an
+ * array or packed counter_bits apiece into a 64 bit word.
+ */
+
+/*
+ * Clear the per sub window counters that went stale between the
+ * last access and the current one: all of them once num_sub_windows
+ * sub windows have passed, otherwise the ones after the last access
+ * up to the current one, wrapping around.
+ */
+static inline void window_clear_stale (void *counter, size_t counter_size,
+        uint32_t last_sub_window_ind, uint32_t curr_sub_window_ind,
+        uint8_t num_sub_windows)
+{
+    char *base = (char *) counter;
+    uint32_t diff = curr_sub_window_ind - last_sub_window_ind;
+    uint32_t first, end;
+
+    if (diff == 0) {
+        return;
+    }
+    if (diff >= num_sub_windows) {
+        memset (base, 0, num_sub_windows * counter_size);
+        return;
+    }
+
+    first = (last_sub_window_ind + 1) % num_sub_windows;
+    end   = curr_sub_window_ind % num_sub_windows;
+    if (first <= end) {
+        memset (base + first * counter_size, 0,
+                (end - first + 1) * counter_size);
+    } else {
+        memset (base + first * counter_size, 0,
+                (num_sub_windows - first) * counter_size);
+        memset (base, 0, (end + 1) * counter_size);
+    }
+}
+
+/* All ones over num_counters packed counters of counter_bits each. */
+static inline uint64_t window_counter_ones (uint32_t num_counters,
+        uint8_t counter_bits)
+{
+    uint32_t bits = num_counters * counter_bits;
+
+    return (bits >= 64) ? UINT64_MAX : ((1ULL << bits) - 1);
+}
+
+/*
+ * window_clear_stale for packed counters: the mask of the counters
+ * made stale by moving diff sub windows ahead to curr.
+ */
+static inline uint64_t window_stale_mask (uint8_t num_sub_windows,
+        uint8_t counter_bits, uint32_t diff, uint32_t curr)
+{
+    uint32_t n  = num_sub_windows;
+    uint8_t  cb = counter_bits;
+    uint32_t first, last;
+
+    if (diff == 0) {
+        return 0;
+    }
+    if (diff >= n) {
+        return window_counter_ones (n, cb);
+    }
+
+    last  = curr % n;
+    first = (last + n - diff + 1) % n;
+    if (first <= last) {
+        return (window_counter_ones (last - first + 1, cb) << (first * cb));
+    }
+
+    return (window_counter_ones (last + 1, cb)
+            | (window_counter_ones (n - first, cb) << (first * cb)));
+}
+
+#endif